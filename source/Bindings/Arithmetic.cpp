@@ -6,12 +6,16 @@
 #include "../LowLevelConvert/LowLevelConvert.h"
 #include "../Symbols/Symbols.h"
 #include "../ManyType/ManyType.h"
+#include "Broadcast.h"
 
-void add_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
-    // arr must have length 3
-    convertToFtype(arr[1]);
-    convertToFtype(arr[2]);
-    ftype output = arr[1].getFtype() + arr[2].getFtype();
+/// Adds two scalars.
+/// @param ret where the sum will be placed
+/// @param a the first addend, it will be converted to Float
+/// @param b the second addend, it will be converted to Float
+void addScalars(ManyType& ret, ManyType& a, ManyType& b) {
+    convertToFtype(a);
+    convertToFtype(b);
+    ftype output = a.getFtype() + b.getFtype();
     if (std::isnan(output)) {
         throw UserAlert(UserMessage::NanError,"add");
     }
@@ -21,11 +25,14 @@ void add_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
     ret.putFtype(output);
 }
 
-void sub_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
-    // arr must have length 3
-    convertToFtype(arr[1]);
-    convertToFtype(arr[2]);
-    ftype output = arr[1].getFtype() - arr[2].getFtype();
+/// Subtracts two scalars.
+/// @param ret where the difference will be placed
+/// @param a the minuend, it will be converted to Float
+/// @param b the subtrahend, it will be converted to Float
+void subScalars(ManyType& ret, ManyType& a, ManyType& b) {
+    convertToFtype(a);
+    convertToFtype(b);
+    ftype output = a.getFtype() - b.getFtype();
     if (std::isnan(output)) {
         throw UserAlert(UserMessage::NanError,"sub");
     }
@@ -35,10 +42,14 @@ void sub_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
     ret.putFtype(output);
 }
 
-void bindArithmetic() {
-    std::string baseName;
-    baseName = "add";
-    placeBuiltInSymbol(baseName,&add_implement,2,0);
-    baseName = "sub";
-    placeBuiltInSymbol(baseName,&sub_implement,2,0);
+void add_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr must have length 3
+    // vectors and matrices are added element by element
+    broadcastBinary(ret,arr[1],arr[2],&addScalars,"add");
+}
+
+void sub_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr must have length 3
+    // vectors and matrices are subtracted element by element
+    broadcastBinary(ret,arr[1],arr[2],&subScalars,"sub");
 }
\ No newline at end of file
@@ -6,6 +6,10 @@
 #include "../ManyType/ManyType.h"
 #include "../Symbols/Symbols.h"
 #include "../LowLevelConvert/LowLevelConvert.h"
+#include "../Compute/CompileUserSymbol.h"
+#include "../Compute/FoldConstants.h"
+#include "../Compute/ParameterSlots.h"
+#include "../Compute/Memoize.h"
 
 void assign_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
     // arr has length 3
@@ -35,6 +39,7 @@ void arrow_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
     ManyType name;
     ManyType callObject;
     unsigned char delayMask = 0;
+    std::vector<bool> lazyParameters;
     if (arr[1].type() == ManyTypeLabel::StructureVector) {
         // it's a function call
         mtvec& avec = arr[1].getStructureVector();
@@ -45,6 +50,25 @@ void arrow_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
         // make sure that they're all strings
         // we expect a function name, and local variable names
         for (long i = 0; i < avec.size(); ++i) {
+            if (i >= 1 && avec[i].type() == ManyTypeLabel::StructureVector) {
+                // lazy(name) marks a lazy parameter
+                // it can be any argument, not just the first 8
+                mtvec& marker = avec[i].getStructureVector();
+                if (marker.size() != 2 || marker[0].getStructureString() != "lazy" || marker[1].type() != ManyTypeLabel::StructureString) {
+                    throw UserAlert(UserMessage::UnexpectedType,"arrow");
+                }
+                if (marker[1].getStructureString()[0] == '%') {
+                    // a delayed argument is never evaluated by the callee
+                    throw UserAlert(UserMessage::SyntaxError,"% Used In lazy");
+                }
+                // replace the marker with the name it holds
+                ManyType parameterName;
+                parameterName = marker[1];
+                avec[i] = parameterName;
+                lazyParameters.resize(avec.size(),false);
+                lazyParameters[i] = true;
+                continue;
+            }
             if (avec[i].type() != ManyTypeLabel::StructureString) {
                 throw UserAlert(UserMessage::UnexpectedType,"arrow");
             }
@@ -80,7 +104,26 @@ void arrow_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
     }
     // now place it
     // callObject.getVector().size()-1 is the argCount for this symbol
-    placeUserSymbol(name.getStructureString(),callObject,callObject.getStructureVector().size()-1,delayMask);
+    UserSymbol& user = placeUserSymbol(name.getStructureString(),callObject,callObject.getStructureVector().size()-1,delayMask);
+    user.lazyParameters.swap(lazyParameters);
+    // evaluate what doesn't depend on the arguments now
+    // this happens after placing it, so that it can see
+    // what its own recursive calls delay
+    foldConstants(user.definition,recursionJuice);
+    // find its local variables
+    // so they don't have to be looked up on every call
+    user.slots = findParameterSlots(user.definition,recursionJuice);
+    // compile it, if possible
+    // the compiled code relies on the local variables being found
+    if (user.slots) {
+        user.compiled = compileUserSymbol(user.definition,*(user.slots),recursionJuice);
+        // remember its results, if it has no side effects
+        // lazy arguments arrive as written, so they can't be
+        // compared the way evaluated arguments are
+        if (user.lazyParameters.empty()) {
+            user.memo = findMemoTable(user.definition,*(user.slots),recursionJuice);
+        }
+    }
     ret.putNone();
 }
 
@@ -93,7 +136,7 @@ void remove1_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
     }
     // now get the list of symbols with that baseName
     // that can be deleted
-    const std::string& baseName = arr[1].getStructureString();
+    const mtstring& baseName = arr[1].getStructureString();
     std::vector<char> deleteList;
     removeUserSymbolList(baseName, deleteList);
     // the list is now populated with all those things that
@@ -135,15 +178,4 @@ void remove2_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
     bool output = removeUserSymbol(arr[1].getStructureString(),argCount);
     // and now return if the deletion was successful
     ret.putBool(output);
-}
-
-void bindAssign() {
-    std::string baseName;
-    baseName = "assign";
-    placeBuiltInSymbol(baseName,&assign_implement,2,0x01);
-    baseName = "arrow";
-    placeBuiltInSymbol(baseName,&arrow_implement,2,0x03);
-    baseName = "remove";
-    placeBuiltInSymbol(baseName,&remove1_implement,1,0x01);
-    placeBuiltInSymbol(baseName,&remove2_implement,2,0x01);
 }
\ No newline at end of file
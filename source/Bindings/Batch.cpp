@@ -0,0 +1,26 @@
+/**
+ * @file Batch.cpp
+ * @author Aaron Stanek
+*/
+#include "Bindings.h"
+#include "../ManyType/ManyType.h"
+#include "../Compute/Batch.h"
+
+void batch_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 2 or more
+    // arr[1] is the name of the function to call (delayMask)
+    // arr[2...] are the columns, one for each argument
+    // returns a colvec with the result for each row
+    if (arr.size() < 2 || arr[1].type() != ManyTypeLabel::StructureString) {
+        throw UserAlert(UserMessage::UnexpectedType,"batch");
+    }
+    ManyType baseName;
+    baseName = arr[1];
+    // the columns are everything after the name
+    mtvec columns;
+    columns.resize(arr.size() - 1);
+    for (int_fast32_t i = 2; i < arr.size(); ++i) {
+        columns[i-1] = arr[i];
+    }
+    callBatch(ret,baseName.getStructureString(),columns,recursionJuice);
+}
@@ -3,10 +3,181 @@
  * @author Aaron Stanek
 */
 #include "Bindings.h"
+#include "../Compute/EvaluateConstExpression.h"
 
-void bindEverything() {
-    bindAssign();
-    bindConstants();
-    bindConvert();
-    bindArithmetic();
-}
\ No newline at end of file
+/// Every language built-in symbol that is known at compile time.
+/// Index 0 is a sentinel that never matches a lookup,
+/// empty slots of builtInSlots point to it.
+/// Entries may be listed in any order.
+/// If adding an entry causes the static_assert below to fail,
+/// BUILT_IN_HASH_SEED must be changed.
+constexpr BuiltInSymbol builtInTable[] = {
+    { "", -2, SymbolTableElement(nullptr,0), false },
+    // Assign.cpp
+    { "assign", 2, SymbolTableElement(&assign_implement,0x01), false },
+    { "arrow", 2, SymbolTableElement(&arrow_implement,0x03), false },
+    { "remove", 1, SymbolTableElement(&remove1_implement,0x01), false },
+    { "remove", 2, SymbolTableElement(&remove2_implement,0x01), false },
+    // Constants.cpp
+    { "none", 0, SymbolTableElement(&none_implement,0), true },
+    { "true", 0, SymbolTableElement(&true_implement,0), true },
+    { "false", 0, SymbolTableElement(&false_implement,0), true },
+    { "pi", 0, SymbolTableElement(&pi_implement,0), true },
+    { "e", 0, SymbolTableElement(&e_implement,0), true },
+    { "floatexponent", 0, SymbolTableElement(&floatexponent_implement,0), true },
+    { "floatprecision", 0, SymbolTableElement(&floatprecision_implement,0), true },
+    // Convert.cpp
+    { "bool", 1, SymbolTableElement(&bool_implement,0), true },
+    { "int", 1, SymbolTableElement(&int_implement,0), true },
+    { "float", 1, SymbolTableElement(&float_implement,0), true },
+    // Arithmetic.cpp
+    { "add", 2, SymbolTableElement(&add_implement,0), true },
+    { "sub", 2, SymbolTableElement(&sub_implement,0), true },
+    // Vector.cpp
+    { "rowvec", -1, SymbolTableElement(&rowvec_implement,0), true },
+    { "colvec", -1, SymbolTableElement(&colvec_implement,0), true },
+    { "matrix", -1, SymbolTableElement(&matrix_implement,0), true },
+    // Batch.cpp
+    { "batch", -1, SymbolTableElement(&batch_implement,1), false },
+    // MapReduce.cpp
+    { "map", 2, SymbolTableElement(&map_implement,1), false },
+    { "filter", 2, SymbolTableElement(&filter_implement,1), false },
+    { "reduce", 2, SymbolTableElement(&reduce2_implement,1), false },
+    { "reduce", 3, SymbolTableElement(&reduce3_implement,1), false },
+    // Control.cpp
+    { "if", 2, SymbolTableElement(&if2_implement,2), true },
+    { "if", 3, SymbolTableElement(&if3_implement,6), true },
+    { "and", 2, SymbolTableElement(&and_implement,2), true },
+    { "or", 2, SymbolTableElement(&or_implement,2), true },
+    { "while", 2, SymbolTableElement(&while_implement,3), true },
+    { "for", 4, SymbolTableElement(&for_implement,9), false },
+    { LENT_ARGUMENT_NAME, 3, SymbolTableElement(&lentargument_implement,4), false },
+    // Types.cpp
+    { "infer", 1, SymbolTableElement(&infer_implement,1), false },
+    // Native.cpp
+    { "native", 2, SymbolTableElement(&native_implement,1), false },
+    // Memory.cpp
+    { "memoryusage", 0, SymbolTableElement(&memoryusage_implement,0), false },
+    { "memorypeak", 0, SymbolTableElement(&memorypeak_implement,0), false },
+    { "memorylimit", 0, SymbolTableElement(&memorylimit_implement,0), false },
+    // Reactive.cpp
+    { "reactive", 0, SymbolTableElement(&reactive0_implement,0), false },
+    { "reactive", 1, SymbolTableElement(&reactive1_implement,0), false }
+};
+
+/// The number of entries in builtInTable, including the sentinel.
+#define BUILT_IN_TABLE_SIZE (sizeof(builtInTable) / sizeof(BuiltInSymbol))
+
+/// The number of slots in the perfect hash table.
+/// Must be 256, see builtInSlots.
+#define BUILT_IN_SLOT_COUNT 256
+
+/// Chosen so that no two entries of
+/// builtInTable hash to the same slot.
+#define BUILT_IN_HASH_SEED 6
+
+static_assert( BUILT_IN_TABLE_SIZE <= 255 , "builtInTable must be indexable by unsigned char" );
+
+/// One round of 32 bit FNV-1a.
+/// @param h the hash so far
+/// @param c the next byte
+/// @return the updated hash
+constexpr unsigned long builtInHashStep(const unsigned long h, const unsigned char c) noexcept {
+    return ((h ^ c) * 16777619UL) & 0xFFFFFFFFUL;
+}
+
+/// Hashes a null-terminated string at compile time.
+/// @param s the string to hash
+/// @param h the hash so far
+/// @return the hash of s
+constexpr unsigned long builtInHashString(const char* s, const unsigned long h) noexcept {
+    return (*s == '\0') ? h : builtInHashString(s+1,builtInHashStep(h,(unsigned char)(*s)));
+}
+
+/// Folds a 32 bit hash down to a slot index.
+/// @param h the hash of baseName and argCount
+/// @return a value in the range 0 <= value < BUILT_IN_SLOT_COUNT
+constexpr unsigned long builtInHashFinish(const unsigned long h) noexcept {
+    return (h ^ (h >> 16)) & (BUILT_IN_SLOT_COUNT - 1);
+}
+
+/// @param baseName the basename of the symbol
+/// @param argCount the number of arguments of the overload
+/// @return the slot of the overload in builtInSlots
+constexpr unsigned long builtInHash(const char* baseName, const char argCount) noexcept {
+    return builtInHashFinish(builtInHashStep(
+        builtInHashString(baseName,2166136261UL ^ BUILT_IN_HASH_SEED),
+        (unsigned char)(argCount)
+    ));
+}
+
+/// @param slot a slot of builtInSlots
+/// @param index the first index of builtInTable to check
+/// @return the index of the entry of builtInTable that
+/// hashes to slot, or 0 if there is no such entry
+constexpr unsigned char findBuiltInSlot(const unsigned long slot, const unsigned long index) noexcept {
+    return (index >= BUILT_IN_TABLE_SIZE) ? 0 :
+        (builtInHash(builtInTable[index].baseName,builtInTable[index].argCount) == slot) ? index :
+        findBuiltInSlot(slot,index+1);
+}
+
+#define BUILT_IN_SLOTS_4(s) findBuiltInSlot((s),1), findBuiltInSlot((s)+1,1), \
+    findBuiltInSlot((s)+2,1), findBuiltInSlot((s)+3,1)
+#define BUILT_IN_SLOTS_16(s) BUILT_IN_SLOTS_4(s), BUILT_IN_SLOTS_4((s)+4), \
+    BUILT_IN_SLOTS_4((s)+8), BUILT_IN_SLOTS_4((s)+12)
+#define BUILT_IN_SLOTS_64(s) BUILT_IN_SLOTS_16(s), BUILT_IN_SLOTS_16((s)+16), \
+    BUILT_IN_SLOTS_16((s)+32), BUILT_IN_SLOTS_16((s)+48)
+
+/// Maps the hash of a baseName and argCount
+/// to an index of builtInTable.
+/// Generated at compile time.
+constexpr unsigned char builtInSlots[BUILT_IN_SLOT_COUNT] = {
+    BUILT_IN_SLOTS_64(0), BUILT_IN_SLOTS_64(64),
+    BUILT_IN_SLOTS_64(128), BUILT_IN_SLOTS_64(192)
+};
+
+/// @param index the first index of builtInTable to check
+/// @return true if every entry from index onward
+/// can be found through builtInSlots
+constexpr bool builtInSlotsArePerfect(const unsigned long index) noexcept {
+    return (index >= BUILT_IN_TABLE_SIZE) || (
+        (builtInSlots[builtInHash(builtInTable[index].baseName,builtInTable[index].argCount)] == index)
+        && builtInSlotsArePerfect(index+1)
+    );
+}
+
+static_assert( builtInSlotsArePerfect(6) , "BUILT_IN_HASH_SEED causes a collision in builtInSlots" );
+
+/// Looks up an overload in the constexpr built-in table.
+/// Does not fall back on n-matched symbols.
+/// @param baseName the baseName to look up
+/// @param argCount the number of arguments, -1 for n-matched symbols
+/// @return a pointer to the entry in builtInTable, or nullptr
+/// if the overload is not a compile time built-in
+const BuiltInSymbol* readBuiltInSymbol(const mtstring& baseName, const char argCount) noexcept {
+    // same steps as builtInHash, but iterative
+    unsigned long h = 2166136261UL ^ BUILT_IN_HASH_SEED;
+    for (mtstring::size_type i = 0; i < baseName.size(); ++i) {
+        h = builtInHashStep(h,(unsigned char)(baseName[i]));
+    }
+    h = builtInHashFinish(builtInHashStep(h,(unsigned char)(argCount)));
+    // every slot leads to an entry, possibly the sentinel
+    const BuiltInSymbol& candidate = builtInTable[builtInSlots[h]];
+    if (candidate.argCount == argCount && baseName == candidate.baseName) {
+        return &candidate;
+    }
+    return nullptr;
+}
+
+/// Used when reporting errors, not on the hot path.
+/// @param baseName the baseName to look up
+/// @return true if any overload of baseName is
+/// in the constexpr built-in table
+bool isBuiltInBaseName(const mtstring& baseName) noexcept {
+    for (unsigned long i = 1; i < BUILT_IN_TABLE_SIZE; ++i) {
+        if (baseName == builtInTable[i].baseName) {
+            return true;
+        }
+    }
+    return false;
+}
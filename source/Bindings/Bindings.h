@@ -3,17 +3,123 @@
  * @author Aaron Stanek
  * @brief Functions to implement
  * language built-in functions
- * and to bind said functions symbol names
+ * and the table binding said functions to symbol names
 */
 #pragma once
 #include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "../Symbols/Symbols.h"
 
-void bindEverything();
+const BuiltInSymbol* readBuiltInSymbol(const mtstring&, const char) noexcept;
 
-void bindAssign();
+bool isBuiltInBaseName(const mtstring&) noexcept;
 
-void bindConstants();
+// Quicken.cpp
 
-void bindConvert();
+quickenedFunction quickenBuiltIn(const boundFunction, const ManyTypeLabel* const, const uint_least32_t) noexcept;
 
-void bindArithmetic();
\ No newline at end of file
+// Signatures.cpp
+
+ManyTypeLabelInt builtInResultTypes(const boundFunction, const ManyTypeLabelInt* const, const uint_least32_t) noexcept;
+
+bool builtInEvaluatesDelayedArguments(const boundFunction) noexcept;
+
+// Assign.cpp
+
+void assign_implement(ManyType&, mtvec&, long);
+
+void arrow_implement(ManyType&, mtvec&, long);
+
+void remove1_implement(ManyType&, mtvec&, long);
+
+void remove2_implement(ManyType&, mtvec&, long);
+
+// Constants.cpp
+
+void none_implement(ManyType&, mtvec&, long) noexcept;
+
+void true_implement(ManyType&, mtvec&, long) noexcept;
+
+void false_implement(ManyType&, mtvec&, long) noexcept;
+
+void pi_implement(ManyType&, mtvec&, long) noexcept;
+
+void e_implement(ManyType&, mtvec&, long) noexcept;
+
+void floatexponent_implement(ManyType&, mtvec&, long) noexcept;
+
+void floatprecision_implement(ManyType&, mtvec&, long) noexcept;
+
+// Convert.cpp
+
+void bool_implement(ManyType&, mtvec&, long);
+
+void int_implement(ManyType&, mtvec&, long);
+
+void float_implement(ManyType&, mtvec&, long);
+
+// Arithmetic.cpp
+
+void add_implement(ManyType&, mtvec&, long);
+
+void sub_implement(ManyType&, mtvec&, long);
+
+// Vector.cpp
+
+void rowvec_implement(ManyType&, mtvec&, long);
+
+void colvec_implement(ManyType&, mtvec&, long);
+
+void matrix_implement(ManyType&, mtvec&, long);
+
+// Batch.cpp
+
+void batch_implement(ManyType&, mtvec&, long);
+
+// MapReduce.cpp
+
+void map_implement(ManyType&, mtvec&, long);
+
+void filter_implement(ManyType&, mtvec&, long);
+
+void reduce2_implement(ManyType&, mtvec&, long);
+
+void reduce3_implement(ManyType&, mtvec&, long);
+
+// Control.cpp
+
+void if2_implement(ManyType&, mtvec&, long);
+
+void if3_implement(ManyType&, mtvec&, long);
+
+void and_implement(ManyType&, mtvec&, long);
+
+void or_implement(ManyType&, mtvec&, long);
+
+void while_implement(ManyType&, mtvec&, long);
+
+void for_implement(ManyType&, mtvec&, long);
+
+void lentargument_implement(ManyType&, mtvec&, long);
+
+// Types.cpp
+
+void infer_implement(ManyType&, mtvec&, long);
+
+// Native.cpp
+
+void native_implement(ManyType&, mtvec&, long);
+
+// Memory.cpp
+
+void memoryusage_implement(ManyType&, mtvec&, long) noexcept;
+
+void memorypeak_implement(ManyType&, mtvec&, long) noexcept;
+
+void memorylimit_implement(ManyType&, mtvec&, long) noexcept;
+
+// Reactive.cpp
+
+void reactive0_implement(ManyType&, mtvec&, long) noexcept;
+
+void reactive1_implement(ManyType&, mtvec&, long);
\ No newline at end of file
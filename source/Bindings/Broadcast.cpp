@@ -0,0 +1,233 @@
+/**
+ * @file Broadcast.cpp
+ * @author Aaron Stanek
+*/
+#include "Broadcast.h"
+
+/// @param kind the kind of a DataVector, not VectorKind::Scalar
+/// @return the name held by the first element of the DataVector
+const char* vectorKindName(const VectorKind kind) noexcept {
+    switch (kind) {
+        case VectorKind::Row:
+        return "rowvec";
+
+        case VectorKind::Column:
+        return "colvec";
+
+        default:
+        return "matrix";
+    }
+}
+
+/// @param x a value that can be broadcast
+/// @param name the built-in function, for errors
+/// @return the kind and dimensions of x
+/// @throw UserAlert if x is a DataVector of the wrong form
+VectorShape readShape(const ManyType& x, const char* const name) {
+    VectorShape shape = { VectorKind::Scalar, 1, 1 };
+    if (!isDataVector(x)) {
+        return shape;
+    }
+    const mtvec& vec = x.getDataVector();
+    if (vec.empty() || vec[0].type() != ManyTypeLabel::StructureString) {
+        throw UserAlert(UserMessage::UnexpectedType,name);
+    }
+    const mtstring& kind = vec[0].getStructureString();
+    const uint_least32_t length = vec.size() - 1;
+    if (kind == "rowvec") {
+        shape.kind = VectorKind::Row;
+        shape.columns = length;
+    }
+    else if (kind == "colvec") {
+        shape.kind = VectorKind::Column;
+        shape.rows = length;
+    }
+    else if (kind == "matrix") {
+        shape.kind = VectorKind::Matrix;
+        shape.rows = length;
+        shape.columns = 0;
+        for (uint_least32_t r = 1; r <= length; ++r) {
+            const ManyType& row = vec[r];
+            if (readShape(row,name).kind != VectorKind::Row) {
+                throw UserAlert(UserMessage::UnexpectedType,name);
+            }
+            const uint_least32_t columns = row.getDataVector().size() - 1;
+            if (r > 1 && columns != shape.columns) {
+                throw UserAlert(UserMessage::ShapeMismatch,name);
+            }
+            shape.columns = columns;
+        }
+    }
+    else {
+        throw UserAlert(UserMessage::UnexpectedType,name);
+    }
+    return shape;
+}
+
+/// Finds the element of x that lines up with
+/// row r and column c of the result.
+/// Dimensions of length 1 are repeated.
+/// @param x a value that can be broadcast
+/// @param shape the shape of x
+/// @param r a row of the result
+/// @param c a column of the result
+/// @return the element of x
+inline ManyType& elementAt(ManyType& x, const VectorShape& shape, const uint_least32_t r, const uint_least32_t c) {
+    const uint_least32_t row = (shape.rows == 1) ? 0 : r;
+    const uint_least32_t column = (shape.columns == 1) ? 0 : c;
+    switch (shape.kind) {
+        case VectorKind::Scalar:
+        return x;
+
+        case VectorKind::Row:
+        return x.getDataVector()[1 + column];
+
+        case VectorKind::Column:
+        return x.getDataVector()[1 + row];
+
+        default:
+        return x.getDataVector()[1 + row].getDataVector()[1 + column];
+    }
+}
+
+/// Makes ret a DataVector of the given shape,
+/// with every element None.
+/// @param ret where the DataVector will be placed
+/// @param shape the shape of the DataVector
+void putEmptyVector(ManyType& ret, const VectorShape& shape) {
+    ManyType output;
+    mtvec& vec = output.putDataVector();
+    if (shape.kind == VectorKind::Matrix) {
+        vec.resize(shape.rows + 1);
+        for (uint_least32_t r = 1; r <= shape.rows; ++r) {
+            mtvec& row = vec[r].putDataVector();
+            row.resize(shape.columns + 1);
+            row[0].putStructureString() = vectorKindName(VectorKind::Row);
+        }
+    }
+    else {
+        vec.resize(((shape.kind == VectorKind::Row) ? shape.columns : shape.rows) + 1);
+    }
+    vec[0].putStructureString() = vectorKindName(shape.kind);
+    ret = output;
+}
+
+/// Builds a DataVector from the arguments of a built-in function.
+/// @param ret where the DataVector will be placed
+/// @param arr the function call, [function_name,args...],
+/// the arguments will be taken
+/// @param kind VectorKind::Row or VectorKind::Column for scalar arguments,
+/// VectorKind::Matrix for rowvec arguments of the same length
+/// @param name the built-in function, for errors
+/// @throw UserAlert if an argument is not of the right kind
+void buildVector(ManyType& ret, mtvec& arr, const VectorKind kind, const char* const name) {
+    for (int_fast32_t i = 1; i < arr.size(); ++i) {
+        const VectorShape shape = readShape(arr[i],name);
+        if (kind == VectorKind::Matrix) {
+            if (shape.kind != VectorKind::Row) {
+                throw UserAlert(UserMessage::UnexpectedType,name);
+            }
+            if (i > 1 && shape.columns != arr[i-1].getDataVector().size() - 1) {
+                throw UserAlert(UserMessage::ShapeMismatch,name);
+            }
+        }
+        else {
+            // the elements of a vector are numbers
+            switch (arr[i].type()) {
+                case ManyTypeLabel::None:
+                case ManyTypeLabel::Bool:
+                case ManyTypeLabel::Int:
+                case ManyTypeLabel::Ftype:
+                break;
+
+                default:
+                throw UserAlert(UserMessage::UnexpectedType,name);
+            }
+        }
+    }
+    ManyType output;
+    mtvec& vec = output.putDataVector();
+    vec.resize(arr.size());
+    vec[0].putStructureString() = vectorKindName(kind);
+    for (int_fast32_t i = 1; i < arr.size(); ++i) {
+        vec[i] = arr[i];
+    }
+    ret = output;
+}
+
+/// Applies a scalar function to every element of x.
+/// If x is not a DataVector, the function is applied to x.
+/// @param ret where the result will be placed,
+/// it has the same shape as x
+/// @param x the argument, it may be modified
+/// @param f the scalar function
+/// @param name the built-in function, for errors
+void broadcastUnary(ManyType& ret, ManyType& x, const unaryScalarFunction f, const char* const name) {
+    const VectorShape shape = readShape(x,name);
+    if (shape.kind == VectorKind::Scalar) {
+        f(ret,x);
+        return;
+    }
+    ManyType output;
+    putEmptyVector(output,shape);
+    for (uint_least32_t r = 0; r < shape.rows; ++r) {
+        // a whole row runs without interpretation,
+        // so check the time between rows
+        checkProcessingTime();
+        for (uint_least32_t c = 0; c < shape.columns; ++c) {
+            f(elementAt(output,shape,r,c),elementAt(x,shape,r,c));
+        }
+    }
+    ret = output;
+}
+
+/// Applies a scalar function to the elements of a and b that line up,
+/// following the broadcasting rules of NumPy: each dimension
+/// must be the same, or 1 in one of them, in which case
+/// that one is repeated. Scalars are repeated in both dimensions.
+/// A rowvec combined with a colvec gives a matrix.
+/// @param ret where the result will be placed
+/// @param a the first argument, it may be modified
+/// @param b the second argument, it may be modified
+/// @param f the scalar function
+/// @param name the built-in function, for errors
+/// @throw UserAlert if the shapes can't be broadcast together
+void broadcastBinary(ManyType& ret, ManyType& a, ManyType& b, const binaryScalarFunction f, const char* const name) {
+    const VectorShape shapeA = readShape(a,name);
+    const VectorShape shapeB = readShape(b,name);
+    if (shapeA.kind == VectorKind::Scalar && shapeB.kind == VectorKind::Scalar) {
+        f(ret,a,b);
+        return;
+    }
+    VectorShape shape;
+    if (shapeA.rows != shapeB.rows && shapeA.rows != 1 && shapeB.rows != 1) {
+        throw UserAlert(UserMessage::ShapeMismatch,name);
+    }
+    if (shapeA.columns != shapeB.columns && shapeA.columns != 1 && shapeB.columns != 1) {
+        throw UserAlert(UserMessage::ShapeMismatch,name);
+    }
+    shape.rows = (shapeA.rows == 1) ? shapeB.rows : shapeA.rows;
+    shape.columns = (shapeA.columns == 1) ? shapeB.columns : shapeA.columns;
+    const bool anyRow = (shapeA.kind == VectorKind::Row || shapeB.kind == VectorKind::Row);
+    const bool anyColumn = (shapeA.kind == VectorKind::Column || shapeB.kind == VectorKind::Column);
+    if (shapeA.kind == VectorKind::Matrix || shapeB.kind == VectorKind::Matrix || (shape.rows != 1 && shape.columns != 1)) {
+        shape.kind = VectorKind::Matrix;
+    }
+    else if (shape.rows == 1 && (anyRow || !anyColumn)) {
+        shape.kind = VectorKind::Row;
+    }
+    else {
+        shape.kind = VectorKind::Column;
+    }
+    ManyType output;
+    putEmptyVector(output,shape);
+    for (uint_least32_t r = 0; r < shape.rows; ++r) {
+        // a whole row runs without interpretation,
+        // so check the time between rows
+        checkProcessingTime();
+        for (uint_least32_t c = 0; c < shape.columns; ++c) {
+            f(elementAt(output,shape,r,c),elementAt(a,shapeA,r,c),elementAt(b,shapeB,r,c));
+        }
+    }
+    ret = output;
+}
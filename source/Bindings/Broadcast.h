@@ -0,0 +1,56 @@
+/**
+ * @file Broadcast.h
+ * @author Aaron Stanek
+ * @brief Functions for applying scalar
+ * built-in functions element by element
+ * to vectors and matrices
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+
+/// The kind of value an argument holds, for broadcasting.
+/// A DataVector has the form [kind,elements...],
+/// where kind is the StructureString rowvec, colvec, or matrix.
+/// The elements of a rowvec or colvec are scalars.
+/// The elements of a matrix are its rows,
+/// each a rowvec of the same length.
+enum class VectorKind : uint_fast8_t {
+    /// Anything that is not a DataVector.
+    Scalar,
+    Row,
+    Column,
+    Matrix
+};
+
+/// The dimensions of an argument, for broadcasting.
+/// A scalar is 1 by 1.
+struct VectorShape {
+    VectorKind kind;
+    uint_least32_t rows;
+    uint_least32_t columns;
+};
+
+/// A scalar built-in function of one argument.
+/// The first argument is where the result is placed,
+/// the second may be converted in place.
+typedef void (*unaryScalarFunction)(ManyType&, ManyType&);
+
+/// A scalar built-in function of two arguments.
+/// The first argument is where the result is placed,
+/// the others may be converted in place.
+typedef void (*binaryScalarFunction)(ManyType&, ManyType&, ManyType&);
+
+/// @param x an evaluated argument
+/// @return true if x is a vector or matrix
+inline bool isDataVector(const ManyType& x) noexcept {
+    return x.type() == ManyTypeLabel::DataVector;
+}
+
+VectorShape readShape(const ManyType&, const char* const);
+
+void buildVector(ManyType&, mtvec&, const VectorKind, const char* const);
+
+void broadcastUnary(ManyType&, ManyType&, const unaryScalarFunction, const char* const);
+
+void broadcastBinary(ManyType&, ManyType&, ManyType&, const binaryScalarFunction, const char* const);
@@ -49,22 +49,4 @@ void floatexponent_implement(ManyType& ret, mtvec& arr, long recursionJuice) noe
 
 void floatprecision_implement(ManyType& ret, mtvec& arr, long recursionJuice) noexcept {
     ret.putInt(FTYPE_PRECISION);
-}
-
-void bindConstants() {
-    std::string baseName;
-    baseName = "none";
-    placeBuiltInSymbol(baseName,&none_implement,0,0);
-    baseName = "true";
-    placeBuiltInSymbol(baseName,&true_implement,0,0);
-    baseName = "false";
-    placeBuiltInSymbol(baseName,&false_implement,0,0);
-    baseName = "pi";
-    placeBuiltInSymbol(baseName,&pi_implement,0,0);
-    baseName = "e";
-    placeBuiltInSymbol(baseName,&e_implement,0,0);
-    baseName = "floatexponent";
-    placeBuiltInSymbol(baseName,&floatexponent_implement,0,0);
-    baseName = "floatprecision";
-    placeBuiltInSymbol(baseName,&floatprecision_implement,0,0);
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+/**
+ * @file Control.cpp
+ * @author Aaron Stanek
+*/
+#include "Bindings.h"
+#include "../ManyType/ManyType.h"
+#include "../LowLevelConvert/LowLevelConvert.h"
+#include "../Symbols/Symbols.h"
+#include "../Compute/EvaluateExpression.h"
+#include "../Compute/EvaluateConstExpression.h"
+
+/// Evaluates a delayed argument that may be evaluated
+/// again, and converts the result to bool.
+/// @param x the argument as written, it is not modified
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return the value of x, as a bool
+bool evaluateCondition(const ManyType& x, long recursionJuice) {
+    ManyType condition;
+    evaluateConstExpression(condition,x,recursionJuice);
+    convertToBool(condition);
+    return condition.getBool();
+}
+
+void if2_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 3
+    // arr[1] is the condition
+    // arr[2] is evaluated if the condition is true (delayMask)
+    convertToBool(arr[1]);
+    if (arr[1].getBool()) {
+        // evaluateExpression will evaluate it
+        // so a branch in tail position doesn't nest
+        ret = arr[2];
+    }
+    else {
+        ret.putNone();
+    }
+}
+
+void if3_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 4
+    // arr[1] is the condition
+    // arr[2] is evaluated if the condition is true (delayMask)
+    // arr[3] is evaluated otherwise (delayMask)
+    convertToBool(arr[1]);
+    // evaluateExpression will evaluate the branch
+    // so a branch in tail position doesn't nest
+    ret = arr[arr[1].getBool() ? 2 : 3];
+}
+
+void and_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 3
+    // arr[1] is the first operand
+    // arr[2] is the second, evaluated only if the first is true (delayMask)
+    convertToBool(arr[1]);
+    if (!arr[1].getBool()) {
+        ret.putBool(false);
+        return;
+    }
+    evaluateExpression(arr[2],recursionJuice);
+    convertToBool(arr[2]);
+    ret = arr[2];
+}
+
+void or_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 3
+    // arr[1] is the first operand
+    // arr[2] is the second, evaluated only if the first is false (delayMask)
+    convertToBool(arr[1]);
+    if (arr[1].getBool()) {
+        ret.putBool(true);
+        return;
+    }
+    evaluateExpression(arr[2],recursionJuice);
+    convertToBool(arr[2]);
+    ret = arr[2];
+}
+
+void while_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 3
+    // arr[1] is the condition, evaluated before each iteration (delayMask)
+    // arr[2] is the body, evaluated while the condition is true (delayMask)
+    // returns the value of the last iteration, or none
+    // the iterations run one after another, using no recursion
+    ManyType output;
+    while (true) {
+        // the condition may be a constant
+        // which never checks the time on its own
+        checkProcessingTime();
+        if (!evaluateCondition(arr[1],recursionJuice)) {
+            break;
+        }
+        evaluateConstExpression(output,arr[2],recursionJuice);
+    }
+    ret = output;
+}
+
+void for_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 5
+    // arr[1] is the name of the counter (delayMask)
+    // arr[2] is the first value of the counter
+    // arr[3] is the last value of the counter
+    // arr[4] is the body, evaluated for each value (delayMask)
+    // the counter is assigned before each iteration, as in assign
+    // returns the value of the last iteration, or none
+    if (arr[1].type() != ManyTypeLabel::StructureString) {
+        throw UserAlert(UserMessage::UnexpectedType,"for");
+    }
+    convertToInt(arr[2]);
+    convertToInt(arr[3]);
+    const long first = arr[2].getInt();
+    const long last = arr[3].getInt();
+    ManyType output;
+    ManyType counter;
+    for (long i = first; i <= last; ++i) {
+        checkProcessingTime();
+        counter.putInt(i);
+        placeUserSymbol(arr[1].getStructureString(),counter,0,0);
+        evaluateConstExpression(output,arr[4],recursionJuice);
+        if (i == last) {
+            // ++i would overflow if last is the largest long
+            break;
+        }
+    }
+    ret = output;
+}
+
+void lentargument_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 4
+    // arr[1] is the lendingId of the frame that lent the argument
+    // arr[2] is the index of the argument in that frame
+    // arr[3] is the argument as written (delayMask)
+    // this stands in for a lazy argument in a copy made by copyInFrame,
+    // the argument is evaluated now that the copy is
+    if (arr[1].type() == ManyTypeLabel::Int && arr[2].type() == ManyTypeLabel::Int
+        && readLentArgument(ret,arr[1].getInt(),arr[2].getInt(),recursionJuice)) {
+        // evaluated in the frame, and shared with its other uses
+        return;
+    }
+    // the frame has returned, or is on another thread
+    // evaluateExpression will evaluate the argument
+    ret = arr[3];
+}
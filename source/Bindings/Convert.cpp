@@ -6,31 +6,46 @@
 #include "../LowLevelConvert/LowLevelConvert.h"
 #include "../Symbols/Symbols.h"
 #include "../ManyType/ManyType.h"
+#include "Broadcast.h"
+
+/// Converts a scalar to Bool.
+/// @param ret where the result will be placed
+/// @param x the value to convert, it will be taken
+void boolScalar(ManyType& ret, ManyType& x) {
+    convertToBool(x);
+    ret = x;
+}
+
+/// Converts a scalar to Int.
+/// @param ret where the result will be placed
+/// @param x the value to convert, it will be taken
+void intScalar(ManyType& ret, ManyType& x) {
+    convertToInt(x);
+    ret = x;
+}
+
+/// Converts a scalar to Float.
+/// @param ret where the result will be placed
+/// @param x the value to convert, it will be taken
+void floatScalar(ManyType& ret, ManyType& x) {
+    convertToFtype(x);
+    ret = x;
+}
 
 void bool_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
     // arr must have length 2
-    convertToBool(arr[1]);
-    ret = arr[1];
+    // vectors and matrices are converted element by element
+    broadcastUnary(ret,arr[1],&boolScalar,"Conversion to Bool");
 }
 
 void int_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
     // arr must have length 2
-    convertToInt(arr[1]);
-    ret = arr[1];
+    // vectors and matrices are converted element by element
+    broadcastUnary(ret,arr[1],&intScalar,"Conversion to Int");
 }
 
 void float_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
     // arr must have length 2
-    convertToFtype(arr[1]);
-    ret = arr[1];
-}
-
-void bindConvert() {
-    std::string baseName;
-    baseName = "bool";
-    placeBuiltInSymbol(baseName,&bool_implement,1,0);
-    baseName = "int";
-    placeBuiltInSymbol(baseName,&int_implement,1,0);
-    baseName = "float";
-    placeBuiltInSymbol(baseName,&float_implement,1,0);
+    // vectors and matrices are converted element by element
+    broadcastUnary(ret,arr[1],&floatScalar,"Conversion to Float");
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+/**
+ * @file MapReduce.cpp
+ * @author Aaron Stanek
+*/
+#include "Bindings.h"
+#include "../ManyType/ManyType.h"
+#include "../LowLevelConvert/LowLevelConvert.h"
+#include "../Compute/MapReduce.h"
+
+void map_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 3
+    // arr[1] is the name of a symbol with one argument (delayMask)
+    // arr[2] is a vector or matrix
+    // returns the vector of the symbol called on each element
+    if (arr[1].type() != ManyTypeLabel::StructureString) {
+        throw UserAlert(UserMessage::UnexpectedType,"map");
+    }
+    mapVector(ret,arr[1].getStructureString(),arr[2],recursionJuice);
+}
+
+void filter_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 3
+    // arr[1] is the name of a symbol with one argument (delayMask)
+    // arr[2] is a rowvec or colvec
+    // returns the elements for which the symbol gives true
+    if (arr[1].type() != ManyTypeLabel::StructureString) {
+        throw UserAlert(UserMessage::UnexpectedType,"filter");
+    }
+    filterVector(ret,arr[1].getStructureString(),arr[2],recursionJuice);
+}
+
+void reduce2_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 3
+    // arr[1] is the name of a symbol with two arguments (delayMask)
+    // arr[2] is a vector or matrix
+    // returns the elements combined from left to right
+    if (arr[1].type() != ManyTypeLabel::StructureString) {
+        throw UserAlert(UserMessage::UnexpectedType,"reduce");
+    }
+    reduceVector(ret,arr[1].getStructureString(),arr[2],false,recursionJuice);
+}
+
+void reduce3_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 4
+    // arr[1] is the name of a symbol with two arguments (delayMask)
+    // arr[2] is a vector or matrix
+    // arr[3] is true if the symbol is associative (bool),
+    // so that the elements may be combined on several threads
+    if (arr[1].type() != ManyTypeLabel::StructureString) {
+        throw UserAlert(UserMessage::UnexpectedType,"reduce");
+    }
+    convertToBool(arr[3]);
+    reduceVector(ret,arr[1].getStructureString(),arr[2],arr[3].getBool(),recursionJuice);
+}
@@ -0,0 +1,31 @@
+/**
+ * @file Memory.cpp
+ * @author Aaron Stanek
+*/
+#include "Bindings.h"
+#include "../ManyType/ManyType.h"
+
+/// Stores a byte count in ret.
+/// Uses Int if the value fits, otherwise Float.
+/// @param ret where the result will be placed
+/// @param bytes the value to store
+void putByteCount(ManyType& ret, const size_t bytes) noexcept {
+    if (bytes <= (size_t)(MAX_INTEGER_VALUE)) {
+        ret.putInt(bytes);
+    }
+    else {
+        ret.putFtype(bytes);
+    }
+}
+
+void memoryusage_implement(ManyType& ret, mtvec& arr, long recursionJuice) noexcept {
+    putByteCount(ret,currentMemoryUsage.load());
+}
+
+void memorypeak_implement(ManyType& ret, mtvec& arr, long recursionJuice) noexcept {
+    putByteCount(ret,peakMemoryUsage.load());
+}
+
+void memorylimit_implement(ManyType& ret, mtvec& arr, long recursionJuice) noexcept {
+    putByteCount(ret,maximumMemory);
+}
@@ -0,0 +1,26 @@
+/**
+ * @file Native.cpp
+ * @author Aaron Stanek
+*/
+#include "Bindings.h"
+#include "../ManyType/ManyType.h"
+#include "../LowLevelConvert/LowLevelConvert.h"
+#include "../Compute/Transpile.h"
+
+void native_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 3
+    // arr[1] is the name of a user-defined function (delayMask)
+    // arr[2] is the overload to be compiled (int)
+    // returns true if the function was compiled to
+    // machine code, which its calls now run
+    // returns false if it can't be translated
+    if (arr[1].type() != ManyTypeLabel::StructureString) {
+        throw UserAlert(UserMessage::UnexpectedType,"native");
+    }
+    convertToInt(arr[2]);
+    const long argCount = arr[2].getInt();
+    if (argCount < 0 || argCount >= MAX_ARGS_DEF) {
+        throw UserAlert(UserMessage::DomainError,"native");
+    }
+    ret.putBool(transpileUserSymbol(arr[1].getStructureString(),argCount,recursionJuice));
+}
@@ -0,0 +1,219 @@
+/**
+ * @file Quicken.cpp
+ * @author Aaron Stanek
+*/
+#include "Bindings.h"
+#include "../ManyType/ManyType.h"
+#include "../LowLevelConvert/LowLevelConvert.h"
+
+/// Reads a number whose type is known.
+/// @param x a value of type label
+/// @return the value of x as a Float
+template <ManyTypeLabel label>
+inline ftype readNumber(const ManyType& x) noexcept;
+
+template <>
+inline ftype readNumber<ManyTypeLabel::Bool>(const ManyType& x) noexcept {
+    return x.getBool();
+}
+
+template <>
+inline ftype readNumber<ManyTypeLabel::Int>(const ManyType& x) noexcept {
+    return x.getInt();
+}
+
+template <>
+inline ftype readNumber<ManyTypeLabel::Ftype>(const ManyType& x) noexcept {
+    return x.getFtype();
+}
+
+/// The operation of add.
+struct AddOperation {
+    static inline ftype apply(const ftype a, const ftype b) noexcept {
+        return a + b;
+    };
+    static inline const char* name() noexcept {
+        return "add";
+    };
+};
+
+/// The operation of sub.
+struct SubOperation {
+    static inline ftype apply(const ftype a, const ftype b) noexcept {
+        return a - b;
+    };
+    static inline const char* name() noexcept {
+        return "sub";
+    };
+};
+
+/// add or sub, specialized for arguments of types first and second.
+/// Gives the same results and errors as add_implement and sub_implement.
+/// @param arguments the two arguments, the result replaces the first
+/// @return false if the guard failed
+template <class Operation, ManyTypeLabel first, ManyTypeLabel second>
+bool quickArithmetic(ManyType* arguments) {
+    if (arguments[0].type() != first || arguments[1].type() != second) {
+        return false;
+    }
+    const ftype output = Operation::apply(readNumber<first>(arguments[0]),readNumber<second>(arguments[1]));
+    if (std::isnan(output)) {
+        throw UserAlert(UserMessage::NanError,Operation::name());
+    }
+    if (std::isinf(output)) {
+        throw UserAlert(UserMessage::InfinityError,Operation::name());
+    }
+    arguments[0].putFtype(output);
+    return true;
+}
+
+/// Picks the specialization of add or sub for two arguments.
+/// @param first the type of the first argument
+/// @param second the type of the second argument
+/// @return the specialized function, or nullptr
+/// if there is none for those types
+template <class Operation>
+quickenedFunction quickenArithmetic(const ManyTypeLabel first, const ManyTypeLabel second) noexcept {
+    if (first == ManyTypeLabel::Ftype) {
+        if (second == ManyTypeLabel::Ftype) {
+            return &quickArithmetic<Operation,ManyTypeLabel::Ftype,ManyTypeLabel::Ftype>;
+        }
+        if (second == ManyTypeLabel::Int) {
+            return &quickArithmetic<Operation,ManyTypeLabel::Ftype,ManyTypeLabel::Int>;
+        }
+    }
+    else if (first == ManyTypeLabel::Int) {
+        if (second == ManyTypeLabel::Ftype) {
+            return &quickArithmetic<Operation,ManyTypeLabel::Int,ManyTypeLabel::Ftype>;
+        }
+        if (second == ManyTypeLabel::Int) {
+            return &quickArithmetic<Operation,ManyTypeLabel::Int,ManyTypeLabel::Int>;
+        }
+    }
+    // vectors take the broadcasting path
+    // and the rest are rare
+    return nullptr;
+}
+
+/// A conversion to a type that the argument already has.
+/// @param arguments the argument, which is also the result
+/// @return false if the guard failed
+template <ManyTypeLabel label>
+bool quickIdentity(ManyType* arguments) noexcept {
+    return arguments[0].type() == label;
+}
+
+/// float, specialized for arguments of type label.
+/// @param arguments the argument, the result replaces it
+/// @return false if the guard failed
+template <ManyTypeLabel label>
+bool quickFloat(ManyType* arguments) noexcept {
+    if (arguments[0].type() != label) {
+        return false;
+    }
+    arguments[0].putFtype(readNumber<label>(arguments[0]));
+    return true;
+}
+
+/// int of a Bool argument.
+/// @param arguments the argument, the result replaces it
+/// @return false if the guard failed
+bool quickIntOfBool(ManyType* arguments) noexcept {
+    if (arguments[0].type() != ManyTypeLabel::Bool) {
+        return false;
+    }
+    arguments[0].putInt(arguments[0].getBool());
+    return true;
+}
+
+/// int of a Float argument.
+/// @param arguments the argument, the result replaces it
+/// @return false if the guard failed
+bool quickIntOfFloat(ManyType* arguments) {
+    if (arguments[0].type() != ManyTypeLabel::Ftype) {
+        return false;
+    }
+    // the range check is the slow part, leave it to the conversion
+    convertToInt(arguments[0]);
+    return true;
+}
+
+/// bool of an Int argument.
+/// @param arguments the argument, the result replaces it
+/// @return false if the guard failed
+bool quickBoolOfInt(ManyType* arguments) noexcept {
+    if (arguments[0].type() != ManyTypeLabel::Int) {
+        return false;
+    }
+    arguments[0].putBool(arguments[0].getInt());
+    return true;
+}
+
+/// Picks a form of a built-in function specialized for
+/// the types of its arguments.
+/// Used by the bytecode to rewrite calls whose argument
+/// types stay the same from one call to the next,
+/// or are known from inferTypes.
+/// @param func the built-in function
+/// @param labels the type of each argument
+/// @param argumentCount the number of arguments
+/// @return the specialized function, or nullptr if
+/// func has none for these types
+quickenedFunction quickenBuiltIn(const boundFunction func, const ManyTypeLabel* const labels, const uint_least32_t argumentCount) noexcept {
+    if (argumentCount == 2) {
+        if (func == &add_implement) {
+            return quickenArithmetic<AddOperation>(labels[0],labels[1]);
+        }
+        if (func == &sub_implement) {
+            return quickenArithmetic<SubOperation>(labels[0],labels[1]);
+        }
+        return nullptr;
+    }
+    if (argumentCount != 1) {
+        return nullptr;
+    }
+    const ManyTypeLabel label = labels[0];
+    if (func == &float_implement) {
+        switch (label) {
+            case ManyTypeLabel::Ftype:
+            return &quickIdentity<ManyTypeLabel::Ftype>;
+
+            case ManyTypeLabel::Int:
+            return &quickFloat<ManyTypeLabel::Int>;
+
+            case ManyTypeLabel::Bool:
+            return &quickFloat<ManyTypeLabel::Bool>;
+
+            default:
+            return nullptr;
+        }
+    }
+    if (func == &int_implement) {
+        switch (label) {
+            case ManyTypeLabel::Int:
+            return &quickIdentity<ManyTypeLabel::Int>;
+
+            case ManyTypeLabel::Ftype:
+            return &quickIntOfFloat;
+
+            case ManyTypeLabel::Bool:
+            return &quickIntOfBool;
+
+            default:
+            return nullptr;
+        }
+    }
+    if (func == &bool_implement) {
+        switch (label) {
+            case ManyTypeLabel::Bool:
+            return &quickIdentity<ManyTypeLabel::Bool>;
+
+            case ManyTypeLabel::Int:
+            return &quickBoolOfInt;
+
+            default:
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
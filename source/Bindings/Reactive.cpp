@@ -0,0 +1,22 @@
+/**
+ * @file Reactive.cpp
+ * @author Aaron Stanek
+*/
+#include "Bindings.h"
+#include "../ManyType/ManyType.h"
+#include "../LowLevelConvert/LowLevelConvert.h"
+#include "../Compute/Reactive.h"
+
+void reactive0_implement(ManyType& ret, mtvec& arr, long recursionJuice) noexcept {
+    // reports whether reactive mode is on
+    ret.putBool(reactiveEnabled);
+}
+
+void reactive1_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 2
+    // arr[1] turns reactive mode on or off
+    // returns the new mode
+    convertToBool(arr[1]);
+    setReactiveMode(arr[1].getBool());
+    ret.putBool(reactiveEnabled);
+}
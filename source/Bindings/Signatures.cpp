@@ -0,0 +1,150 @@
+/**
+ * @file Signatures.cpp
+ * @author Aaron Stanek
+*/
+#include "Bindings.h"
+#include "../ManyType/ManyType.h"
+#include "../Compute/InferTypes.h"
+
+/// @param types the possible types of an argument
+/// @return true if the argument may be a vector or matrix
+inline bool mayBeVector(const ManyTypeLabelInt types) noexcept {
+    return types & (ManyTypeLabelInt)(ManyTypeLabel::DataVector);
+}
+
+/// @param types the possible types of an argument
+/// @return true if the argument may be something other than a vector
+inline bool mayBeScalar(const ManyTypeLabelInt types) noexcept {
+    return types & ~(ManyTypeLabelInt)(ManyTypeLabel::DataVector);
+}
+
+/// The result of a built-in function that broadcasts,
+/// and gives scalar for scalar arguments.
+/// @param scalar the type of the result for scalar arguments
+/// @param argumentTypes the possible types of each argument
+/// @param argumentCount the number of arguments
+/// @return the possible types of the result
+ManyTypeLabelInt broadcastResultTypes(const ManyTypeLabel scalar, const ManyTypeLabelInt* const argumentTypes, const uint_least32_t argumentCount) noexcept {
+    bool scalars = true;
+    bool vectors = false;
+    for (uint_least32_t i = 0; i < argumentCount; ++i) {
+        scalars = scalars && mayBeScalar(argumentTypes[i]);
+        vectors = vectors || mayBeVector(argumentTypes[i]);
+    }
+    ManyTypeLabelInt output = 0;
+    if (scalars) {
+        output |= (ManyTypeLabelInt)(scalar);
+    }
+    if (vectors) {
+        output |= (ManyTypeLabelInt)(ManyTypeLabel::DataVector);
+    }
+    return output;
+}
+
+/// Finds the types that a built-in function may return,
+/// given the types that its arguments may have.
+/// Arguments that the function delays are not evaluated,
+/// so their types are not used.
+/// @param func the built-in function
+/// @param argumentTypes the possible types of each argument,
+/// each a bitmask of ManyTypeLabel values
+/// @param argumentCount the number of arguments
+/// @return a bitmask of the possible types of the result,
+/// 0 if the call can't succeed
+ManyTypeLabelInt builtInResultTypes(const boundFunction func, const ManyTypeLabelInt* const argumentTypes, const uint_least32_t argumentCount) noexcept {
+    // Arithmetic.cpp
+    if (func == &add_implement || func == &sub_implement) {
+        return broadcastResultTypes(ManyTypeLabel::Ftype,argumentTypes,argumentCount);
+    }
+    // Convert.cpp
+    if (func == &bool_implement) {
+        return broadcastResultTypes(ManyTypeLabel::Bool,argumentTypes,argumentCount);
+    }
+    if (func == &int_implement) {
+        return broadcastResultTypes(ManyTypeLabel::Int,argumentTypes,argumentCount);
+    }
+    if (func == &float_implement) {
+        return broadcastResultTypes(ManyTypeLabel::Ftype,argumentTypes,argumentCount);
+    }
+    // Constants.cpp
+    if (func == &none_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::None);
+    }
+    if (func == &true_implement || func == &false_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Bool);
+    }
+    if (func == &pi_implement || func == &e_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Ftype);
+    }
+    if (func == &floatexponent_implement || func == &floatprecision_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Int);
+    }
+    // Assign.cpp
+    if (func == &assign_implement) {
+        // the assigned value
+        return (argumentCount == 2) ? argumentTypes[1] : 0;
+    }
+    if (func == &arrow_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::None);
+    }
+    if (func == &remove1_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Int);
+    }
+    if (func == &remove2_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Bool);
+    }
+    // Memory.cpp
+    if (func == &memoryusage_implement || func == &memorypeak_implement || func == &memorylimit_implement) {
+        // counts too large for Int are Float
+        return (ManyTypeLabelInt)(ManyTypeLabel::Int) | (ManyTypeLabelInt)(ManyTypeLabel::Ftype);
+    }
+    // Reactive.cpp
+    if (func == &reactive0_implement || func == &reactive1_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Bool);
+    }
+    // Vector.cpp, Batch.cpp
+    if (func == &rowvec_implement || func == &colvec_implement || func == &matrix_implement || func == &batch_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::DataVector);
+    }
+    // MapReduce.cpp
+    // reduce gives whatever its symbol gives
+    if (func == &map_implement || func == &filter_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::DataVector);
+    }
+    // Control.cpp
+    // the branches and bodies are delayed,
+    // but builtInEvaluatesDelayedArguments has their types found
+    if (func == &if2_implement) {
+        return argumentTypes[1] | (ManyTypeLabelInt)(ManyTypeLabel::None);
+    }
+    if (func == &if3_implement) {
+        return argumentTypes[1] | argumentTypes[2];
+    }
+    if (func == &and_implement || func == &or_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Bool);
+    }
+    if (func == &while_implement) {
+        // none if the body never runs
+        return argumentTypes[1] | (ManyTypeLabelInt)(ManyTypeLabel::None);
+    }
+    if (func == &for_implement) {
+        return argumentTypes[3] | (ManyTypeLabelInt)(ManyTypeLabel::None);
+    }
+    // Types.cpp
+    if (func == &infer_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::DataString);
+    }
+    // Native.cpp
+    if (func == &native_implement) {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Bool);
+    }
+    return ANY_DATA_TYPE;
+}
+
+/// @param func a built-in function
+/// @return true if func evaluates its delayed arguments as they are written,
+/// so their types are those of expressions in the same place
+bool builtInEvaluatesDelayedArguments(const boundFunction func) noexcept {
+    return func == &if2_implement || func == &if3_implement || func == &and_implement
+        || func == &or_implement || func == &while_implement || func == &for_implement;
+}
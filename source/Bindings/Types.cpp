@@ -0,0 +1,63 @@
+/**
+ * @file Types.cpp
+ * @author Aaron Stanek
+*/
+#include "Bindings.h"
+#include "../ManyType/ManyType.h"
+#include "../Compute/InferTypes.h"
+#include <vector>
+
+/// @param name a type name written by the user
+/// @return the types it stands for, as a bitmask of ManyTypeLabel values
+/// @throw UserAlert if it is not a type name
+ManyTypeLabelInt readTypeName(const ManyType& name) {
+    if (name.type() != ManyTypeLabel::StructureString) {
+        throw UserAlert(UserMessage::UnexpectedType,"infer");
+    }
+    const mtstring& s = name.getStructureString();
+    if (s == "none") {
+        return (ManyTypeLabelInt)(ManyTypeLabel::None);
+    }
+    if (s == "bool") {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Bool);
+    }
+    if (s == "int") {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Int);
+    }
+    if (s == "float") {
+        return (ManyTypeLabelInt)(ManyTypeLabel::Ftype);
+    }
+    if (s == "string") {
+        return (ManyTypeLabelInt)(ManyTypeLabel::DataString);
+    }
+    if (s == "vector") {
+        return (ManyTypeLabelInt)(ManyTypeLabel::DataVector);
+    }
+    if (s == "any") {
+        return ANY_DATA_TYPE;
+    }
+    throw UserAlert(UserMessage::UnexpectedType,"infer");
+}
+
+void infer_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr has length 2
+    // arr[1] is a call whose arguments are type names (delayMask)
+    // such as f(int,any), or the name of a variable
+    // returns the types the call may give, such as "Float|Vector"
+    if (arr[1].type() == ManyTypeLabel::StructureString) {
+        // wrap it into a function-like
+        arr[1].wrapInVector();
+    }
+    if (arr[1].type() != ManyTypeLabel::StructureVector) {
+        throw UserAlert(UserMessage::UnexpectedType,"infer");
+    }
+    const mtvec& call = arr[1].getStructureVector();
+    std::vector<ManyTypeLabelInt> argumentTypes(call.size() - 1);
+    for (int_fast32_t i = 1; i < call.size(); ++i) {
+        argumentTypes[i-1] = readTypeName(call[i]);
+    }
+    const ManyTypeLabelInt types = inferCallTypes(call[0].getStructureString(),argumentTypes,recursionJuice);
+    ManyType output;
+    describeTypes(output.putDataString(),types);
+    ret = output;
+}
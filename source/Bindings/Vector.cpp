@@ -0,0 +1,26 @@
+/**
+ * @file Vector.cpp
+ * @author Aaron Stanek
+*/
+#include "Bindings.h"
+#include "../ManyType/ManyType.h"
+#include "Broadcast.h"
+
+void rowvec_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr may have any length
+    // arr[1...] are the elements, which must be numbers
+    buildVector(ret,arr,VectorKind::Row,"rowvec");
+}
+
+void colvec_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr may have any length
+    // arr[1...] are the elements, which must be numbers
+    buildVector(ret,arr,VectorKind::Column,"colvec");
+}
+
+void matrix_implement(ManyType& ret, mtvec& arr, long recursionJuice) {
+    // arr may have any length
+    // arr[1...] are the rows, which must be
+    // rowvecs of the same length
+    buildVector(ret,arr,VectorKind::Matrix,"matrix");
+}
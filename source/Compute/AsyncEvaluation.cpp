@@ -0,0 +1,266 @@
+/**
+ * @file AsyncEvaluation.cpp
+ * @author Aaron Stanek
+*/
+#include "AsyncEvaluation.h"
+#include "EvaluateExpression.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <thread>
+
+/// The thread that runs submitted evaluations.
+/// The symbol table and the processing clock are shared
+/// by the whole program, so evaluations run one at a time,
+/// in the order they were submitted.
+/// Work within one evaluation may still use the worker threads.
+struct EvaluationExecutor {
+    /// Guards every other field.
+    /// Taken before the mutex of any AsyncEvaluation.
+    std::mutex mutex;
+    /// Notified when an evaluation is queued.
+    std::condition_variable wake;
+    std::deque<EvaluationHandle> queue;
+    /// The evaluation on the executor thread, if any.
+    /// cancelProcessing may only be called while it is set.
+    EvaluationHandle running;
+    /// Started by the first call to submitEvaluation.
+    std::thread thread;
+    bool started;
+    /// Set by shutdownEvaluations.
+    bool stopping;
+    EvaluationExecutor() : started(false), stopping(false) {};
+};
+
+EvaluationExecutor executor;
+
+/// @param status the status of an AsyncEvaluation
+/// @return true if it will not change again
+inline bool evaluationIsSettled(const EvaluationStatus status) noexcept {
+    return status != EvaluationStatus::Queued && status != EvaluationStatus::Running;
+}
+
+/// Records how an evaluation ended, wakes anyone
+/// waiting for it, then calls its callback.
+/// @param evaluation the evaluation
+/// @param status Finished, Failed, or Cancelled
+/// @param value the result, it will be taken
+/// @param error what the evaluation threw, if anything
+void settleEvaluation(AsyncEvaluation& evaluation, const EvaluationStatus status, ManyType& value, const std::exception_ptr& error) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(evaluation.mutex);
+        evaluation.value = value;
+        evaluation.error = error;
+        evaluation.status = status;
+    }
+    evaluation.done.notify_all();
+    if (evaluation.callback) {
+        evaluation.callback(evaluation.context,evaluation);
+    }
+}
+
+/// The body of the executor thread.
+/// Takes evaluations from the queue until the program exits.
+void executorMain() {
+    while (true) {
+        EvaluationHandle evaluation;
+        ManyType value;
+        {
+            std::unique_lock<std::mutex> lock(executor.mutex);
+            executor.wake.wait(lock,[]() {
+                return executor.stopping || !executor.queue.empty();
+            });
+            if (executor.stopping) {
+                return;
+            }
+            evaluation = executor.queue.front();
+            executor.queue.pop_front();
+            {
+                std::lock_guard<std::mutex> evaluationLock(evaluation->mutex);
+                evaluation->status = EvaluationStatus::Running;
+                value = evaluation->value;
+            }
+            // while the lock is held, so that a cancellation
+            // meant for the previous evaluation can't reach this one
+            executor.running = evaluation;
+            startProcessing();
+        }
+        EvaluationStatus status = EvaluationStatus::Finished;
+        std::exception_ptr error;
+        try {
+            evaluateExpression(value,maximumRecursionDepth);
+        }
+        catch (UserAlert& e) {
+            status = (e.base == UserMessage::Cancelled) ? EvaluationStatus::Cancelled : EvaluationStatus::Failed;
+            error = std::current_exception();
+        }
+        catch (...) {
+            status = EvaluationStatus::Failed;
+            error = std::current_exception();
+        }
+        // limits changed by the evaluation take effect
+        // for the next one, as they do between prompts
+        applyNewLimits();
+        {
+            std::lock_guard<std::mutex> lock(executor.mutex);
+            executor.running.reset();
+        }
+        settleEvaluation(*evaluation,status,value,error);
+    }
+}
+
+/// Stops the executor thread. The running evaluation is cancelled,
+/// and evaluations still in the queue are settled as Cancelled.
+/// Evaluations submitted afterwards are settled as Cancelled right away.
+/// It is registered with atexit when the executor thread starts,
+/// so that the thread is gone before the symbol table is destroyed,
+/// but it may be called earlier. Calling it again does nothing.
+/// Must not be called from a callback.
+void shutdownEvaluations() noexcept {
+    std::deque<EvaluationHandle> queued;
+    {
+        std::lock_guard<std::mutex> lock(executor.mutex);
+        if (executor.stopping) {
+            return;
+        }
+        executor.stopping = true;
+        if (executor.running) {
+            cancelProcessing();
+        }
+        queued.swap(executor.queue);
+    }
+    executor.wake.notify_all();
+    if (executor.started) {
+        executor.thread.join();
+    }
+    for (const EvaluationHandle& evaluation : queued) {
+        ManyType expression;
+        settleEvaluation(*evaluation,EvaluationStatus::Cancelled,expression,std::exception_ptr());
+    }
+}
+
+/// Queues an expression to be evaluated on the executor thread,
+/// after every expression submitted before it.
+/// After shutdownEvaluations, it is settled as Cancelled instead.
+/// Each evaluation gets the full maximumProcessingTime,
+/// counted from when it starts running.
+/// While any evaluation is queued or running, the caller
+/// must not evaluate expressions on other threads.
+/// @param expression the expression, it will be taken
+/// @param callback called on the executor thread once the evaluation
+/// has finished, failed, or been cancelled, or nullptr.
+/// If it is cancelled before it runs, callback is called
+/// on the thread that cancelled it instead.
+/// @param context passed to callback
+/// @return the handle used to wait for, poll, or cancel the evaluation
+/// @throw std::bad_alloc or std::system_error if the evaluation
+/// could not be queued, in which case expression is unchanged
+EvaluationHandle submitEvaluation(ManyType& expression, const evaluationCallback callback, void* const context) {
+    EvaluationHandle evaluation = std::make_shared<AsyncEvaluation>();
+    evaluation->status = EvaluationStatus::Queued;
+    evaluation->callback = callback;
+    evaluation->context = context;
+    {
+        std::lock_guard<std::mutex> lock(executor.mutex);
+        if (!executor.stopping) {
+            if (!executor.started) {
+                if (std::atexit(&shutdownEvaluations) != 0) {
+                    throw std::bad_alloc();
+                }
+                executor.thread = std::thread(&executorMain);
+                executor.started = true;
+            }
+            executor.queue.push_back(evaluation);
+            // nothing can throw after this
+            evaluation->value = expression;
+            executor.wake.notify_one();
+            return evaluation;
+        }
+    }
+    ManyType none;
+    settleEvaluation(*evaluation,EvaluationStatus::Cancelled,none,std::exception_ptr());
+    return evaluation;
+}
+
+/// @param evaluation the handle returned by submitEvaluation
+/// @return the status of the evaluation, without waiting
+EvaluationStatus pollEvaluation(const EvaluationHandle& evaluation) noexcept {
+    std::lock_guard<std::mutex> lock(evaluation->mutex);
+    return evaluation->status;
+}
+
+/// Waits until an evaluation has finished, failed, or been cancelled.
+/// Its callback may not have returned yet.
+/// Must not be called from a callback.
+/// @param evaluation the handle returned by submitEvaluation
+/// @return Finished, Failed, or Cancelled
+EvaluationStatus waitForEvaluation(const EvaluationHandle& evaluation) noexcept {
+    std::unique_lock<std::mutex> lock(evaluation->mutex);
+    evaluation->done.wait(lock,[&evaluation]() {
+        return evaluationIsSettled(evaluation->status);
+    });
+    return evaluation->status;
+}
+
+/// Waits until an evaluation has finished, failed, or been cancelled,
+/// or until some time has passed.
+/// @param evaluation the handle returned by submitEvaluation
+/// @param seconds the longest time to wait
+/// @return the status of the evaluation, Queued or Running if time ran out
+EvaluationStatus waitForEvaluation(const EvaluationHandle& evaluation, const double seconds) noexcept {
+    std::unique_lock<std::mutex> lock(evaluation->mutex);
+    evaluation->done.wait_for(lock,std::chrono::duration<double>(seconds),[&evaluation]() {
+        return evaluationIsSettled(evaluation->status);
+    });
+    return evaluation->status;
+}
+
+/// Stops an evaluation. If it has not started, it is taken off
+/// the queue and settled as Cancelled right away. If it is running,
+/// it stops with a Cancelled alert within PROCESSING_FUEL_PER_SAMPLE
+/// steps, unless it finishes first.
+/// @param evaluation the handle returned by submitEvaluation
+/// @return false if the evaluation had already finished,
+/// failed, or been cancelled
+bool cancelEvaluation(const EvaluationHandle& evaluation) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(executor.mutex);
+        std::lock_guard<std::mutex> evaluationLock(evaluation->mutex);
+        if (evaluation->status == EvaluationStatus::Running) {
+            if (executor.running == evaluation) {
+                // it has not returned from evaluateExpression
+                cancelProcessing();
+            }
+            return true;
+        }
+        if (evaluation->status != EvaluationStatus::Queued) {
+            return false;
+        }
+        executor.queue.erase(std::find(executor.queue.begin(),executor.queue.end(),evaluation));
+    }
+    ManyType expression;
+    settleEvaluation(*evaluation,EvaluationStatus::Cancelled,expression,std::exception_ptr());
+    return true;
+}
+
+/// Waits for an evaluation, then takes its result.
+/// The result can only be taken once, after that it is None.
+/// @param ret where the result will be placed
+/// @param evaluation the handle returned by submitEvaluation
+/// @throw UserAlert or whatever else the evaluation threw,
+/// or a Cancelled alert if it was cancelled before it ran
+void takeEvaluationResult(ManyType& ret, const EvaluationHandle& evaluation) {
+    waitForEvaluation(evaluation);
+    std::lock_guard<std::mutex> lock(evaluation->mutex);
+    if (evaluation->error) {
+        std::rethrow_exception(evaluation->error);
+    }
+    if (evaluation->status == EvaluationStatus::Cancelled) {
+        throw UserAlert(UserMessage::Cancelled,nullptr);
+    }
+    ManyType output;
+    output = evaluation->value;
+    ret = output;
+}
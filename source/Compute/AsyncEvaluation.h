@@ -0,0 +1,70 @@
+/**
+ * @file AsyncEvaluation.h
+ * @author Aaron Stanek
+ * @brief Functions for evaluating expressions
+ * on a background thread, so that the caller
+ * can wait for them, poll them, or cancel them
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+/// The progress of an AsyncEvaluation.
+enum class EvaluationStatus : uint_fast8_t {
+    /// Waiting for the evaluations submitted before it.
+    Queued,
+    /// Being evaluated on the executor thread.
+    Running,
+    /// The result is ready.
+    Finished,
+    /// The evaluation threw, the error is ready.
+    Failed,
+    /// cancelEvaluation stopped it.
+    Cancelled
+};
+
+struct AsyncEvaluation;
+
+/// A function called once an evaluation has finished,
+/// failed, or been cancelled.
+/// The first argument is the context passed to submitEvaluation.
+/// It must not throw, and must not wait for another evaluation.
+typedef void (*evaluationCallback)(void*, AsyncEvaluation&);
+
+/// An expression passed to submitEvaluation.
+/// Read it with the functions below, not directly.
+struct AsyncEvaluation {
+    /// Guards every other field.
+    std::mutex mutex;
+    /// Notified when status becomes Finished, Failed, or Cancelled.
+    std::condition_variable done;
+    EvaluationStatus status;
+    /// The expression, and then its result.
+    ManyType value;
+    /// What the evaluation threw, if status is Failed or Cancelled.
+    std::exception_ptr error;
+    evaluationCallback callback;
+    void* context;
+};
+
+/// Shared by the caller and the executor,
+/// so that either may let go of it first.
+typedef std::shared_ptr<AsyncEvaluation> EvaluationHandle;
+
+EvaluationHandle submitEvaluation(ManyType&, const evaluationCallback, void* const);
+
+EvaluationStatus pollEvaluation(const EvaluationHandle&) noexcept;
+
+EvaluationStatus waitForEvaluation(const EvaluationHandle&) noexcept;
+
+EvaluationStatus waitForEvaluation(const EvaluationHandle&, const double) noexcept;
+
+bool cancelEvaluation(const EvaluationHandle&) noexcept;
+
+void takeEvaluationResult(ManyType&, const EvaluationHandle&);
+
+void shutdownEvaluations() noexcept;
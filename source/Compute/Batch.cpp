@@ -0,0 +1,207 @@
+/**
+ * @file Batch.cpp
+ * @author Aaron Stanek
+*/
+#include "Batch.h"
+#include "EvaluateConstExpression.h"
+#include "ParameterSlots.h"
+#include "Memoize.h"
+#include "../Bindings/Broadcast.h"
+#include <memory>
+#include <string>
+
+/// Finds the number of rows shared by the columns.
+/// rowvecs are read as columns, and other values
+/// are repeated for every row.
+/// @param columns [None,columns...]
+/// @return the number of rows, 1 if every column is a single value
+/// @throw UserAlert if two columns have different lengths,
+/// or a column is a matrix
+uint_least32_t countRows(const mtvec& columns) {
+    uint_least32_t rows = 1;
+    bool found = false;
+    for (int_fast32_t i = 1; i < columns.size(); ++i) {
+        const VectorShape shape = readShape(columns[i],"batch");
+        if (shape.kind == VectorKind::Scalar) {
+            continue;
+        }
+        if (shape.kind == VectorKind::Matrix) {
+            throw UserAlert(UserMessage::UnexpectedType,"batch");
+        }
+        const uint_least32_t length = columns[i].getDataVector().size() - 1;
+        if (found && length != rows) {
+            throw UserAlert(UserMessage::ShapeMismatch,"batch");
+        }
+        rows = length;
+        found = true;
+    }
+    return rows;
+}
+
+/// @param x an evaluated value
+/// @return true if x can be an element of a colvec
+inline bool isScalarNumber(const ManyType& x) noexcept {
+    switch (x.type()) {
+        case ManyTypeLabel::None:
+        case ManyTypeLabel::Bool:
+        case ManyTypeLabel::Int:
+        case ManyTypeLabel::Ftype:
+        return true;
+
+        default:
+        return false;
+    }
+}
+
+/// Evaluates the body of definition once, with whole columns
+/// in place of its local variables, so that built-in functions
+/// that broadcast run over every row in one native loop.
+/// @param ret where the colvec will be placed, if this succeeds
+/// @param definition [expression,names...]
+/// @param slots the local variable names of definition
+/// @param columns [None,columns...], they are copied, not taken
+/// @param rows the number of rows
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if the expression did not give one value per row,
+/// in which case the rows must be evaluated one at a time
+bool evaluateColumns(ManyType& ret, const ManyType& definition, const ParameterSlots& slots, const mtvec& columns, const uint_least32_t rows, long recursionJuice) {
+    mtvec arguments;
+    arguments.resize(columns.size());
+    for (int_fast32_t i = 1; i < columns.size(); ++i) {
+        arguments[i].makeCopyFrom(columns[i],recursionJuice);
+        if (isDataVector(arguments[i])) {
+            // a rowvec is read as a column
+            arguments[i].getDataVector()[0].putStructureString() = "colvec";
+        }
+    }
+    Frame frame(arguments);
+    ManyType result;
+    try {
+        evaluateInFrame(result,definition.getStructureVector()[0],&(slots.body),&frame,recursionJuice);
+    }
+    catch (UserAlert& e) {
+        if (e.base == UserMessage::UnexpectedType || e.base == UserMessage::ShapeMismatch) {
+            // something in the expression doesn't take vectors
+            return false;
+        }
+        throw;
+    }
+    if (isScalarNumber(result)) {
+        // the expression doesn't depend on the columns
+        ManyType output;
+        mtvec& vec = output.putDataVector();
+        vec.resize(rows + 1);
+        vec[0].putStructureString() = "colvec";
+        for (uint_least32_t r = 1; r <= rows; ++r) {
+            vec[r].makeCopyFrom(result,recursionJuice);
+        }
+        ret = output;
+        return true;
+    }
+    const VectorShape shape = readShape(result,"batch");
+    if (shape.kind != VectorKind::Column || shape.rows != rows) {
+        return false;
+    }
+    ret = result;
+    return true;
+}
+
+/// Evaluates the body of definition once per row,
+/// with the elements of that row in place of its local variables.
+/// The expression is not parsed or searched again between rows.
+/// @param ret where the colvec will be placed
+/// @param definition [expression,names...]
+/// @param slots the local variable names of definition
+/// @param columns [None,columns...], they are not modified
+/// @param rows the number of rows
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @throw UserAlert if the expression gives something other than a number
+void evaluateRows(ManyType& ret, const ManyType& definition, const ParameterSlots& slots, const mtvec& columns, const uint_least32_t rows, long recursionJuice) {
+    const ManyType& body = definition.getStructureVector()[0];
+    ManyType output;
+    mtvec& vec = output.putDataVector();
+    vec.resize(rows + 1);
+    vec[0].putStructureString() = "colvec";
+    mtvec arguments;
+    arguments.resize(columns.size());
+    for (uint_least32_t r = 0; r < rows; ++r) {
+        for (int_fast32_t i = 1; i < columns.size(); ++i) {
+            if (isDataVector(columns[i])) {
+                arguments[i].makeCopyFrom(columns[i].getDataVector()[1 + r],recursionJuice);
+            }
+            else {
+                arguments[i].makeCopyFrom(columns[i],recursionJuice);
+            }
+        }
+        Frame frame(arguments);
+        evaluateInFrame(vec[1 + r],body,&(slots.body),&frame,recursionJuice);
+        if (!isScalarNumber(vec[1 + r])) {
+            throw UserAlert(UserMessage::UnexpectedType,"batch");
+        }
+    }
+    ret = output;
+}
+
+/// Evaluates an expression for every row of a set of columns,
+/// without parsing it or finding its local variables more than once.
+/// If everything the expression calls is pure, it is first
+/// evaluated once with whole columns, so that the built-in functions
+/// that broadcast do the work. If that doesn't give one value per row,
+/// each row is evaluated by itself.
+/// @param ret where the result will be placed, a colvec with one element per row
+/// @param definition [expression,names...], as in UserSymbol::definition,
+/// the names are the local variables of expression.
+/// It must not move or change during this call.
+/// @param columns [None,columns...], one for each name.
+/// Each column is a colvec or rowvec, all of the same length,
+/// or a single value used for every row. They are not modified.
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @throw UserAlert if the columns don't fit the definition,
+/// or the expression fails for some row
+void evaluateBatch(ManyType& ret, const ManyType& definition, mtvec& columns, long recursionJuice) {
+    if (definition.type() != ManyTypeLabel::StructureVector || definition.getStructureVector().size() != columns.size()) {
+        throw UserAlert(UserMessage::WrongNumberOfArguments,"batch");
+    }
+    const std::unique_ptr<ParameterSlots> slots(findParameterSlots(definition,recursionJuice));
+    if (!slots) {
+        // delayed local variables can't be given values
+        throw UserAlert(UserMessage::UnexpectedType,"batch");
+    }
+    const uint_least32_t rows = countRows(columns);
+    // an expression with side effects must run once per row
+    bool pure = false;
+    const std::unique_ptr<MemoTable> memo(findMemoTable(definition,*slots,recursionJuice));
+    if (memo) {
+        std::lock_guard<std::mutex> lock(memoMutex);
+        pure = memoIsUsable(*memo,recursionJuice);
+    }
+    if (pure && evaluateColumns(ret,definition,*slots,columns,rows,recursionJuice)) {
+        return;
+    }
+    evaluateRows(ret,definition,*slots,columns,rows,recursionJuice);
+}
+
+/// Calls a symbol once for every row of a set of columns.
+/// @param ret where the result will be placed, a colvec with one element per row
+/// @param baseName the symbol to call, with one argument per column
+/// @param columns [None,columns...], as in evaluateBatch
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void callBatch(ManyType& ret, const mtstring& baseName, mtvec& columns, long recursionJuice) {
+    if (columns.size() > MAX_ARGS_USED) {
+        throw UserAlert(UserMessage::TooManyArguments,"In Call");
+    }
+    // the expression is baseName(x1,x2,...),
+    // with the local variables x1,x2,...
+    ManyType definition;
+    mtvec& definitionVec = definition.putStructureVector();
+    definitionVec.resize(columns.size());
+    mtvec& call = definitionVec[0].putStructureVector();
+    call.resize(columns.size());
+    call[0].putStructureString() = baseName;
+    for (int_fast32_t i = 1; i < columns.size(); ++i) {
+        const std::string name = "x" + std::to_string(i);
+        call[i].putStructureString() = name.c_str();
+        definitionVec[i].putStructureString() = name.c_str();
+    }
+    evaluateBatch(ret,definition,columns,recursionJuice);
+}
@@ -0,0 +1,13 @@
+/**
+ * @file Batch.h
+ * @author Aaron Stanek
+ * @brief Functions for evaluating one expression
+ * over columns of values for its local variables
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+
+void evaluateBatch(ManyType&, const ManyType&, mtvec&, long);
+
+void callBatch(ManyType&, const mtstring&, mtvec&, long);
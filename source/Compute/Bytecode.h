@@ -0,0 +1,135 @@
+/**
+ * @file Bytecode.h
+ * @author Aaron Stanek
+ * @brief Structs describing the bytecode
+ * that user-defined functions are compiled to
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "../Symbols/Symbols.h"
+#include "ParameterSlots.h"
+
+/// Identifies the operation performed by an Instruction.
+/// The bytecode runs on a stack of ManyType values.
+enum class Opcode : uint_fast8_t {
+    /// Pushes a copy of constants[operand].
+    PushConstant,
+    /// Pushes a copy of argument number operand
+    /// of the running function (counting from 1).
+    PushArgument,
+    /// Pushes argument number operand of the running function
+    /// without copying it. Used for the last use of each argument.
+    MoveArgument,
+    /// Pops callSites[operand].argumentCount values,
+    /// calls the built-in function fixed at compile time,
+    /// and pushes the result.
+    /// Rewritten to CallQuickened once the types of
+    /// the arguments have been seen.
+    CallBuiltIn,
+    /// Calls callSites[operand].quickened on the top
+    /// callSites[operand].argumentCount values, and replaces them
+    /// with the result. If they are not of the types it was
+    /// specialized for, the call is made as in CallBuiltIn.
+    CallQuickened,
+    /// Looks up the symbol of callSites[operand].
+    /// If the symbol delays any of its arguments, the call
+    /// is evaluated from its source and execution
+    /// continues at callSites[operand].skip.
+    ResolveSymbol,
+    /// Pops callSites[operand].argumentCount values,
+    /// calls the symbol found by the matching ResolveSymbol,
+    /// and pushes the result.
+    CallSymbol,
+    /// Copies the top value of the stack into local number operand.
+    /// Written after the first appearance of a common sub-expression.
+    StoreLocal,
+    /// Pushes a copy of local number operand.
+    /// Written in place of the later appearances of a common
+    /// sub-expression. If the StoreLocal was skipped, the
+    /// sub-expression is evaluated from localSources[operand].
+    PushLocal,
+    /// Continues at instruction number operand.
+    Jump,
+    /// Pops the top value and converts it to bool.
+    /// If it is false, continues at instruction number operand.
+    JumpIfFalse,
+    /// Converts the top value to bool.
+    ConvertToBool,
+    /// Pops the result of the function and stops.
+    Return
+};
+
+/// The number of times a CallBuiltIn runs
+/// before it is specialized for the types of its arguments.
+#define QUICKEN_AFTER_CALLS 2
+/// The number of times a CallQuickened may be specialized
+/// again for other types before it stays a CallBuiltIn.
+#define MAX_QUICKENINGS 4
+
+/// A single bytecode instruction.
+/// Jumps only ever go forward.
+struct Instruction {
+    Opcode opcode;
+    /// An index, its meaning depends on opcode.
+    uint_least32_t operand;
+};
+
+/// Everything known about one function call in a
+/// compiled function body.
+struct CallSite {
+    /// The symbol that was resolved most recently.
+    /// For CallBuiltIn this is fixed at compile time.
+    const SymbolTableElement* element;
+    /// The value of symbolTableGeneration
+    /// when element was resolved.
+    unsigned long generation;
+    /// The number of arguments passed by this call.
+    uint_least32_t argumentCount;
+    /// The index of the instruction after
+    /// the CallSymbol of this call.
+    uint_least32_t skip;
+    /// The argCount passed to readSymbol.
+    char argCount;
+    /// The basename of the called symbol.
+    mtstring baseName;
+    /// For CallQuickened, the specialized form of element.
+    quickenedFunction quickened;
+    /// The number of times this CallBuiltIn
+    /// has run without being specialized.
+    uint_least32_t calls;
+    /// The number of times this call has been specialized.
+    uint_least32_t quickenings;
+    /// The call as written in the function body,
+    /// points into UserSymbol::definition.
+    /// Used when the called symbol delays its arguments,
+    /// and to find the inferred types of the arguments.
+    const ManyType* source;
+    /// The local variable names in source, or nullptr if there are none.
+    /// Points into UserSymbol::slots.
+    const ParameterSlot* parameters;
+};
+
+/// The compiled form of a user-defined function.
+/// Owned by a UserSymbol.
+struct CompiledFunction {
+    /// The instructions, ending with Return.
+    std::vector<Instruction> code;
+    /// Values pushed by PushConstant.
+    mtvec constants;
+    /// Calls made by CallBuiltIn, ResolveSymbol, and CallSymbol.
+    std::vector<CallSite> callSites;
+    /// The first appearance of each common sub-expression,
+    /// points into UserSymbol::definition.
+    /// Its size is the number of locals.
+    std::vector<const ManyType*> localSources;
+    /// The local variable names in each of localSources,
+    /// or nullptr if there are none. Points into UserSymbol::slots.
+    std::vector<const ParameterSlot*> localParameters;
+    /// The largest number of values that
+    /// will be on the stack at once.
+    uint_least32_t maximumStackSize;
+    /// True once specializeCompiledFunction has run,
+    /// when the function was first called.
+    bool specialized;
+};
@@ -0,0 +1,476 @@
+/**
+ * @file CompileUserSymbol.cpp
+ * @author Aaron Stanek
+*/
+#include "CompileUserSymbol.h"
+#include "ParameterSlots.h"
+#include "Memoize.h"
+#include "../Bindings/Bindings.h"
+#include <unordered_map>
+
+/// Marks a CommonExpression that has not been compiled yet.
+#define NO_LOCAL ((uint_least32_t)(-1))
+
+/// A sub-expression that calls only pure built-in functions
+/// on local variables and constants.
+struct CommonExpression {
+    /// The first appearance, in evaluation order.
+    const ManyType* first;
+    /// The number of structurally identical appearances.
+    uint_least32_t count;
+    /// The index of its local, or NO_LOCAL
+    /// if the first appearance has not been compiled.
+    uint_least32_t local;
+};
+
+/// Every sub-expression that could be evaluated once per call.
+struct CommonExpressions {
+    std::vector<CommonExpression> groups;
+    /// Maps each appearance to its index in groups.
+    std::unordered_map<const ManyType*,uint_least32_t> groupOf;
+    /// Maps hashValue of each group to its index in groups.
+    std::unordered_multimap<size_t,uint_least32_t> byHash;
+};
+
+/// The state of a compilation in progress.
+struct Compilation {
+    /// Where the bytecode is written.
+    CompiledFunction& output;
+    /// The definition being compiled, [expression,varnames...].
+    const mtvec& definitionVec;
+    /// The number of values on the stack
+    /// after the instructions written so far.
+    uint_least32_t stackSize;
+    /// Sub-expressions that may be evaluated once.
+    CommonExpressions& common;
+};
+
+/// Records an appearance of a sub-expression.
+/// @param common the sub-expressions found so far
+/// @param x a function body element that depends only on
+/// local variables and pure built-in functions
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void addCommonExpression(CommonExpressions& common, const ManyType& x, long recursionJuice) {
+    const size_t hash = hashValue(x,0,recursionJuice);
+    const auto range = common.byHash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        CommonExpression& group = common.groups[it->second];
+        if (sameValue(*(group.first),x,recursionJuice)) {
+            ++(group.count);
+            common.groupOf[&x] = it->second;
+            return;
+        }
+    }
+    const uint_least32_t index = common.groups.size();
+    common.groups.resize(index + 1);
+    common.groups.back().first = &x;
+    common.groups.back().count = 1;
+    common.groups.back().local = NO_LOCAL;
+    common.groupOf[&x] = index;
+    common.byHash.insert(std::make_pair(hash,index));
+}
+
+/// Finds the sub-expressions of x that call only pure
+/// built-in functions, and records where they appear.
+/// Delayed arguments are passed as written, so they are skipped.
+/// @param common where the sub-expressions are recorded
+/// @param x a function body element
+/// @param definitionVec the definition containing x
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return true if the value of x depends only on local variables,
+/// which means that evaluating it twice gives the same value
+bool findCommonExpressions(CommonExpressions& common, const ManyType& x, const mtvec& definitionVec, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        return false;
+    }
+    else {
+        --recursionJuice;
+    }
+    if ((ManyTypeLabelInt)(x.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+        return true;
+    }
+    if (findParameter(x,definitionVec)) {
+        return true;
+    }
+    const bool isVector = (x.type() == ManyTypeLabel::StructureVector);
+    if (isVector && (x.getStructureVector()[0].type() != ManyTypeLabel::StructureString || x.getStructureVector().size() > MAX_ARGS_DEF)) {
+        // not a call to a built-in function
+        return false;
+    }
+    const mtstring& baseName = isVector ? x.getStructureVector()[0].getStructureString() : x.getStructureString();
+    const uint_least32_t argumentCount = isVector ? x.getStructureVector().size() - 1 : 0;
+    const BuiltInSymbol* builtIn = readBuiltInSymbol(baseName,argumentCount);
+    // calls to user-defined symbols are never common sub-expressions,
+    // because a call in between could redefine them
+    bool pure = builtIn && builtIn->pure;
+    for (uint_least32_t i = 1; i <= argumentCount; ++i) {
+        if (builtIn && i <= 8 && ( (builtIn->element.delayMask >> (i-1)) & 0x01 )) {
+            pure = false;
+            continue;
+        }
+        if (!findCommonExpressions(common,x.getStructureVector()[i],definitionVec,recursionJuice)) {
+            pure = false;
+        }
+    }
+    if (pure) {
+        addCommonExpression(common,x,recursionJuice);
+    }
+    return pure;
+}
+
+/// Appends an instruction to the compiled function.
+/// @param c the compilation in progress
+/// @param opcode the operation
+/// @param operand the index used by the operation
+void emit(Compilation& c, const Opcode opcode, const uint_least32_t operand) {
+    Instruction instruction;
+    instruction.opcode = opcode;
+    instruction.operand = operand;
+    c.output.code.push_back(instruction);
+}
+
+/// Records that an instruction has pushed a value.
+/// @param c the compilation in progress
+void grow(Compilation& c) noexcept {
+    ++c.stackSize;
+    if (c.stackSize > c.output.maximumStackSize) {
+        c.output.maximumStackSize = c.stackSize;
+    }
+}
+
+/// Writes PushConstant for a copy of x.
+/// @param c the compilation in progress
+/// @param x the value to push
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void compileConstant(Compilation& c, const ManyType& x, long recursionJuice) {
+    mtvec& constants = c.output.constants;
+    constants.resize(constants.size() + 1);
+    constants.back().makeCopyFrom(x,recursionJuice);
+    emit(c,Opcode::PushConstant,constants.size() - 1);
+    grow(c);
+}
+
+bool compileExpression(Compilation&, const ManyType&, const ParameterSlot* const, long);
+
+/// Sets the target of a jump to the next instruction written.
+/// @param c the compilation in progress
+/// @param jump the index of the Jump or JumpIfFalse
+void patchJump(Compilation& c, const uint_least32_t jump) noexcept {
+    c.output.code[jump].operand = c.output.code.size();
+}
+
+/// Writes the instructions for a call to if, and, or or,
+/// evaluating the delayed arguments with jumps
+/// rather than passing them as written.
+/// Calls to user-defined functions in the branches then run
+/// like any other call, and a branch in tail position
+/// still makes a tail call.
+/// @param c the compilation in progress
+/// @param vec the call, [function_name,args...]
+/// @param parameters the local variable names in the call, or nullptr if there are none
+/// @param func the built-in function called, one of
+/// if2_implement, if3_implement, and_implement, or_implement
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if the call cannot be compiled
+bool compileBranch(Compilation& c, const mtvec& vec, const ParameterSlot* const parameters, const boundFunction func, long recursionJuice) {
+    const bool isIf = (func == &if2_implement || func == &if3_implement);
+    if (!compileExpression(c,vec[1],elementParameters(parameters,1),recursionJuice)) {
+        return false;
+    }
+    const uint_least32_t jumpIfFalse = c.output.code.size();
+    emit(c,Opcode::JumpIfFalse,0);
+    --c.stackSize;
+    ManyType fixed;
+    if (func == &or_implement) {
+        fixed.putBool(true);
+        compileConstant(c,fixed,recursionJuice);
+    }
+    else {
+        if (!compileExpression(c,vec[2],elementParameters(parameters,2),recursionJuice)) {
+            return false;
+        }
+        if (!isIf) {
+            emit(c,Opcode::ConvertToBool,0);
+        }
+    }
+    const uint_least32_t jump = c.output.code.size();
+    emit(c,Opcode::Jump,0);
+    // the other branch starts with the stack as it was
+    --c.stackSize;
+    patchJump(c,jumpIfFalse);
+    if (func == &if3_implement) {
+        if (!compileExpression(c,vec[3],elementParameters(parameters,3),recursionJuice)) {
+            return false;
+        }
+    }
+    else if (func == &or_implement) {
+        if (!compileExpression(c,vec[2],elementParameters(parameters,2),recursionJuice)) {
+            return false;
+        }
+        emit(c,Opcode::ConvertToBool,0);
+    }
+    else {
+        // if2 gives None, and gives false
+        if (func == &and_implement) {
+            fixed.putBool(false);
+        }
+        compileConstant(c,fixed,recursionJuice);
+    }
+    patchJump(c,jump);
+    return true;
+}
+
+/// Writes the instructions for a function call.
+/// Calls to compile time built-ins are resolved here,
+/// all other calls are resolved when they run.
+/// @param c the compilation in progress
+/// @param x a StructureString or StructureVector
+/// @param parameters the local variable names in x, or nullptr if there are none
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if x cannot be compiled
+bool compileCall(Compilation& c, const ManyType& x, const ParameterSlot* const parameters, long recursionJuice) {
+    const bool isVector = (x.type() == ManyTypeLabel::StructureVector);
+    if (isVector && x.getStructureVector()[0].type() != ManyTypeLabel::StructureString) {
+        // leave this for evaluateExpression to report
+        return false;
+    }
+    const mtstring& baseName = isVector ? x.getStructureVector()[0].getStructureString() : x.getStructureString();
+    const uint_least32_t argumentCount = isVector ? x.getStructureVector().size() - 1 : 0;
+    if (argumentCount >= MAX_ARGS_USED) {
+        // leave this for evaluateExpression to report
+        return false;
+    }
+    if (argumentCount == 2 || argumentCount == 3) {
+        const BuiltInSymbol* branch = readBuiltInSymbol(baseName,argumentCount);
+        const boundFunction func = branch ? branch->element.value.func : nullptr;
+        if (func == &if2_implement || func == &if3_implement || func == &and_implement || func == &or_implement) {
+            return compileBranch(c,x.getStructureVector(),parameters,branch->element.value.func,recursionJuice);
+        }
+    }
+    // the CallSite might move as more are added
+    // so refer to it by index
+    const uint_least32_t siteIndex = c.output.callSites.size();
+    c.output.callSites.resize(siteIndex + 1);
+    {
+        CallSite& site = c.output.callSites[siteIndex];
+        site.element = nullptr;
+        site.generation = 0;
+        site.argumentCount = argumentCount;
+        site.skip = 0;
+        site.argCount = (argumentCount >= MAX_ARGS_DEF) ? (char)(-1) : (char)(argumentCount);
+        site.baseName = baseName;
+        site.source = nullptr;
+        site.parameters = parameters;
+        site.quickened = nullptr;
+        site.calls = 0;
+        site.quickenings = 0;
+    }
+    const char argCount = c.output.callSites[siteIndex].argCount;
+    const BuiltInSymbol* builtIn = (argCount >= 0) ? readBuiltInSymbol(baseName,argCount) : nullptr;
+    if (builtIn) {
+        // users can't overwrite these,
+        // so we know exactly what will be called
+        c.output.callSites[siteIndex].element = &(builtIn->element);
+        c.output.callSites[siteIndex].source = &x;
+        for (uint_least32_t i = 1; i <= argumentCount; ++i) {
+            const ManyType& arg = x.getStructureVector()[i];
+            if (i <= 8 && ( (builtIn->element.delayMask >> (i-1)) & 0x01 )) {
+                // delayed arguments are passed as written
+                if (containsParameter(arg,c.definitionVec,recursionJuice)) {
+                    return false;
+                }
+                compileConstant(c,arg,recursionJuice);
+            }
+            else if (!compileExpression(c,arg,elementParameters(parameters,i),recursionJuice)) {
+                return false;
+            }
+        }
+        emit(c,Opcode::CallBuiltIn,siteIndex);
+    }
+    else {
+        // we don't know what will be called
+        // keep the source in case it delays its arguments
+        c.output.callSites[siteIndex].source = &x;
+        emit(c,Opcode::ResolveSymbol,siteIndex);
+        for (uint_least32_t i = 1; i <= argumentCount; ++i) {
+            if (!compileExpression(c,x.getStructureVector()[i],elementParameters(parameters,i),recursionJuice)) {
+                return false;
+            }
+        }
+        emit(c,Opcode::CallSymbol,siteIndex);
+        c.output.callSites[siteIndex].skip = c.output.code.size();
+    }
+    // the arguments are replaced by the result
+    c.stackSize -= argumentCount;
+    grow(c);
+    return true;
+}
+
+/// Writes instructions that leave the value of x on the stack.
+/// @param c the compilation in progress
+/// @param x a function body element
+/// @param parameters the local variable names in x, or nullptr if there are none
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if x cannot be compiled
+bool compileExpression(Compilation& c, const ManyType& x, const ParameterSlot* const parameters, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        return false;
+    }
+    else {
+        --recursionJuice;
+    }
+    if ((ManyTypeLabelInt)(x.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+        if (containsParameter(x,c.definitionVec,recursionJuice)) {
+            // loadUserSymbol would replace part of it
+            return false;
+        }
+        compileConstant(c,x,recursionJuice);
+        return true;
+    }
+    if (parameters && parameters->slot) {
+        emit(c,Opcode::PushArgument,parameters->slot);
+        grow(c);
+        return true;
+    }
+    const auto common = c.common.groupOf.find(&x);
+    if (common != c.common.groupOf.end() && c.common.groups[common->second].count >= 2) {
+        // it appears more than once
+        CommonExpression& group = c.common.groups[common->second];
+        if (group.local != NO_LOCAL) {
+            // reuse the value of the first appearance
+            emit(c,Opcode::PushLocal,group.local);
+            grow(c);
+            return true;
+        }
+        if (!compileCall(c,x,parameters,recursionJuice)) {
+            return false;
+        }
+        group.local = c.output.localSources.size();
+        c.output.localSources.push_back(&x);
+        c.output.localParameters.push_back(parameters);
+        emit(c,Opcode::StoreLocal,group.local);
+        return true;
+    }
+    // it's a function call, or a symbol name
+    // that will be treated as one
+    return compileCall(c,x,parameters,recursionJuice);
+}
+
+/// Records every local variable that appears in a function body element.
+/// @param seen indexed by local variable, set to true for those found
+/// @param parameters the local variable names in the element, or nullptr if there are none
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if recursionJuice ran out
+bool markParameters(std::vector<bool>& seen, const ParameterSlot* const parameters, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        return false;
+    }
+    else {
+        --recursionJuice;
+    }
+    if (parameters == nullptr) {
+        return true;
+    }
+    if (parameters->slot) {
+        seen[parameters->slot] = true;
+    }
+    for (uint_least32_t i = 1; i < parameters->elements.size(); ++i) {
+        if (!markParameters(seen,elementParameters(parameters,i),recursionJuice)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Replaces the last PushArgument of each argument with MoveArgument,
+/// unless a later instruction may read the argument.
+/// Instructions only ever jump forward. Besides PushArgument,
+/// ResolveSymbol may read every argument in its call,
+/// and PushLocal every argument in its sub-expression.
+/// @param compiled the finished function
+/// @param definitionVec the definition that was compiled
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void moveLastArguments(CompiledFunction& compiled, const mtvec& definitionVec, long recursionJuice) {
+    std::vector<bool> seen(definitionVec.size(),false);
+    for (auto it = compiled.code.rbegin(); it != compiled.code.rend(); ++it) {
+        bool marked = true;
+        if (it->opcode == Opcode::PushArgument && !seen[it->operand]) {
+            seen[it->operand] = true;
+            it->opcode = Opcode::MoveArgument;
+        }
+        else if (it->opcode == Opcode::ResolveSymbol) {
+            marked = markParameters(seen,compiled.callSites[it->operand].parameters,recursionJuice);
+        }
+        else if (it->opcode == Opcode::PushLocal) {
+            marked = markParameters(seen,compiled.localParameters[it->operand],recursionJuice);
+        }
+        if (!marked) {
+            // it could not be determined, so don't move anything else
+            seen.assign(seen.size(),true);
+        }
+    }
+}
+
+/// Replaces each Jump to a Return with a Return,
+/// so that a call at the end of a branch is a tail call,
+/// and shortens chains of jumps.
+/// @param compiled the finished function
+void shortenJumps(CompiledFunction& compiled) noexcept {
+    // the targets are later, so they are done first
+    for (auto it = compiled.code.rbegin(); it != compiled.code.rend(); ++it) {
+        if (it->opcode != Opcode::Jump) {
+            continue;
+        }
+        const Instruction& target = compiled.code[it->operand];
+        if (target.opcode == Opcode::Return) {
+            it->opcode = Opcode::Return;
+        }
+        else if (target.opcode == Opcode::Jump) {
+            it->operand = target.operand;
+        }
+    }
+}
+
+/// Compiles the definition of a user-defined function.
+/// Functions with delayed arguments, and functions that
+/// place local variables inside delayed arguments
+/// other than the branches of if, and, and or,
+/// are not compiled. loadUserSymbol handles those.
+/// @param definition a value of UserSymbol::definition
+/// @param slots the local variable names of definition,
+/// the compiled function points into them
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return a new CompiledFunction, or nullptr
+/// if definition could not be compiled
+CompiledFunction* compileUserSymbol(const ManyType& definition, const ParameterSlots& slots, long recursionJuice) {
+    if (definition.type() != ManyTypeLabel::StructureVector) {
+        // it's not function-like
+        return nullptr;
+    }
+    const mtvec& definitionVec = definition.getStructureVector();
+    for (int_fast32_t i = 1; i < definitionVec.size(); ++i) {
+        if (definitionVec[i].getStructureString()[0] == '%') {
+            return nullptr;
+        }
+    }
+    CompiledFunction* output = new CompiledFunction;
+    output->maximumStackSize = 0;
+    output->specialized = false;
+    CommonExpressions common;
+    Compilation c = { *output, definitionVec, 0, common };
+    try {
+        findCommonExpressions(common,definitionVec[0],definitionVec,recursionJuice);
+        if (compileExpression(c,definitionVec[0],&(slots.body),recursionJuice)) {
+            emit(c,Opcode::Return,0);
+            shortenJumps(*output);
+            moveLastArguments(*output,definitionVec,recursionJuice);
+            return output;
+        }
+    }
+    catch (...) {
+        delete output;
+        throw;
+    }
+    delete output;
+    return nullptr;
+}
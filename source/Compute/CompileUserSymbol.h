@@ -0,0 +1,13 @@
+/**
+ * @file CompileUserSymbol.h
+ * @author Aaron Stanek
+ * @brief Function for compiling
+ * a user-defined function to bytecode
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "Bytecode.h"
+#include "ParameterSlots.h"
+
+CompiledFunction* compileUserSymbol(const ManyType&, const ParameterSlots&, long);
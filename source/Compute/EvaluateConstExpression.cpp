@@ -0,0 +1,420 @@
+/**
+ * @file EvaluateConstExpression.cpp
+ * @author Aaron Stanek
+*/
+#include "EvaluateConstExpression.h"
+#include "EvaluateExpression.h"
+#include "LoadUserSymbol.h"
+#include "RunBytecode.h"
+#include "Memoize.h"
+#include "Profiler.h"
+#include "Reactive.h"
+#include "../Globals/Trace.h"
+#include <algorithm>
+#include <atomic>
+
+/// @param x a StructureString or StructureVector
+/// @return the basename of the symbol that x calls
+inline const mtstring& calledBaseName(const ManyType& x) {
+    return (x.type() == ManyTypeLabel::StructureVector) ? x.getStructureVector()[0].getStructureString() : x.getStructureString();
+}
+
+/// The frames on this thread that have lent lazy arguments,
+/// innermost last.
+thread_local std::vector<Frame*> lendingFrames;
+
+/// The last Frame::lendingId given out, on any thread,
+/// so that a copy evaluated on another thread
+/// never finds the wrong frame.
+std::atomic<long> lastLendingId(0);
+
+Frame::~Frame() {
+    if (lendingId) {
+        // frames end in the order opposite to how they began,
+        // so this is normally the last one
+        const auto it = std::find(lendingFrames.rbegin(),lendingFrames.rend(),this);
+        lendingFrames.erase(std::next(it).base());
+    }
+}
+
+/// @param x a value
+/// @return true if x is a lent argument whose frame
+/// has returned, or is on another thread
+bool isOrphanedLentArgument(const ManyType& x) {
+    if (x.type() != ManyTypeLabel::StructureVector) {
+        return false;
+    }
+    const mtvec& vec = x.getStructureVector();
+    if (vec.size() != 4 || vec[0].getStructureString() != LENT_ARGUMENT_NAME || vec[1].type() != ManyTypeLabel::Int) {
+        return false;
+    }
+    const long id = vec[1].getInt();
+    return std::none_of(lendingFrames.begin(),lendingFrames.end(),[id](const Frame* const frame) {
+        return frame->lendingId == id;
+    });
+}
+
+/// Places a stand-in for a lazy argument that has not been evaluated in ret.
+/// If the stand-in is evaluated while frame is running,
+/// the argument is evaluated in frame and shared with its other uses.
+/// Otherwise the argument is evaluated as written.
+/// Either way, it is only evaluated if the stand-in is.
+/// @param ret where the stand-in will be placed,
+/// LENT_ARGUMENT_NAME(lendingId,slot,argument)
+/// @param slot the index of the argument
+/// @param frame the running function
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void lendArgument(ManyType& ret, const uint_least32_t slot, Frame& frame, long recursionJuice) {
+    if (frame.lendingId == 0) {
+        lendingFrames.push_back(&frame);
+        frame.lendingId = ++lastLendingId;
+    }
+    if (frame.lent.empty()) {
+        frame.lent.resize(frame.arguments.size(),false);
+    }
+    // the argument can no longer be taken by its last use
+    frame.lent[slot] = true;
+    const ManyType* argument = &(frame.arguments[slot]);
+    while (isOrphanedLentArgument(*argument)) {
+        // passed along from a function that has returned,
+        // so that a chain of tail calls doesn't nest stand-ins
+        argument = &(argument->getStructureVector()[3]);
+    }
+    ManyType standIn;
+    mtvec& vec = standIn.putStructureVector();
+    vec.resize(4);
+    vec[0].putStructureString() = LENT_ARGUMENT_NAME;
+    vec[1].putInt(frame.lendingId);
+    vec[2].putInt((long)(slot));
+    vec[3].makeCopyFrom(*argument,recursionJuice);
+    ret = standIn;
+}
+
+/// Evaluates a lazy argument lent by a running function,
+/// where it is, so that its other uses share it.
+/// @param ret where the value will be placed
+/// @param lendingId the Frame::lendingId of the function
+/// @param slot the index of the argument
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if the function has returned, or is on another thread
+bool readLentArgument(ManyType& ret, const long lendingId, const long slot, long recursionJuice) {
+    for (auto it = lendingFrames.rbegin(); it != lendingFrames.rend(); ++it) {
+        Frame& frame = **it;
+        if (frame.lendingId == lendingId) {
+            if (slot < 1 || slot >= (long)(frame.arguments.size())) {
+                return false;
+            }
+            forceArgument(frame.arguments[slot],recursionJuice);
+            ret.makeCopyFrom(frame.arguments[slot],recursionJuice);
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Places the value of a local variable in ret.
+/// A lazy argument is evaluated where it is
+/// by the first use, and shared by the others.
+/// @param ret where the value will be placed
+/// @param parameter the local variable to read
+/// @param frame the running function
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void readArgument(ManyType& ret, const ParameterSlot& parameter, Frame& frame, long recursionJuice) {
+    forceArgument(frame.arguments[parameter.slot],recursionJuice);
+    if (parameter.lastUse && (frame.lent.empty() || !frame.lent[parameter.slot])) {
+        // nothing else needs this argument
+        ret = frame.arguments[parameter.slot];
+    }
+    else {
+        ret.makeCopyFrom(frame.arguments[parameter.slot],recursionJuice);
+    }
+}
+
+/// Copies x to ret, replacing local variable names
+/// with the values passed to the running function.
+/// This is what loadUserSymbol would have left in
+/// place of x, before x was evaluated, except that
+/// lazy arguments are not evaluated, since the copy may never be.
+/// @param ret where the copy will be placed
+/// @param x the value to copy
+/// @param parameters the local variable names in x, or nullptr if there are none
+/// @param frame the running function, it may be nullptr if parameters is
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void copyInFrame(ManyType& ret, const ManyType& x, const ParameterSlot* const parameters, Frame* const frame, long recursionJuice) {
+    if (parameters == nullptr) {
+        ret.makeCopyFrom(x,recursionJuice);
+        return;
+    }
+    if (parameters->slot) {
+        if (!( (ManyTypeLabelInt)(frame->arguments[parameters->slot].type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression) )) {
+            // a lazy argument that nothing has evaluated yet
+            lendArgument(ret,parameters->slot,*frame,recursionJuice);
+        }
+        else {
+            readArgument(ret,*parameters,*frame,recursionJuice);
+        }
+        return;
+    }
+    if ((ManyTypeLabelInt)(x.type()) & (ManyTypeLabelInt)(ManyTypeLabel::Vector)) {
+        if (recursionJuice <= 0) {
+            throw UserAlert(UserMessage::MaximumRecursionDepthReached,nullptr);
+        }
+        else {
+            --recursionJuice;
+        }
+        checkNativeStack();
+        const mtvec& source = (x.type() == ManyTypeLabel::StructureVector) ? x.getStructureVector() : x.getDataVector();
+        ret.putNone();
+        mtvec& destination = (x.type() == ManyTypeLabel::StructureVector) ? ret.putStructureVector() : ret.putDataVector();
+        destination.resize(source.size());
+        // the first element is the function name or data type
+        // it is never a local variable name
+        destination[0].makeCopyFrom(source[0],recursionJuice);
+        for (int_fast32_t i = 1; i < source.size(); ++i) {
+            copyInFrame(destination[i],source[i],elementParameters(parameters,i),frame,recursionJuice);
+        }
+        return;
+    }
+    ret.makeCopyFrom(x,recursionJuice);
+}
+
+/// Looks up the symbol called by x and evaluates its arguments,
+/// except for those that the symbol delays.
+/// @param callVec will be set to [None,args...]
+/// @param x a StructureString or StructureVector
+/// @param parameters the local variable names in x, or nullptr if there are none
+/// @param frame the running function, it may be nullptr if parameters is
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return the symbol to call
+/// @throw UserAlert if there is no such symbol
+const SymbolTableElement& prepareCall(mtvec& callVec, const ManyType& x, const ParameterSlot* const parameters, Frame* const frame, long recursionJuice) {
+    // a symbol name is treated as a function call
+    // with no arguments, as in evaluateExpression
+    const mtvec* const sourceVec = (x.type() == ManyTypeLabel::StructureVector) ? &(x.getStructureVector()) : nullptr;
+    const uint_least32_t argumentCount = sourceVec ? sourceVec->size() - 1 : 0;
+    if (argumentCount >= MAX_ARGS_USED) {
+        // we need to be able to fit the
+        // number of arguments in a 32 bit integer
+        throw UserAlert(UserMessage::TooManyArguments,"In Call");
+    }
+    const SymbolTableElement& symbol = readSymbol(
+        sourceVec ? (*sourceVec)[0].getStructureString() : x.getStructureString(),
+        (argumentCount >= MAX_ARGS_DEF) ? (char)(-1) : (char)(argumentCount)
+        );
+    // the arguments are evaluated into separate storage
+    // callVec[0] is never set
+    callVec.resize(argumentCount + 1);
+    for (uint_least32_t i = 1; i <= argumentCount; ++i) {
+        if (passesAsWritten(symbol,i)) {
+            // delayed and lazy arguments are passed as written
+            copyInFrame(callVec[i],(*sourceVec)[i],elementParameters(parameters,i),frame,recursionJuice);
+        }
+        else {
+            evaluateInFrame(callVec[i],(*sourceVec)[i],elementParameters(parameters,i),frame,recursionJuice);
+        }
+    }
+    return symbol;
+}
+
+/// Evaluates the body of a user-defined function where it is.
+/// If the body ends by calling another user-defined symbol,
+/// that call is left for the caller to make, so that
+/// chains of tail calls don't nest. This includes a call
+/// returned by a built-in, such as a branch of if.
+/// @param ret where the result will be placed, it will be a DataExpression,
+/// unless a tail call is returned
+/// @param user the function to run, user.slots must not be nullptr
+/// @param arguments the function call, [function_name,args...],
+/// all arguments must already be evaluated. They may be taken from it.
+/// If a tail call is returned, it holds the arguments of that call
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return the symbol of the tail call, or nullptr if ret was set
+const SymbolTableElement* runInFrame(ManyType& ret, UserSymbol& user, mtvec& arguments, long recursionJuice) {
+    // user may be redefined while it runs
+    const UserSymbolHold hold(&user);
+    Frame frame(arguments);
+    const ManyType& body = user.definition.getStructureVector()[0];
+    const ParameterSlot* const parameters = &(user.slots->body);
+    if (((ManyTypeLabelInt)(body.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) || parameters->slot) {
+        // nothing is called
+        evaluateInFrame(ret,body,parameters,&frame,recursionJuice);
+        return nullptr;
+    }
+    // make sure that we are not running overtime
+    checkProcessingTime();
+    mtvec callVec;
+    const SymbolTableElement* symbol = &prepareCall(callVec,body,parameters,&frame,recursionJuice);
+    // the expression returned by the last built-in called
+    ManyType pending;
+    const ManyType* called = &body;
+    while (symbol->builtIn) {
+        ManyType result;
+        {
+            const mtstring& baseName = calledBaseName(*called);
+            const ProfileScope scope(baseName,callVec.size()-1);
+            const TraceScope traceScope(TraceEventKind::Call,baseName.data(),baseName.size(),callVec.size()-1);
+            callSymbol(result,*symbol,callVec,recursionJuice);
+        }
+        if ((ManyTypeLabelInt)(result.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+            ret = result;
+            return nullptr;
+        }
+        // the built-in gave back an expression to evaluate in its place,
+        // its local variable names were already replaced
+        checkProcessingTime();
+        pending = result;
+        called = &pending;
+        symbol = &prepareCall(callVec,pending,nullptr,nullptr,recursionJuice);
+    }
+    // a tail call
+    arguments.swap(callVec);
+    return symbol;
+}
+
+/// Calls a user-defined symbol without
+/// looking for a remembered result.
+/// Tail calls are made here, one after another,
+/// instead of inside of each other. Like the iterations
+/// of while, they are only limited by maximumProcessingTime.
+/// @param ret where the result will be placed, it may not be a DataExpression
+/// @param symbol the symbol to call, it must not be built-in
+/// @param callVec the function call, [function_name,args...],
+/// the arguments may be modified or taken from it
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void callUserSymbol(ManyType& ret, const SymbolTableElement& symbol, mtvec& callVec, long recursionJuice) {
+    const SymbolTableElement* next = &symbol;
+    while (true) {
+        // a tail call doesn't check for remembered results,
+        // the call that started the chain remembers the final result
+        UserSymbol& user = *(next->value.user);
+        const boundFunction native = user.native.load(std::memory_order_acquire);
+        if (native) {
+            // compiled to machine code by native()
+            // it makes its own tail calls
+            native(ret,callVec,recursionJuice);
+            return;
+        }
+        if (user.compiled) {
+            // compiled user-defined symbol
+            next = runBytecode(ret,user,callVec,recursionJuice);
+        }
+        else if (user.slots) {
+            // user-defined symbol whose local variables
+            // were found when it was defined
+            next = runInFrame(ret,user,callVec,recursionJuice);
+        }
+        else {
+            // user-defined symbol
+            // evaluateExpression will evaluate what it returns
+            loadUserSymbol(ret,*next,callVec,recursionJuice);
+            return;
+        }
+        if (next == nullptr) {
+            return;
+        }
+        // callVec holds the arguments of the tail call
+        // make sure that we are not running overtime
+        checkProcessingTime();
+    }
+}
+
+/// Calls a symbol with arguments that have already been evaluated,
+/// except for those that the symbol delays.
+/// Pure user-defined functions return a remembered
+/// result if they have been called with the same arguments before.
+/// In reactive mode, derived variables return their cached value.
+/// @param ret where the result will be placed, it may not be a DataExpression
+/// @param symbol the symbol to call
+/// @param callVec the function call, [function_name,args...],
+/// the arguments may be modified or taken from it
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void callSymbol(ManyType& ret, const SymbolTableElement& symbol, mtvec& callVec, long recursionJuice) {
+    if (symbol.builtIn) {
+        // built-in symbol
+        symbol.value.func(ret,callVec,recursionJuice);
+        return;
+    }
+    UserSymbol& user = *(symbol.value.user);
+    if (hasReactiveValue(user)) {
+        // a derived variable, computed only when
+        // something it depends on has changed
+        const UserSymbolHold hold(&user);
+        if (readReactiveValue(ret,user,recursionJuice)) {
+            return;
+        }
+        callUserSymbol(ret,symbol,callVec,recursionJuice);
+        // the value is kept evaluated
+        evaluateExpression(ret,recursionJuice);
+        storeReactiveValue(user,ret,recursionJuice);
+        return;
+    }
+    if (user.memo == nullptr || maximumMemoizedResults <= 0) {
+        callUserSymbol(ret,symbol,callVec,recursionJuice);
+        return;
+    }
+    // user may be redefined while it runs
+    const UserSymbolHold hold(&user);
+    MemoTable& memo = *(user.memo);
+    MemoKey key;
+    const MemoLookup found = lookUpMemoizedResult(ret,memo,key,callVec,recursionJuice);
+    if (found == MemoLookup::Found) {
+        return;
+    }
+    callUserSymbol(ret,symbol,callVec,recursionJuice);
+    if (found == MemoLookup::Missing) {
+        rememberResult(memo,key,ret,recursionJuice);
+    }
+}
+
+/// Evaluates x without modifying it.
+/// Local variable names are read from frame.
+/// @param ret where the result will be placed, it will be a DataExpression
+/// @param x the expression to evaluate
+/// @param parameters the local variable names in x, or nullptr
+/// if there are none or x is not part of a function body
+/// @param frame the running function, it may be nullptr if parameters is
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void evaluateInFrame(ManyType& ret, const ManyType& x, const ParameterSlot* const parameters, Frame* const frame, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        throw UserAlert(UserMessage::MaximumRecursionDepthReached,nullptr);
+    }
+    else {
+        --recursionJuice;
+    }
+    checkNativeStack();
+    if ((ManyTypeLabelInt)(x.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+        // it may still contain local variable names
+        // if it is a DataVector
+        copyInFrame(ret,x,parameters,frame,recursionJuice);
+        return;
+    }
+    if (parameters && parameters->slot) {
+        // the arguments have already been evaluated
+        readArgument(ret,*parameters,*frame,recursionJuice);
+        return;
+    }
+    // make sure that we are not running overtime
+    checkProcessingTime();
+    mtvec callVec;
+    const SymbolTableElement& symbol = prepareCall(callVec,x,parameters,frame,recursionJuice);
+    ManyType result;
+    {
+        const mtstring& baseName = calledBaseName(x);
+        const ProfileScope scope(baseName,callVec.size()-1);
+        const TraceScope traceScope(TraceEventKind::Call,baseName.data(),baseName.size(),callVec.size()-1);
+        callSymbol(result,symbol,callVec,recursionJuice);
+        // the result is ours, so it can be evaluated in place
+        evaluateExpression(result,recursionJuice);
+    }
+    ret = result;
+}
+
+/// Evaluates x without modifying it, so that
+/// the same expression can be evaluated again
+/// without being copied first.
+/// @param ret where the result will be placed, it will be a DataExpression
+/// @param x the expression to evaluate
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void evaluateConstExpression(ManyType& ret, const ManyType& x, long recursionJuice) {
+    evaluateInFrame(ret,x,nullptr,nullptr,recursionJuice);
+}
@@ -0,0 +1,58 @@
+/**
+ * @file EvaluateConstExpression.h
+ * @author Aaron Stanek
+ * @brief Functions for evaluating
+ * a language expression without
+ * modifying it
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "../Symbols/Symbols.h"
+#include "ParameterSlots.h"
+#include <vector>
+
+/// The name of the built-in that stands in for a lazy argument
+/// copied into a delayed argument before anything evaluated it.
+/// It can't be typed, so it never collides with a user symbol.
+#define LENT_ARGUMENT_NAME "lazy#"
+
+/// The local variables of a running user-defined function.
+/// It lives on the native stack for as long as the function runs.
+///
+/// A lazy argument that nothing has evaluated yet is not copied
+/// into a delayed argument. Instead the frame lends it: the copy
+/// holds LENT_ARGUMENT_NAME(lendingId,slot,argument), and the frame
+/// is pushed onto lendingFrames, a list kept per thread.
+/// The frame keeps ownership of the argument. If the stand-in is
+/// evaluated while the frame is in lendingFrames, readLentArgument
+/// evaluates the argument where it is, so every use shares it.
+/// The destructor takes the frame out of lendingFrames. A stand-in
+/// evaluated after that, or on another thread, finds no frame with
+/// its lendingId and evaluates its own copy of the argument.
+struct Frame {
+    /// The function call, [function_name,args...].
+    /// Not owned, it must outlive the frame.
+    /// Each argument is taken by its last use,
+    /// unless it has been lent.
+    mtvec& arguments;
+    /// Identifies the frame to the copies it has lent
+    /// lazy arguments to, 0 until it lends one.
+    long lendingId;
+    /// True for each argument that has been lent,
+    /// empty until one is.
+    std::vector<bool> lent;
+    /// @param a the function call, as in arguments
+    inline explicit Frame(mtvec& a) : arguments(a), lendingId(0) {};
+    ~Frame();
+};
+
+void callSymbol(ManyType&, const SymbolTableElement&, mtvec&, long);
+
+const SymbolTableElement& prepareCall(mtvec&, const ManyType&, const ParameterSlot* const, Frame* const, long);
+
+void evaluateInFrame(ManyType&, const ManyType&, const ParameterSlot* const, Frame* const, long);
+
+bool readLentArgument(ManyType&, const long, const long, long);
+
+void evaluateConstExpression(ManyType&, const ManyType&, long);
@@ -3,9 +3,12 @@
  * @author Aaron Stanek
 */
 #include "EvaluateExpression.h"
-#include "LoadUserSymbol.h"
+#include "EvaluateConstExpression.h"
+#include "ParallelArguments.h"
+#include "Profiler.h"
 #include "../Symbols/Symbols.h"
 #include "../Bindings/Bindings.h"
+#include "../Globals/Trace.h"
 
 void evaluateExpression(ManyType& x, long recursionJuice) {
     if (recursionJuice <= 0) {
@@ -14,7 +17,12 @@ void evaluateExpression(ManyType& x, long recursionJuice) {
     else {
         --recursionJuice;
     }
+    checkNativeStack();
     long logicalRecursionJuice = maximumLogicalRecursionDepth;
+    // each call below evaluates what the one before it returned,
+    // so they are measured as if each were inside the one before
+    ProfileScopes profileScopes;
+    TraceScopes traceScopes;
     // we will do everything we can
     // to convert x to a DataExpression
     while (true) {
@@ -51,28 +59,31 @@ void evaluateExpression(ManyType& x, long recursionJuice) {
             (callVec.size() > MAX_ARGS_DEF) ? (char)(-1) : (char)(callVec.size()-1)
             );
         // we need to look at the delayMask before evaluating its arguments
-        for (int_fast32_t i = 1; i < callVec.size(); ++i) {
-            if (i <= 8) {
-                if ( (symbol.delayMask >> (i-1) ) & 0x01 ) {
-                    // take the i-1 th bit of symbol.delayMask (from LSB)
-                    // if it is 1, then that means that we should delay
-                    // evaluation of this argument
-                    continue;
-                }
+        // independent arguments that are worth it are shared between threads
+        const bool evaluated = evaluateArgumentsInParallel(callVec,symbol,recursionJuice);
+        for (int_fast32_t i = 1; !evaluated && i < callVec.size(); ++i) {
+            if (passesAsWritten(symbol,i)) {
+                // the i-1 th bit of symbol.delayMask (from LSB) is 1,
+                // or the argument is a lazy parameter,
+                // either way we should delay evaluation of this argument
+                continue;
             }
             // don't delay evaluation of this argument
             evaluateExpression(callVec[i],recursionJuice);
         }
         // now we can call the function
-        ManyType ret;
-        if (symbol.builtIn) {
-            // built-in symbol
-            symbol.value.func(ret,callVec,recursionJuice);
+        if (profilingEnabled) {
+            profileEnter(callVec[0].getStructureString(),callVec.size()-1);
+            ++(profileScopes.count);
         }
-        else {
-            // user-defined symbol
-            loadUserSymbol(ret,symbol,callVec,recursionJuice);
+        if (tracingEnabled) {
+            const mtstring& baseName = callVec[0].getStructureString();
+            if (traceSymbol(TraceEventKind::Call,baseName.data(),baseName.size(),callVec.size()-1)) {
+                ++(traceScopes.count);
+            }
         }
+        ManyType ret;
+        callSymbol(ret,symbol,callVec,recursionJuice);
         x = ret;
         // after this, we go back to the top of the loop
     }
@@ -8,4 +8,17 @@
 #include "../Globals/Globals.h"
 #include "../ManyType/ManyType.h"
 
-void evaluateExpression(ManyType&,long);
\ No newline at end of file
+void evaluateExpression(ManyType&,long);
+
+/// Evaluates an argument of the running function where it is,
+/// if it was passed as written to a lazy parameter.
+/// Arguments that are already evaluated are left alone,
+/// so a lazy argument is evaluated at most once,
+/// by the first use that reads it.
+/// @param argument the argument to read
+/// @param recursionJuice how many layers of recursion may be used by this operation
+inline void forceArgument(ManyType& argument, long recursionJuice) {
+    if (!( (ManyTypeLabelInt)(argument.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression) )) {
+        evaluateExpression(argument,recursionJuice);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,207 @@
+/**
+ * @file FoldConstants.cpp
+ * @author Aaron Stanek
+*/
+#include "FoldConstants.h"
+#include "ParameterSlots.h"
+#include "../Symbols/Symbols.h"
+#include "../Bindings/Bindings.h"
+
+/// @param x a function body element
+/// @param definitionVec the definition containing x
+/// @return the entry of the built-in table that x calls,
+/// or nullptr if x does not call one.
+/// Users can't overwrite these, so the result never changes.
+const BuiltInSymbol* findBuiltInCall(const ManyType& x, const mtvec& definitionVec) {
+    if (x.type() == ManyTypeLabel::StructureString) {
+        if (findParameter(x,definitionVec)) {
+            return nullptr;
+        }
+        // a symbol name is called with no arguments
+        return readBuiltInSymbol(x.getStructureString(),0);
+    }
+    if (x.type() != ManyTypeLabel::StructureVector) {
+        return nullptr;
+    }
+    const mtvec& vec = x.getStructureVector();
+    if (vec[0].type() != ManyTypeLabel::StructureString || vec.size() > MAX_ARGS_DEF) {
+        return nullptr;
+    }
+    return readBuiltInSymbol(vec[0].getStructureString(),(char)(vec.size()-1));
+}
+
+/// @param x a function body element
+/// @param definitionVec the definition containing x
+/// @return true if x calls add or sub, whose results
+/// are always finite floats
+bool isFiniteFloatCall(const ManyType& x, const mtvec& definitionVec) {
+    const BuiltInSymbol* builtIn = findBuiltInCall(x,definitionVec);
+    return builtIn && (builtIn->element.value.func == &add_implement || builtIn->element.value.func == &sub_implement);
+}
+
+/// @param x a value
+/// @return true if x converts to a float 0 with no sign bit
+bool isPositiveZero(const ManyType& x) {
+    if (x.type() == ManyTypeLabel::Int) {
+        return x.getInt() == 0;
+    }
+    if (x.type() == ManyTypeLabel::Ftype) {
+        return x.getFtype() == 0 && !signbit(x.getFtype());
+    }
+    return false;
+}
+
+/// Replaces x with one of its arguments.
+/// @param x a function call
+/// @param index the index of the argument to keep
+void replaceWithArgument(ManyType& x, const uint_least32_t index) {
+    // the copy constructor takes the value
+    ManyType kept(x.getStructureVector()[index]);
+    x = kept;
+}
+
+/// Calls a built-in function on constant arguments, now.
+/// @param x a call to builtIn whose arguments are all constants,
+/// it will be replaced by the result
+/// @param builtIn the built-in function to call, it must be pure
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if the call fails, in which case x is unchanged
+/// and the failure will be reported when the function runs
+bool evaluateBuiltInCall(ManyType& x, const BuiltInSymbol& builtIn, long recursionJuice) {
+    ManyType result;
+    try {
+        // built-in functions may modify their arguments
+        mtvec callVec(1);
+        if (x.type() == ManyTypeLabel::StructureVector) {
+            const mtvec& vec = x.getStructureVector();
+            callVec.resize(vec.size());
+            for (int_fast32_t i = 1; i < vec.size(); ++i) {
+                callVec[i].makeCopyFrom(vec[i],recursionJuice);
+            }
+        }
+        builtIn.element.value.func(result,callVec,recursionJuice);
+    }
+    catch (UserAlert&) {
+        // this includes NaN and infinity errors
+        return false;
+    }
+    if (!( (ManyTypeLabelInt)(result.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression) )) {
+        return false;
+    }
+    x = result;
+    return true;
+}
+
+/// Applies identities that give exactly the same
+/// result and the same errors for every argument.
+/// @param x a call to builtIn, whose arguments have been folded
+/// @param builtIn the built-in function that x calls
+/// @param definitionVec the definition containing x
+void simplifyBuiltInCall(ManyType& x, const BuiltInSymbol& builtIn, const mtvec& definitionVec) {
+    if (x.type() != ManyTypeLabel::StructureVector) {
+        return;
+    }
+    const boundFunction func = builtIn.element.value.func;
+    const mtvec& vec = x.getStructureVector();
+    if (vec.size() == 2) {
+        const BuiltInSymbol* inner = findBuiltInCall(vec[1],definitionVec);
+        if (inner == nullptr) {
+            return;
+        }
+        if (inner->element.value.func == func && (func == &bool_implement || func == &int_implement || func == &float_implement)) {
+            // converting twice is the same as converting once
+            replaceWithArgument(x,1);
+        }
+        else if (func == &float_implement && isFiniteFloatCall(vec[1],definitionVec)) {
+            // already a float
+            replaceWithArgument(x,1);
+        }
+    }
+    else if (vec.size() == 3 && func == &sub_implement) {
+        if (isPositiveZero(vec[2]) && isFiniteFloatCall(vec[1],definitionVec)) {
+            // y-0 is y for every finite float y, including -0
+            // y+0 is not, because -0+0 is 0
+            replaceWithArgument(x,1);
+        }
+    }
+}
+
+/// Folds x, and elements pointed to by x.
+/// @param x a function body element
+/// @param definitionVec the definition containing x
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void foldExpression(ManyType& x, const mtvec& definitionVec, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        return;
+    }
+    else {
+        --recursionJuice;
+    }
+    if ((ManyTypeLabelInt)(x.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+        return;
+    }
+    if (findParameter(x,definitionVec)) {
+        return;
+    }
+    const bool isVector = (x.type() == ManyTypeLabel::StructureVector);
+    if (isVector && (x.getStructureVector()[0].type() != ManyTypeLabel::StructureString || x.getStructureVector().size() > MAX_ARGS_USED)) {
+        // leave this for evaluateExpression to report
+        return;
+    }
+    const BuiltInSymbol* builtIn = findBuiltInCall(x,definitionVec);
+    const SymbolTableElement* symbol;
+    if (builtIn) {
+        symbol = &(builtIn->element);
+    }
+    else {
+        // arguments that a user-defined symbol delays,
+        // or takes lazily, are passed as written,
+        // so they are left as written
+        // if the symbol is not defined yet, nothing is known
+        const mtstring& baseName = isVector ? x.getStructureVector()[0].getStructureString() : x.getStructureString();
+        const uint_least32_t argumentCount = isVector ? x.getStructureVector().size() - 1 : 0;
+        symbol = findSymbol(baseName,(argumentCount >= MAX_ARGS_DEF) ? (char)(-1) : (char)(argumentCount));
+        if (symbol == nullptr) {
+            return;
+        }
+    }
+    bool constantArguments = true;
+    if (isVector) {
+        mtvec& vec = x.getStructureVector();
+        for (int_fast32_t i = 1; i < vec.size(); ++i) {
+            if (passesAsWritten(*symbol,i)) {
+                constantArguments = false;
+                continue;
+            }
+            foldExpression(vec[i],definitionVec,recursionJuice);
+            if (!( (ManyTypeLabelInt)(vec[i].type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression) ) || containsParameter(vec[i],definitionVec,recursionJuice)) {
+                constantArguments = false;
+            }
+        }
+    }
+    if (builtIn == nullptr) {
+        return;
+    }
+    if (builtIn->pure && constantArguments && evaluateBuiltInCall(x,*builtIn,recursionJuice)) {
+        return;
+    }
+    simplifyBuiltInCall(x,*builtIn,definitionVec);
+}
+
+/// Evaluates the parts of a user-defined function that
+/// don't depend on its arguments, and simplifies what is left.
+/// Only the pure built-in symbols are evaluated,
+/// since user-defined symbols can be redefined later.
+/// Calls that fail are left as written, so that
+/// they fail when the function runs, as they would have.
+/// @param definition a value of UserSymbol::definition,
+/// its expression will be modified
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void foldConstants(ManyType& definition, long recursionJuice) {
+    if (definition.type() != ManyTypeLabel::StructureVector) {
+        // it's not function-like
+        return;
+    }
+    mtvec& definitionVec = definition.getStructureVector();
+    foldExpression(definitionVec[0],definitionVec,recursionJuice);
+}
@@ -0,0 +1,12 @@
+/**
+ * @file FoldConstants.h
+ * @author Aaron Stanek
+ * @brief Function for evaluating the parts
+ * of a user-defined function that don't
+ * depend on its arguments, when it is defined
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+
+void foldConstants(ManyType&, long);
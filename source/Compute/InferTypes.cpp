@@ -0,0 +1,302 @@
+/**
+ * @file InferTypes.cpp
+ * @author Aaron Stanek
+*/
+#include "InferTypes.h"
+#include "Bytecode.h"
+#include "ParameterSlots.h"
+#include "../Bindings/Bindings.h"
+#include <map>
+#include <utility>
+
+/// The progress of finding the result types of a user-defined
+/// function called with arguments of certain types.
+struct InferenceEntry {
+    /// The types found so far. While running, this is
+    /// what recursive calls are assumed to return.
+    ManyTypeLabelInt result;
+    /// True until the types have been found.
+    bool running;
+    /// The number of entries that were running
+    /// when this one started.
+    size_t depth;
+};
+
+/// Everything known during one call to inferTypes or inferCallTypes.
+struct InferenceState {
+    /// Keyed by the function and the types of its arguments.
+    std::map<std::pair<const UserSymbol*,std::vector<ManyTypeLabelInt> >,InferenceEntry> entries;
+    /// The number of entries that are running.
+    size_t depth;
+    /// The smallest depth of a running entry whose result
+    /// was read since this was last reset.
+    /// Results that relied on a guess are not kept.
+    size_t lowestRead;
+    /// Where the types of the outermost function body are recorded,
+    /// or nullptr if they are not.
+    TypeInference* inference;
+};
+
+ManyTypeLabelInt inferUserTypes(InferenceState&, const UserSymbol&, const std::vector<ManyTypeLabelInt>&, long);
+
+ManyTypeLabelInt inferExpressionTypes(InferenceState&, const ManyType&, const mtvec&, const std::vector<ManyTypeLabelInt>&, const bool, long);
+
+/// Finds the types that a call may return.
+/// @param state the inference in progress
+/// @param x a StructureString or StructureVector in a function body
+/// @param definitionVec the definition containing x
+/// @param parameters the possible types of each argument of that definition
+/// @param record true if the types of x are recorded in state.inference
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return the possible types of the result
+ManyTypeLabelInt inferCallTypes(InferenceState& state, const ManyType& x, const mtvec& definitionVec, const std::vector<ManyTypeLabelInt>& parameters, const bool record, long recursionJuice) {
+    const mtvec* const sourceVec = (x.type() == ManyTypeLabel::StructureVector) ? &(x.getStructureVector()) : nullptr;
+    const uint_least32_t argumentCount = sourceVec ? sourceVec->size() - 1 : 0;
+    if (argumentCount >= MAX_ARGS_USED) {
+        // the call will fail
+        return 0;
+    }
+    const SymbolTableElement* const symbol = findSymbol(
+        sourceVec ? (*sourceVec)[0].getStructureString() : x.getStructureString(),
+        (argumentCount >= MAX_ARGS_DEF) ? (char)(-1) : (char)(argumentCount)
+        );
+    if (symbol == nullptr) {
+        // the call will fail
+        return 0;
+    }
+    std::vector<ManyTypeLabelInt> argumentTypes(argumentCount);
+    // conditionals and loops evaluate their delayed arguments where they are
+    const bool evaluatesDelayed = symbol->builtIn && builtInEvaluatesDelayedArguments(symbol->value.func);
+    for (uint_least32_t i = 1; i <= argumentCount; ++i) {
+        if (i <= 8 && ( (symbol->delayMask >> (i-1)) & 0x01 )) {
+            // delayed arguments are passed as written
+            // what they become is up to the callee
+            argumentTypes[i-1] = evaluatesDelayed ? inferExpressionTypes(state,(*sourceVec)[i],definitionVec,parameters,false,recursionJuice) : ANY_DATA_TYPE;
+        }
+        else {
+            // lazy arguments have the same types as
+            // evaluated ones, once they are read
+            argumentTypes[i-1] = inferExpressionTypes(state,(*sourceVec)[i],definitionVec,parameters,record,recursionJuice);
+        }
+    }
+    if (symbol->builtIn) {
+        return builtInResultTypes(symbol->value.func,argumentTypes.data(),argumentCount);
+    }
+    return inferUserTypes(state,*(symbol->value.user),argumentTypes,recursionJuice);
+}
+
+/// Finds the types that an element of a function body may have.
+/// @param state the inference in progress
+/// @param x a function body element
+/// @param definitionVec the definition containing x
+/// @param parameters the possible types of each argument of that definition
+/// @param record true if the types of x are recorded in state.inference
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return the possible types of the value of x
+ManyTypeLabelInt inferExpressionTypes(InferenceState& state, const ManyType& x, const mtvec& definitionVec, const std::vector<ManyTypeLabelInt>& parameters, const bool record, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        throw UserAlert(UserMessage::MaximumRecursionDepthReached,nullptr);
+    }
+    else {
+        --recursionJuice;
+    }
+    ManyTypeLabelInt output;
+    if ((ManyTypeLabelInt)(x.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+        // a constant
+        output = (ManyTypeLabelInt)(x.type());
+    }
+    else if (const uint_least32_t slot = findParameter(x,definitionVec)) {
+        output = (slot <= parameters.size()) ? parameters[slot-1] : ANY_DATA_TYPE;
+    }
+    else {
+        output = inferCallTypes(state,x,definitionVec,parameters,record,recursionJuice);
+    }
+    if (record) {
+        state.inference->nodes[&x] = output;
+    }
+    return output;
+}
+
+/// Finds the types that a user-defined symbol may return
+/// when called with arguments of certain types.
+/// Recursive calls are first assumed to return nothing,
+/// then what the body was found to return, until that stops growing.
+/// @param state the inference in progress
+/// @param user the symbol being called
+/// @param parameters the possible types of each argument
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return the possible types of the result
+ManyTypeLabelInt inferUserTypes(InferenceState& state, const UserSymbol& user, const std::vector<ManyTypeLabelInt>& parameters, long recursionJuice) {
+    if ((ManyTypeLabelInt)(user.definition.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+        // a variable
+        return (ManyTypeLabelInt)(user.definition.type());
+    }
+    if (user.definition.type() != ManyTypeLabel::StructureVector) {
+        // it's not function-like
+        return ANY_DATA_TYPE;
+    }
+    const auto key = std::make_pair(&user,parameters);
+    auto found = state.entries.find(key);
+    if (found != state.entries.end()) {
+        if (found->second.running) {
+            // a recursive call, use the guess
+            if (found->second.depth < state.lowestRead) {
+                state.lowestRead = found->second.depth;
+            }
+        }
+        return found->second.result;
+    }
+    // make sure that we are not running overtime
+    checkProcessingTime();
+    // only the outermost function body is recorded
+    const bool record = (state.inference != nullptr && state.depth == 0);
+    InferenceEntry& entry = state.entries[key];
+    entry.result = 0;
+    entry.running = true;
+    entry.depth = state.depth;
+    ++(state.depth);
+    const size_t outerRead = state.lowestRead;
+    const mtvec& definitionVec = user.definition.getStructureVector();
+    ManyTypeLabelInt output;
+    size_t lowest;
+    while (true) {
+        state.lowestRead = (size_t)(-1);
+        output = inferExpressionTypes(state,definitionVec[0],definitionVec,parameters,record,recursionJuice);
+        lowest = state.lowestRead;
+        if (lowest > entry.depth || output == entry.result) {
+            // no guess was read, or the guess was right
+            break;
+        }
+        // the types only grow, so this ends
+        entry.result = output;
+    }
+    --(state.depth);
+    // std::map doesn't move its entries
+    entry.result = output;
+    entry.running = false;
+    if (lowest < entry.depth) {
+        // this relied on a guess made by a caller
+        // which may still grow, so find it again next time
+        state.entries.erase(key);
+        state.lowestRead = (lowest < outerRead) ? lowest : outerRead;
+    }
+    else {
+        state.lowestRead = outerRead;
+    }
+    return output;
+}
+
+/// Finds the types that every element of the body of
+/// a user-defined function may have, when it is called
+/// with arguments of certain types. The built-in functions
+/// are described by builtInResultTypes. User-defined symbols
+/// are followed as they are currently defined.
+/// @param inference where the types will be placed
+/// @param user the function
+/// @param parameters the possible types of each argument,
+/// ANY_DATA_TYPE for those that are not known
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void inferTypes(TypeInference& inference, const UserSymbol& user, const std::vector<ManyTypeLabelInt>& parameters, long recursionJuice) {
+    InferenceState state;
+    state.depth = 0;
+    state.lowestRead = (size_t)(-1);
+    state.inference = &inference;
+    inference.nodes.clear();
+    inference.result = inferUserTypes(state,user,parameters,recursionJuice);
+}
+
+/// Finds the types that a call may return.
+/// @param baseName the called symbol
+/// @param argumentTypes the possible types of each argument
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return the possible types of the result
+/// @throw UserAlert if there is no such symbol
+ManyTypeLabelInt inferCallTypes(const mtstring& baseName, const std::vector<ManyTypeLabelInt>& argumentTypes, long recursionJuice) {
+    const uint_least32_t argumentCount = argumentTypes.size();
+    const SymbolTableElement& symbol = readSymbol(baseName,(argumentCount >= MAX_ARGS_DEF) ? (char)(-1) : (char)(argumentCount));
+    if (symbol.builtIn) {
+        return builtInResultTypes(symbol.value.func,argumentTypes.data(),argumentCount);
+    }
+    InferenceState state;
+    state.depth = 0;
+    state.lowestRead = (size_t)(-1);
+    state.inference = nullptr;
+    return inferUserTypes(state,*(symbol.value.user),argumentTypes,recursionJuice);
+}
+
+/// Writes a list of types for the user, such as Int|Float.
+/// @param output where the list will be placed
+/// @param types a bitmask of ManyTypeLabel values
+void describeTypes(mtstring& output, const ManyTypeLabelInt types) {
+    static const char* const names[] = { "None", "Bool", "Int", "Float", "String", "Vector" };
+    output.clear();
+    for (uint_least32_t i = 0; i < 6; ++i) {
+        if (types & (1 << i)) {
+            if (!output.empty()) {
+                output.push_back('|');
+            }
+            output.append(names[i]);
+        }
+    }
+    if (output.empty()) {
+        // evaluating it always fails
+        output.assign("Nothing");
+    }
+}
+
+/// Specializes a compiled function for the types of the arguments
+/// of its first call. Every built-in call whose arguments are
+/// proven to have exactly one type is quickened at once,
+/// instead of after QUICKEN_AFTER_CALLS calls.
+/// The specialized calls still check the types of their
+/// arguments, since later calls may pass other types.
+/// Must not be called while worker threads are running,
+/// since they may be running the same code.
+/// @param user the function, user.compiled must not be nullptr
+/// @param arguments the function call, [function_name,args...]
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void specializeCompiledFunction(UserSymbol& user, const mtvec& arguments, long recursionJuice) noexcept {
+    CompiledFunction& compiled = *(user.compiled);
+    compiled.specialized = true;
+    TypeInference inference;
+    try {
+        std::vector<ManyTypeLabelInt> parameters(arguments.size() - 1);
+        for (int_fast32_t i = 1; i < arguments.size(); ++i) {
+            // a lazy argument that has not been read could be anything
+            const ManyTypeLabelInt type = (ManyTypeLabelInt)(arguments[i].type());
+            parameters[i-1] = (type & ANY_DATA_TYPE) ? type : ANY_DATA_TYPE;
+        }
+        inferTypes(inference,user,parameters,recursionJuice);
+    }
+    catch (...) {
+        // the calls will be quickened as they run
+        return;
+    }
+    for (auto it = compiled.code.begin(); it != compiled.code.end(); ++it) {
+        if (it->opcode != Opcode::CallBuiltIn) {
+            continue;
+        }
+        CallSite& site = compiled.callSites[it->operand];
+        if (site.source == nullptr || site.argumentCount < 1 || site.argumentCount > 2) {
+            continue;
+        }
+        const mtvec& sourceVec = site.source->getStructureVector();
+        ManyTypeLabel labels[2];
+        bool proven = true;
+        for (uint_least32_t i = 0; i < site.argumentCount && proven; ++i) {
+            const auto found = inference.nodes.find(&(sourceVec[i+1]));
+            const ManyTypeLabelInt types = (found == inference.nodes.end()) ? 0 : found->second;
+            // exactly one type
+            proven = types != 0 && (types & (types - 1)) == 0;
+            labels[i] = (ManyTypeLabel)(types);
+        }
+        if (!proven) {
+            continue;
+        }
+        site.quickened = quickenBuiltIn(site.element->value.func,labels,site.argumentCount);
+        if (site.quickened) {
+            ++(site.quickenings);
+            it->opcode = Opcode::CallQuickened;
+        }
+    }
+}
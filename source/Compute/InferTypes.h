@@ -0,0 +1,37 @@
+/**
+ * @file InferTypes.h
+ * @author Aaron Stanek
+ * @brief Functions for finding the types that
+ * the values in a user-defined function may have
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "../Symbols/Symbols.h"
+#include <unordered_map>
+#include <vector>
+
+/// Every type that an evaluated value can have.
+#define ANY_DATA_TYPE ((ManyTypeLabelInt)(ManyTypeLabel::DataExpression))
+
+/// The types found by inferTypes.
+/// Each type is a bitmask of ManyTypeLabel values,
+/// any of which the value may have.
+/// 0 means that the value is never produced,
+/// because evaluating it always fails.
+struct TypeInference {
+    /// The possible types of each element of the function body,
+    /// keyed by its address inside UserSymbol::definition.
+    /// Delayed arguments are not included.
+    std::unordered_map<const ManyType*,ManyTypeLabelInt> nodes;
+    /// The possible types of the result.
+    ManyTypeLabelInt result;
+};
+
+void inferTypes(TypeInference&, const UserSymbol&, const std::vector<ManyTypeLabelInt>&, long);
+
+ManyTypeLabelInt inferCallTypes(const mtstring&, const std::vector<ManyTypeLabelInt>&, long);
+
+void describeTypes(mtstring&, const ManyTypeLabelInt);
+
+void specializeCompiledFunction(UserSymbol&, const mtvec&, long) noexcept;
@@ -3,16 +3,19 @@
  * @author Aaron Stanek
 */
 #include "LoadUserSymbol.h"
+#include "EvaluateExpression.h"
 #include "../LowLevelConvert/LowLevelConvert.h"
+#include "../Globals/Trace.h"
 #include <unordered_map>
 
-void resolveLocalVaraibleNames(ManyType& x, std::unordered_map<std::string,const ManyType*>& localVars, long recursionJuice) {
+void resolveLocalVaraibleNames(ManyType& x, std::unordered_map<mtstring,ManyType*>& localVars, long recursionJuice) {
     if (recursionJuice <= 0) {
         throw UserAlert(UserMessage::MaximumRecursionDepthReached,nullptr);
     }
     else {
         --recursionJuice;
     }
+    checkNativeStack();
     // resolve all the local variable names in x, and elements pointed to by x
     long logicalRecursionJuice = maximumLogicalRecursionDepth;
     // the loop runs exactly once
@@ -35,6 +38,12 @@ void resolveLocalVaraibleNames(ManyType& x, std::unordered_map<std::string,const
                 }
                 // make sure that we are not running overtime
                 checkProcessingTime();
+                if (it->first[0] != '%') {
+                    // only delayed arguments are meant to stay as written
+                    // anything else that was passed as written is
+                    // a lazy argument, evaluate it once for every use
+                    forceArgument(*(it->second),recursionJuice);
+                }
                 // now do the replacement
                 x.makeCopyFrom(*(it->second),recursionJuice);
                 // the value will replace the (localVariable) string
@@ -70,27 +79,72 @@ void resolveLocalVaraibleNames(ManyType& x, std::unordered_map<std::string,const
     }
 }
 
-void loadUserSymbol(ManyType& ret, const SymbolTableElement& source, const mtvec& callVec, long recursionJuice) {
+/// Replaces the local variable names in x
+/// with the values passed to a user-defined function.
+/// Used for functions whose local variables
+/// were not found when they were defined.
+/// @param x a copy of the function body
+/// @param sourceVec the definition of the function, [expression,varnames...]
+/// @param callVec the function call, [function_name,args...]
+/// with the same length as sourceVec, lazy arguments that
+/// are used will be evaluated in place
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void substituteArguments(ManyType& x, const mtvec& sourceVec, mtvec& callVec, long recursionJuice) {
+    if (sourceVec.size() == 1) {
+        // there are no local variables
+        return;
+    }
+    std::unordered_map<mtstring,ManyType*> localVars;
+    localVars.reserve(sourceVec.size() - 1);
+    // the sourceVec[n] is the name of the value
+    // stored at callVec[n] for n > 0
+    // all the values in callVec will have been resolved already,
+    // except for the delayed and lazy arguments
+    // sourceVec and callVec must have the same length
+    // because we got to sourceVec using the size of callVec
+    // and we know that all the elements of sourceVec[>0]
+    // are strings because we checked them on the way in
+    for (int_fast32_t i = sourceVec.size() - 1; i >= 1; --i) {
+        localVars[sourceVec[i].getStructureString()] = &callVec[i];
+    }
+    // we now have the mapping from local variable names
+    // to their values
+    resolveLocalVaraibleNames(x,localVars,recursionJuice);
+}
+
+/// Replaces a call to a user-defined symbol with its definition.
+/// @param ret where the definition will be placed
+/// @param source the symbol being called, it must not be built-in
+/// @param callVec the function call, [function_name,args...],
+/// lazy arguments that are used will be evaluated in place
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void loadUserSymbol(ManyType& ret, const SymbolTableElement& source, mtvec& callVec, long recursionJuice) {
     if (recursionJuice <= 0) {
         throw UserAlert(UserMessage::MaximumRecursionDepthReached,nullptr);
     }
     else {
         --recursionJuice;
     }
+    checkNativeStack();
+    // the call may have been renamed to None on the way here
+    const char* const name = (callVec[0].type() == ManyTypeLabel::StructureString) ? callVec[0].getStructureString().data() : "";
+    const size_t nameLength = (callVec[0].type() == ManyTypeLabel::StructureString) ? callVec[0].getStructureString().size() : 0;
+    const TraceScope scope(TraceEventKind::Load,name,nameLength,callVec.size()-1);
     // copies the source to ret
     // resolves any local variable names
     // we know that source is not built-in
-    // and that it has a valid value.mt field
-    if (source.value.mt.type() != ManyTypeLabel::StructureVector) {
+    // and that it has a valid value.user field
+    const ManyType& definition = source.value.user->definition;
+    if (definition.type() != ManyTypeLabel::StructureVector) {
         // it's not function-like
         // we can just copy it and be done
-        ret.makeCopyFrom(source.value.mt,recursionJuice);
+        ret.makeCopyFrom(definition,recursionJuice);
         // done!
     }
     else {
         // it's function-like, we have to copy only part
         // and do local variable name lookup
-        const mtvec& sourceVec = source.value.mt.getStructureVector();
+        const mtvec& sourceVec = definition.getStructureVector();
         // sourceVec[0] is the expression that needs to copied,
         // sourceVec[>0] are the local variable names
         ret.makeCopyFrom(sourceVec[0],recursionJuice);
@@ -101,21 +155,7 @@ void loadUserSymbol(ManyType& ret, const SymbolTableElement& source, const mtvec
             // only an expression
             return;
         }
-        std::unordered_map<std::string,const ManyType*> localVars;
-        localVars.reserve(sourceVec.size() - 1);
-        // the sourceVec[n] is the name of the value
-        // stored at callVec[n] for n > 0
-        // all the values in callVec will have been resolved already
-        // sourceVec and callVec must have the same length
-        // because we got to sourceVec using the size of callVec
-        // and we know that all the elements of sourceVec[>0]
-        // are strings because we checked them on the way in
-        for (int_fast32_t i = sourceVec.size() - 1; i >= 1; --i) {
-            localVars[sourceVec[i].getStructureString()] = &callVec[i];
-        }
-        // we now have the mapping from local variable names
-        // to their values
-        resolveLocalVaraibleNames(ret,localVars,recursionJuice);
+        substituteArguments(ret,sourceVec,callVec,recursionJuice);
         // all the local variable names have been resolved
         // we are done now
     }
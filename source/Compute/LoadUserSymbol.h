@@ -10,4 +10,4 @@
 #include "../ManyType/ManyType.h"
 #include "../Symbols/Symbols.h"
 
-void loadUserSymbol(ManyType&, const SymbolTableElement&, const mtvec&, long);
\ No newline at end of file
+void loadUserSymbol(ManyType&, const SymbolTableElement&, mtvec&, long);
\ No newline at end of file
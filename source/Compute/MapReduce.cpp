@@ -0,0 +1,304 @@
+/**
+ * @file MapReduce.cpp
+ * @author Aaron Stanek
+*/
+#include "MapReduce.h"
+#include "EvaluateExpression.h"
+#include "EvaluateConstExpression.h"
+#include "Memoize.h"
+#include "WorkStealingPool.h"
+#include "../Bindings/Broadcast.h"
+#include "../LowLevelConvert/LowLevelConvert.h"
+#include <exception>
+#include <vector>
+
+/// The number of elements in each chunk
+/// when the symbol is user-defined.
+#define USER_CHUNK_SIZE 64
+/// The number of elements in each chunk
+/// when the symbol is a built-in function,
+/// which does much less work per call.
+#define BUILT_IN_CHUNK_SIZE 4096
+/// Marks an ElementBatch with no errors.
+#define NO_FAILED_CHUNK ((uint_least32_t)(-1))
+
+/// What is done with each element of an ElementBatch.
+enum class ElementOperation : uint_fast8_t {
+    /// Replace the element with the result.
+    Map,
+    /// Keep the element if the result is true.
+    Filter,
+    /// Combine the elements of the chunk from left to right.
+    Reduce
+};
+
+/// A symbol being called on the elements of a vector.
+/// The elements are split into chunks of the same size,
+/// which are the tasks given to the pool.
+/// The chunks depend only on the number of elements
+/// and on the symbol, never on the number of threads,
+/// so the results are the same however many threads run.
+struct ElementBatch {
+    /// The symbol to call.
+    const mtstring& baseName;
+    ElementOperation operation;
+    /// The elements, in order.
+    /// Map and Reduce take them.
+    std::vector<ManyType*> elements;
+    uint_least32_t chunkSize;
+    /// For Filter, whether each element is kept.
+    /// Not std::vector<bool>, since chunks write to it at the same time.
+    std::vector<unsigned char> keep;
+    /// For Reduce, the result of each chunk.
+    mtvec partials;
+    long recursionJuice;
+    /// The exception thrown by each chunk, if any.
+    std::vector<std::exception_ptr> errors;
+    /// The lowest chunk that threw, or NO_FAILED_CHUNK.
+    std::atomic<uint_least32_t> firstError;
+};
+
+/// Calls a symbol with values that have already been evaluated,
+/// as the call baseName(first) or baseName(first,second) would.
+/// @param ret where the result will be placed, it will be a DataExpression
+/// @param baseName the symbol to call
+/// @param first the first argument, it will be taken
+/// @param second the second argument, it will be taken,
+/// or nullptr to call with one argument
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @throw UserAlert if there is no such symbol, or the call fails
+void callWithValues(ManyType& ret, const mtstring& baseName, ManyType& first, ManyType* const second, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        throw UserAlert(UserMessage::MaximumRecursionDepthReached,nullptr);
+    }
+    else {
+        --recursionJuice;
+    }
+    checkProcessingTime();
+    mtvec callVec;
+    callVec.resize(second ? 3 : 2);
+    callVec[0].putStructureString() = baseName;
+    callVec[1] = first;
+    if (second) {
+        callVec[2] = *second;
+    }
+    const SymbolTableElement& symbol = readSymbol(baseName,callVec.size() - 1);
+    callSymbol(ret,symbol,callVec,recursionJuice);
+    if (!( (ManyTypeLabelInt)(ret.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression) )) {
+        evaluateExpression(ret,recursionJuice);
+    }
+}
+
+/// Runs one chunk of an ElementBatch, from its first element to its last.
+/// Chunks after one that has failed are skipped,
+/// since their errors would never be reported.
+/// @param context the ElementBatch
+/// @param chunk the chunk to run
+void runElementChunk(void* context, uint_least32_t chunk) {
+    ElementBatch& batch = *(ElementBatch*)(context);
+    if (chunk > batch.firstError.load()) {
+        return;
+    }
+    const uint_least32_t begin = chunk * batch.chunkSize;
+    uint_least32_t end = begin + batch.chunkSize;
+    if (end > batch.elements.size()) {
+        end = batch.elements.size();
+    }
+    try {
+        switch (batch.operation) {
+            case ElementOperation::Map:
+            for (uint_least32_t i = begin; i < end; ++i) {
+                ManyType result;
+                callWithValues(result,batch.baseName,*(batch.elements[i]),nullptr,batch.recursionJuice);
+                *(batch.elements[i]) = result;
+            }
+            break;
+
+            case ElementOperation::Filter:
+            for (uint_least32_t i = begin; i < end; ++i) {
+                ManyType result;
+                ManyType argument;
+                argument.makeCopyFrom(*(batch.elements[i]),batch.recursionJuice);
+                callWithValues(result,batch.baseName,argument,nullptr,batch.recursionJuice);
+                convertToBool(result);
+                batch.keep[i] = result.getBool();
+            }
+            break;
+
+            default:
+            {
+                ManyType accumulator;
+                accumulator = *(batch.elements[begin]);
+                for (uint_least32_t i = begin + 1; i < end; ++i) {
+                    ManyType result;
+                    callWithValues(result,batch.baseName,accumulator,batch.elements[i],batch.recursionJuice);
+                    accumulator = result;
+                }
+                batch.partials[chunk] = accumulator;
+            }
+            break;
+        }
+    }
+    catch (...) {
+        batch.errors[chunk] = std::current_exception();
+        uint_least32_t first = batch.firstError.load();
+        while (chunk < first && !batch.firstError.compare_exchange_weak(first,chunk)) {
+            // first was reloaded, try again
+        }
+    }
+}
+
+/// Runs every chunk of an ElementBatch.
+/// If the symbol is pure, the chunks run on several threads.
+/// The profiler only measures one thread, so nothing
+/// runs in parallel while it is enabled.
+/// If several chunks fail, the first one is reported,
+/// as it would be if they ran one at a time.
+/// @param batch the batch, with elements, operation, and baseName set
+/// @param argCount the number of arguments passed to the symbol
+/// @param parallel false if the chunks must run one at a time
+/// @throw UserAlert if a call fails
+void runElementBatch(ElementBatch& batch, const char argCount, bool parallel) {
+    const SymbolTableElement* const symbol = findSymbol(batch.baseName,argCount);
+    batch.chunkSize = (symbol && symbol->builtIn) ? BUILT_IN_CHUNK_SIZE : USER_CHUNK_SIZE;
+    if (batch.operation == ElementOperation::Reduce && !parallel) {
+        // one chunk, combined strictly from left to right
+        batch.chunkSize = batch.elements.size();
+    }
+    const uint_least32_t chunkCount = (batch.elements.size() + batch.chunkSize - 1) / batch.chunkSize;
+    batch.errors.resize(chunkCount);
+    batch.partials.resize(chunkCount);
+    parallel = parallel && chunkCount >= 2 && maximumWorkerThreads > 0 && !profilingEnabled;
+    if (parallel) {
+        parallel = symbol && symbolIsPure(*symbol,batch.baseName,argCount,batch.recursionJuice);
+    }
+    if (parallel) {
+        runInParallel(&runElementChunk,&batch,chunkCount);
+    }
+    else {
+        for (uint_least32_t chunk = 0; chunk < chunkCount && batch.firstError.load() == NO_FAILED_CHUNK; ++chunk) {
+            runElementChunk(&batch,chunk);
+        }
+    }
+    if (batch.firstError.load() != NO_FAILED_CHUNK) {
+        std::rethrow_exception(batch.errors[batch.firstError.load()]);
+    }
+}
+
+/// Finds the elements of a vector, in order.
+/// The elements of a matrix are read row by row.
+/// @param elements where pointers to the elements will be placed
+/// @param x the vector
+/// @param name the built-in function, for errors
+/// @return the shape of x
+/// @throw UserAlert if x is not a vector or matrix
+VectorShape findElements(std::vector<ManyType*>& elements, ManyType& x, const char* const name) {
+    const VectorShape shape = readShape(x,name);
+    if (shape.kind == VectorKind::Scalar) {
+        throw UserAlert(UserMessage::UnexpectedType,name);
+    }
+    mtvec& vec = x.getDataVector();
+    elements.reserve(shape.rows * shape.columns);
+    for (int_fast32_t i = 1; i < vec.size(); ++i) {
+        if (shape.kind == VectorKind::Matrix) {
+            mtvec& row = vec[i].getDataVector();
+            for (int_fast32_t j = 1; j < row.size(); ++j) {
+                elements.push_back(&(row[j]));
+            }
+        }
+        else {
+            elements.push_back(&(vec[i]));
+        }
+    }
+    return shape;
+}
+
+/// Calls a symbol on every element of a vector or matrix.
+/// @param ret where the result will be placed,
+/// it has the same shape as x
+/// @param baseName the symbol to call, with one argument
+/// @param x the vector or matrix, it will be taken
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @throw UserAlert if x is not a vector, a call fails,
+/// or a call gives something other than a number
+void mapVector(ManyType& ret, const mtstring& baseName, ManyType& x, long recursionJuice) {
+    ElementBatch batch = { baseName, ElementOperation::Map, std::vector<ManyType*>(), 0, std::vector<unsigned char>(), mtvec(), recursionJuice, std::vector<std::exception_ptr>(), {NO_FAILED_CHUNK} };
+    findElements(batch.elements,x,"map");
+    runElementBatch(batch,1,true);
+    for (auto it = batch.elements.begin(); it != batch.elements.end(); ++it) {
+        // the elements of a vector are numbers
+        switch ((*it)->type()) {
+            case ManyTypeLabel::None:
+            case ManyTypeLabel::Bool:
+            case ManyTypeLabel::Int:
+            case ManyTypeLabel::Ftype:
+            break;
+
+            default:
+            throw UserAlert(UserMessage::UnexpectedType,"map");
+        }
+    }
+    ret = x;
+}
+
+/// Keeps the elements of a vector for which a symbol gives true.
+/// @param ret where the result will be placed,
+/// a vector of the same kind as x
+/// @param baseName the symbol to call, with one argument
+/// @param x the rowvec or colvec, it will be taken
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @throw UserAlert if x is not a rowvec or colvec, a call fails,
+/// or a call gives something that is not a condition
+void filterVector(ManyType& ret, const mtstring& baseName, ManyType& x, long recursionJuice) {
+    ElementBatch batch = { baseName, ElementOperation::Filter, std::vector<ManyType*>(), 0, std::vector<unsigned char>(), mtvec(), recursionJuice, std::vector<std::exception_ptr>(), {NO_FAILED_CHUNK} };
+    if (findElements(batch.elements,x,"filter").kind == VectorKind::Matrix) {
+        // the rows would no longer be the same length
+        throw UserAlert(UserMessage::UnexpectedType,"filter");
+    }
+    batch.keep.resize(batch.elements.size());
+    runElementBatch(batch,1,true);
+    ManyType output;
+    mtvec& vec = output.putDataVector();
+    vec.resize(1);
+    vec[0] = x.getDataVector()[0];
+    for (uint_least32_t i = 0; i < batch.elements.size(); ++i) {
+        if (batch.keep[i]) {
+            vec.resize(vec.size() + 1);
+            vec.back() = *(batch.elements[i]);
+        }
+    }
+    ret = output;
+}
+
+/// Combines the elements of a vector or matrix with a symbol,
+/// from left to right, as in f(f(f(x1,x2),x3),x4).
+/// If f is associative, the elements may be combined
+/// in a different grouping, such as f(f(x1,x2),f(x3,x4)),
+/// so that groups can be combined on several threads.
+/// The grouping depends only on the number of elements,
+/// so the result is the same on every run.
+/// @param ret where the result will be placed, None if x has no elements
+/// @param baseName the symbol to call, with two arguments
+/// @param x the vector or matrix, it will be taken
+/// @param associative true if the caller promises that
+/// f(f(a,b),c) is the same as f(a,f(b,c))
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @throw UserAlert if x is not a vector, or a call fails
+void reduceVector(ManyType& ret, const mtstring& baseName, ManyType& x, const bool associative, long recursionJuice) {
+    ElementBatch batch = { baseName, ElementOperation::Reduce, std::vector<ManyType*>(), 0, std::vector<unsigned char>(), mtvec(), recursionJuice, std::vector<std::exception_ptr>(), {NO_FAILED_CHUNK} };
+    findElements(batch.elements,x,"reduce");
+    if (batch.elements.empty()) {
+        ret.putNone();
+        return;
+    }
+    runElementBatch(batch,2,associative);
+    // combine the chunks from left to right
+    ManyType accumulator;
+    accumulator = batch.partials[0];
+    for (int_fast32_t i = 1; i < batch.partials.size(); ++i) {
+        ManyType result;
+        callWithValues(result,baseName,accumulator,&(batch.partials[i]),recursionJuice);
+        accumulator = result;
+    }
+    ret = accumulator;
+}
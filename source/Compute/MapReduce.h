@@ -0,0 +1,16 @@
+/**
+ * @file MapReduce.h
+ * @author Aaron Stanek
+ * @brief Functions for calling a symbol on every
+ * element of a vector, on several threads
+ * when the symbol is pure
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+
+void mapVector(ManyType&, const mtstring&, ManyType&, long);
+
+void filterVector(ManyType&, const mtstring&, ManyType&, long);
+
+void reduceVector(ManyType&, const mtstring&, ManyType&, const bool, long);
@@ -0,0 +1,397 @@
+/**
+ * @file Memoize.cpp
+ * @author Aaron Stanek
+*/
+#include "Memoize.h"
+#include "../Bindings/Bindings.h"
+#include <unordered_set>
+#include <utility>
+
+/// Held while any MemoTable is read or written,
+/// since worker threads call pure functions too.
+std::mutex memoMutex;
+
+/// One round of FNV-1a over a whole word.
+/// @param h the hash so far
+/// @param v the next value
+/// @return the updated hash
+inline size_t memoHashStep(const size_t h, const size_t v) noexcept {
+    return (h ^ v) * (size_t)(1099511628211ULL);
+}
+
+/// Hashes the structure and contents of x.
+/// Values that compare equal with sameValue
+/// always have the same hash.
+/// @param x the value to hash
+/// @param h the hash so far
+/// @param recursionJuice how many layers of recursion may be used by this operation,
+/// deeper elements are left out of the hash
+/// @return the updated hash
+size_t hashValue(const ManyType& x, size_t h, long recursionJuice) noexcept {
+    h = memoHashStep(h,(size_t)(x.type()));
+    switch (x.type()) {
+        case ManyTypeLabel::Bool:
+            return memoHashStep(h,(size_t)(x.getBool()));
+        case ManyTypeLabel::Int:
+            return memoHashStep(h,(size_t)(x.getInt()));
+        case ManyTypeLabel::Ftype: {
+            const ftype f = x.getFtype();
+            if (f != f) {
+                // every NaN is treated as the same value
+                return h;
+            }
+            return memoHashStep(h,std::hash<ftype>()(f));
+        }
+        case ManyTypeLabel::DataString:
+            return memoHashStep(h,std::hash<mtstring>()(x.getDataString()));
+        case ManyTypeLabel::StructureString:
+            return memoHashStep(h,std::hash<mtstring>()(x.getStructureString()));
+        case ManyTypeLabel::DataVector:
+        case ManyTypeLabel::StructureVector: {
+            if (recursionJuice <= 0) {
+                return h;
+            }
+            else {
+                --recursionJuice;
+            }
+            const mtvec& vec = (x.type() == ManyTypeLabel::StructureVector) ? x.getStructureVector() : x.getDataVector();
+            h = memoHashStep(h,vec.size());
+            for (int_fast32_t i = 0; i < vec.size(); ++i) {
+                h = hashValue(vec[i],h,recursionJuice);
+            }
+            return h;
+        }
+        default:
+            // ManyTypeLabel::None
+            return h;
+    }
+}
+
+/// @param a a value
+/// @param b a value
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return true if a and b have the same structure and contents.
+/// Floats must have the same sign, so that 0 and -0 are different.
+/// Any two NaNs are the same. Returns false if recursionJuice runs out.
+bool sameValue(const ManyType& a, const ManyType& b, long recursionJuice) noexcept {
+    if (a.type() != b.type()) {
+        return false;
+    }
+    switch (a.type()) {
+        case ManyTypeLabel::Bool:
+            return a.getBool() == b.getBool();
+        case ManyTypeLabel::Int:
+            return a.getInt() == b.getInt();
+        case ManyTypeLabel::Ftype: {
+            const ftype fa = a.getFtype();
+            const ftype fb = b.getFtype();
+            if (fa != fa || fb != fb) {
+                return (fa != fa) && (fb != fb);
+            }
+            return fa == fb && signbit(fa) == signbit(fb);
+        }
+        case ManyTypeLabel::DataString:
+            return a.getDataString() == b.getDataString();
+        case ManyTypeLabel::StructureString:
+            return a.getStructureString() == b.getStructureString();
+        case ManyTypeLabel::DataVector:
+        case ManyTypeLabel::StructureVector: {
+            if (recursionJuice <= 0) {
+                return false;
+            }
+            else {
+                --recursionJuice;
+            }
+            const mtvec& va = (a.type() == ManyTypeLabel::StructureVector) ? a.getStructureVector() : a.getDataVector();
+            const mtvec& vb = (b.type() == ManyTypeLabel::StructureVector) ? b.getStructureVector() : b.getDataVector();
+            if (va.size() != vb.size()) {
+                return false;
+            }
+            for (int_fast32_t i = 0; i < va.size(); ++i) {
+                if (!sameValue(va[i],vb[i],recursionJuice)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            // ManyTypeLabel::None
+            return true;
+    }
+}
+
+bool MemoKeyEqual::operator()(const MemoKey& a, const MemoKey& b) const noexcept {
+    if (a.hash != b.hash || a.arguments.size() != b.arguments.size()) {
+        return false;
+    }
+    for (int_fast32_t i = 0; i < a.arguments.size(); ++i) {
+        if (!sameValue(a.arguments[i],b.arguments[i],maximumRecursionDepth)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Adds a symbol to the dependencies of a function,
+/// unless it is already there.
+/// @param dependencies the dependencies found so far
+/// @param baseName the basename of the called symbol
+/// @param argCount the argCount passed to readSymbol
+void addDependency(std::vector<MemoDependency>& dependencies, const mtstring& baseName, const char argCount) {
+    for (auto it = dependencies.begin(); it != dependencies.end(); ++it) {
+        if (it->argCount == argCount && it->baseName == baseName) {
+            return;
+        }
+    }
+    dependencies.resize(dependencies.size() + 1);
+    dependencies.back().baseName = baseName;
+    dependencies.back().argCount = argCount;
+}
+
+/// Finds the symbols called by x, and by elements pointed to by x.
+/// @param dependencies where the symbols found are recorded
+/// @param x a function body element
+/// @param parameters the local variable names in x, or nullptr if there are none
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if x calls a built-in symbol that is not pure,
+/// or if that could not be determined
+bool collectDependencies(std::vector<MemoDependency>& dependencies, const ManyType& x, const ParameterSlot* const parameters, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        return false;
+    }
+    else {
+        --recursionJuice;
+    }
+    if ((ManyTypeLabelInt)(x.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+        // nothing is called
+        return true;
+    }
+    if (parameters && parameters->slot) {
+        // a local variable
+        return true;
+    }
+    // a symbol name is called with no arguments
+    const bool isVector = (x.type() == ManyTypeLabel::StructureVector);
+    if (isVector && (x.getStructureVector()[0].type() != ManyTypeLabel::StructureString || x.getStructureVector().size() > MAX_ARGS_USED)) {
+        // leave this for evaluateExpression to report
+        return false;
+    }
+    const mtstring& baseName = isVector ? x.getStructureVector()[0].getStructureString() : x.getStructureString();
+    const uint_least32_t argumentCount = isVector ? x.getStructureVector().size() - 1 : 0;
+    const char argCount = (argumentCount >= MAX_ARGS_DEF) ? (char)(-1) : (char)(argumentCount);
+    const BuiltInSymbol* builtIn = (argCount >= 0) ? readBuiltInSymbol(baseName,argCount) : nullptr;
+    if (builtIn) {
+        if (!builtIn->pure) {
+            return false;
+        }
+    }
+    else {
+        addDependency(dependencies,baseName,argCount);
+    }
+    for (uint_least32_t i = 1; i <= argumentCount; ++i) {
+        if (!collectDependencies(dependencies,x.getStructureVector()[i],elementParameters(parameters,i),recursionJuice)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Decides whether a user-defined function can be memoized.
+/// Only functions whose local variables were found can be,
+/// because the arguments of the others are not evaluated.
+/// Whether the user-defined symbols it calls are pure
+/// is checked by memoIsUsable, since they can be redefined.
+/// @param definition a value of UserSymbol::definition
+/// @param slots the local variable names of definition
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return a new, empty MemoTable, or nullptr if
+/// definition calls a built-in symbol that is not pure
+MemoTable* findMemoTable(const ManyType& definition, const ParameterSlots& slots, long recursionJuice) {
+    std::vector<MemoDependency> dependencies;
+    if (!collectDependencies(dependencies,definition.getStructureVector()[0],&(slots.body),recursionJuice)) {
+        return nullptr;
+    }
+    MemoTable* output = new MemoTable;
+    output->dependencies.swap(dependencies);
+    output->revision = 0;
+    output->usable = false;
+    return output;
+}
+
+/// Finds every user-defined symbol reachable through
+/// the dependencies of a function, and checks that all are pure.
+/// @param memo the MemoTable of the function
+/// @param serials where the UserSymbol::serial of each one is recorded
+/// @return false if any of them is not pure or is not defined
+bool findDependencySerials(const MemoTable& memo, std::vector<unsigned long>& serials) {
+    std::unordered_set<unsigned long> visited;
+    std::vector<const MemoTable*> pending(1,&memo);
+    while (!pending.empty()) {
+        const MemoTable* const table = pending.back();
+        pending.pop_back();
+        for (auto it = table->dependencies.begin(); it != table->dependencies.end(); ++it) {
+            const SymbolTableElement* const element = findSymbol(it->baseName,it->argCount);
+            if (element == nullptr) {
+                // the function would fail
+                // leave that for evaluateExpression to report
+                return false;
+            }
+            if (element->builtIn) {
+                // an n-matched built-in symbol, or one placed at runtime
+                // only the table knows whether it is pure
+                const BuiltInSymbol* builtIn = readBuiltInSymbol(it->baseName,-1);
+                if (builtIn == nullptr || &(builtIn->element) != element || !builtIn->pure) {
+                    return false;
+                }
+                continue;
+            }
+            const UserSymbol* const user = element->value.user;
+            if (!visited.insert(user->serial).second) {
+                continue;
+            }
+            serials.push_back(user->serial);
+            if ((ManyTypeLabelInt)(user->definition.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+                // a variable
+                continue;
+            }
+            if (user->memo == nullptr) {
+                return false;
+            }
+            pending.push_back(user->memo);
+        }
+    }
+    return true;
+}
+
+/// Checks whether remembered results may be used.
+/// Discards the results if any user-defined symbol
+/// that the function depends on has been redefined.
+/// The check is repeated only after userSymbolRevision changes.
+/// @param memo the MemoTable of the function
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return true if the function and all of its dependencies are pure
+bool memoIsUsable(MemoTable& memo, long recursionJuice) {
+    if (memo.revision == userSymbolRevision) {
+        return memo.usable;
+    }
+    std::vector<unsigned long> serials;
+    memo.usable = findDependencySerials(memo,serials);
+    if (!memo.usable || serials != memo.dependencySerials) {
+        memo.results.clear();
+    }
+    memo.dependencySerials.swap(serials);
+    memo.revision = userSymbolRevision;
+    return memo.usable;
+}
+
+/// Decides whether calling a symbol could change anything,
+/// or could give different results for the same arguments.
+/// @param symbol the result of readSymbol(baseName,argCount)
+/// @param baseName the basename of the called symbol
+/// @param argCount the argCount passed to readSymbol
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return true if symbol is a pure built-in symbol, a variable,
+/// or a user-defined function whose results may be remembered
+bool symbolIsPure(const SymbolTableElement& symbol, const mtstring& baseName, const char argCount, long recursionJuice) {
+    if (symbol.builtIn) {
+        // only the table knows whether it is pure
+        const BuiltInSymbol* builtIn = (argCount >= 0) ? readBuiltInSymbol(baseName,argCount) : nullptr;
+        if (builtIn == nullptr || &(builtIn->element) != &symbol) {
+            builtIn = readBuiltInSymbol(baseName,-1);
+        }
+        return builtIn && &(builtIn->element) == &symbol && builtIn->pure;
+    }
+    const UserSymbol& user = *(symbol.value.user);
+    if ((ManyTypeLabelInt)(user.definition.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+        // a variable
+        return true;
+    }
+    if (user.memo == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(memoMutex);
+    return memoIsUsable(*(user.memo),recursionJuice);
+}
+
+/// Moves the arguments of a call into a MemoKey.
+/// @param key where the arguments will be placed
+/// @param callVec the function call, [function_name,args...],
+/// its arguments will be None
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void takeMemoKey(MemoKey& key, mtvec& callVec, long recursionJuice) {
+    key.arguments.resize(callVec.size() - 1);
+    size_t h = (size_t)(14695981039346656037ULL);
+    for (int_fast32_t i = 1; i < callVec.size(); ++i) {
+        key.arguments[i-1] = callVec[i];
+        h = hashValue(key.arguments[i-1],h,recursionJuice);
+    }
+    key.hash = h;
+}
+
+/// Remembers the result of a call.
+/// If the table is full, everything in it is discarded first.
+/// If the result can not be copied within maximumMemory,
+/// it is not remembered.
+/// @param memo the MemoTable of the function
+/// @param key the arguments of the call, they will be taken
+/// @param result the result of the call
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void storeMemoizedResult(MemoTable& memo, MemoKey& key, const ManyType& result, long recursionJuice) {
+    if (memo.results.size() >= (size_t)(maximumMemoizedResults)) {
+        memo.results.clear();
+    }
+    ManyType copy;
+    try {
+        copy.makeCopyFrom(result,recursionJuice);
+    }
+    catch (UserAlert&) {
+        // remembering it is not worth failing over
+        return;
+    }
+    const auto inserted = memo.results.insert(std::make_pair(std::move(key),ManyType()));
+    if (inserted.second) {
+        inserted.first->second = copy;
+    }
+}
+
+/// Looks for the remembered result of a call.
+/// @param ret where the result will be placed, if it is found
+/// @param memo the MemoTable of the called function
+/// @param key if the result is missing, it will hold
+/// the arguments to pass to rememberResult
+/// @param callVec the function call, [function_name,args...],
+/// its arguments are left in place unless the result is found
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return whether ret was set, or the call must be made
+MemoLookup lookUpMemoizedResult(ManyType& ret, MemoTable& memo, MemoKey& key, mtvec& callVec, long recursionJuice) {
+    {
+        // worker threads may be using memo too
+        std::lock_guard<std::mutex> lock(memoMutex);
+        if (!memoIsUsable(memo,recursionJuice)) {
+            // it calls something that is not pure
+            return MemoLookup::Unusable;
+        }
+        takeMemoKey(key,callVec,recursionJuice);
+        const auto it = memo.results.find(key);
+        if (it != memo.results.end()) {
+            ret.makeCopyFrom(it->second,recursionJuice);
+            return MemoLookup::Found;
+        }
+    }
+    // the call needs its arguments back
+    for (int_fast32_t i = 1; i < callVec.size(); ++i) {
+        callVec[i].makeCopyFrom(key.arguments[i-1],recursionJuice);
+    }
+    return MemoLookup::Missing;
+}
+
+/// Remembers the result of a call that lookUpMemoizedResult
+/// reported as missing.
+/// @param memo the MemoTable of the called function
+/// @param key set by lookUpMemoizedResult, it will be taken
+/// @param result the result of the call
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void rememberResult(MemoTable& memo, MemoKey& key, const ManyType& result, long recursionJuice) {
+    std::lock_guard<std::mutex> lock(memoMutex);
+    storeMemoizedResult(memo,key,result,recursionJuice);
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+/**
+ * @file Memoize.h
+ * @author Aaron Stanek
+ * @brief Structs and functions for remembering
+ * the results of pure user-defined functions
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "../Symbols/Symbols.h"
+#include "ParameterSlots.h"
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/// A symbol called by the body of a user-defined function.
+struct MemoDependency {
+    /// The basename of the called symbol.
+    mtstring baseName;
+    /// The argCount passed to readSymbol.
+    char argCount;
+};
+
+/// The evaluated arguments of a call to a pure function.
+struct MemoKey {
+    /// A structural hash of arguments.
+    size_t hash;
+    /// The arguments, without the function name.
+    mtvec arguments;
+};
+
+/// Hash functor for MemoKey.
+struct MemoKeyHash {
+    inline size_t operator()(const MemoKey& key) const noexcept {
+        return key.hash;
+    };
+};
+
+/// Equality functor for MemoKey.
+/// Compares arguments element by element.
+struct MemoKeyEqual {
+    bool operator()(const MemoKey&, const MemoKey&) const noexcept;
+};
+
+/// The remembered results of a user-defined function
+/// that calls nothing but pure functions.
+/// Owned by a UserSymbol.
+struct MemoTable {
+    /// Every symbol that the function body calls
+    /// other than the pure built-in symbols,
+    /// which can never change.
+    std::vector<MemoDependency> dependencies;
+    /// The value of userSymbolRevision when
+    /// usable and dependencySerials were last computed.
+    unsigned long revision;
+    /// True if every dependency, and every dependency
+    /// of those, was pure at revision.
+    bool usable;
+    /// The UserSymbol::serial of every user-defined
+    /// symbol reachable through dependencies at revision.
+    /// If any of them are redefined, results must be discarded.
+    std::vector<unsigned long> dependencySerials;
+    /// Results keyed by arguments.
+    std::unordered_map<MemoKey,ManyType,MemoKeyHash,MemoKeyEqual> results;
+};
+
+/// The outcome of lookUpMemoizedResult.
+enum class MemoLookup : uint_fast8_t {
+    /// The function calls something that is not pure,
+    /// the call must be made without remembering it.
+    Unusable,
+    /// The remembered result was placed in ret.
+    Found,
+    /// The call must be made, then its result
+    /// remembered with rememberResult.
+    Missing
+};
+
+extern std::mutex memoMutex;
+
+size_t hashValue(const ManyType&, size_t, long) noexcept;
+
+bool sameValue(const ManyType&, const ManyType&, long) noexcept;
+
+MemoTable* findMemoTable(const ManyType&, const ParameterSlots&, long);
+
+bool memoIsUsable(MemoTable&, long);
+
+bool symbolIsPure(const SymbolTableElement&, const mtstring&, const char, long);
+
+void takeMemoKey(MemoKey&, mtvec&, long);
+
+void storeMemoizedResult(MemoTable&, MemoKey&, const ManyType&, long);
+
+MemoLookup lookUpMemoizedResult(ManyType&, MemoTable&, MemoKey&, mtvec&, long);
+
+void rememberResult(MemoTable&, MemoKey&, const ManyType&, long);
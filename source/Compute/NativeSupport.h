@@ -0,0 +1,121 @@
+/**
+ * @file NativeSupport.h
+ * @author Aaron Stanek
+ * @brief Functions called by user-defined functions
+ * that were transpiled to C++, giving the same results
+ * and errors as the built-in functions they stand for
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "../LowLevelConvert/LowLevelConvert.h"
+#include "../Symbols/Symbols.h"
+#include "../Bindings/Bindings.h"
+#include "EvaluateExpression.h"
+#include <cmath>
+
+/// The deepest that a transpiled function may call itself.
+/// The calls nest on the thread's stack,
+/// so this is less than maximumRecursionDepth may be.
+#define NATIVE_RECURSION_LIMIT 10000
+
+/// Finds a built-in function when transpiled code is loaded.
+/// @param baseName the name of the built-in function
+/// @param argCount the argCount passed to readBuiltInSymbol
+/// @return the built-in function
+inline boundFunction nativeBuiltIn(const char* const baseName, const char argCount) {
+    const BuiltInSymbol* const builtIn = readBuiltInSymbol(mtstring(baseName),argCount);
+    return builtIn ? builtIn->element.value.func : nullptr;
+}
+
+/// Calls a built-in function the way the bytecode does.
+/// @param ret where the result will be placed, it will be a DataExpression
+/// @param func the built-in function
+/// @param arguments the arguments, they will be taken
+/// @param argumentCount the number of arguments
+/// @param recursionJuice how many layers of recursion may be used by this operation
+inline void nativeCall(ManyType& ret, const boundFunction func, ManyType* const arguments, const uint_least32_t argumentCount, long recursionJuice) {
+    mtvec callVec;
+    callVec.resize(argumentCount + 1);
+    for (uint_least32_t i = 0; i < argumentCount; ++i) {
+        callVec[i+1] = arguments[i];
+    }
+    checkProcessingTime();
+    func(ret,callVec,recursionJuice);
+    if (!( (ManyTypeLabelInt)(ret.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression) )) {
+        evaluateExpression(ret,recursionJuice);
+    }
+}
+
+/// @param x an evaluated value
+/// @return true if x is an Int or a Float
+inline bool isNativeNumber(const ManyType& x) noexcept {
+    return x.type() == ManyTypeLabel::Int || x.type() == ManyTypeLabel::Ftype;
+}
+
+/// @param x an Int or a Float
+/// @return the value of x as a Float
+inline ftype readNativeNumber(const ManyType& x) noexcept {
+    return (x.type() == ManyTypeLabel::Int) ? (ftype)(x.getInt()) : x.getFtype();
+}
+
+/// Checks the result of add or sub.
+/// @param output the result
+/// @param name the built-in function, for errors
+/// @throw UserAlert if output is NaN or infinite
+inline void checkNativeResult(const ftype output, const char* const name) {
+    if (std::isnan(output)) {
+        throw UserAlert(UserMessage::NanError,name);
+    }
+    if (std::isinf(output)) {
+        throw UserAlert(UserMessage::InfinityError,name);
+    }
+}
+
+/// add, for a transpiled function.
+/// Numbers are added directly, the rest go through add_implement.
+inline void nativeAdd(ManyType& ret, ManyType* const arguments, long recursionJuice) {
+    if (isNativeNumber(arguments[0]) && isNativeNumber(arguments[1])) {
+        const ftype output = readNativeNumber(arguments[0]) + readNativeNumber(arguments[1]);
+        checkNativeResult(output,"add");
+        ret.putFtype(output);
+        return;
+    }
+    nativeCall(ret,&add_implement,arguments,2,recursionJuice);
+}
+
+/// sub, for a transpiled function.
+/// Numbers are subtracted directly, the rest go through sub_implement.
+inline void nativeSub(ManyType& ret, ManyType* const arguments, long recursionJuice) {
+    if (isNativeNumber(arguments[0]) && isNativeNumber(arguments[1])) {
+        const ftype output = readNativeNumber(arguments[0]) - readNativeNumber(arguments[1]);
+        checkNativeResult(output,"sub");
+        ret.putFtype(output);
+        return;
+    }
+    nativeCall(ret,&sub_implement,arguments,2,recursionJuice);
+}
+
+/// bool, int or float, for a transpiled function.
+/// Scalars are converted directly, vectors go through func.
+/// @param ret where the result will be placed
+/// @param arguments the argument, it will be taken
+/// @param convert the conversion for a scalar
+/// @param func the built-in function
+/// @param recursionJuice how many layers of recursion may be used by this operation
+inline void nativeConvert(ManyType& ret, ManyType* const arguments, void (*convert)(ManyType&), const boundFunction func, long recursionJuice) {
+    if (arguments[0].type() != ManyTypeLabel::DataVector) {
+        convert(arguments[0]);
+        ret = arguments[0];
+        return;
+    }
+    nativeCall(ret,func,arguments,1,recursionJuice);
+}
+
+/// Evaluates the condition of if, and, or or.
+/// @param x the evaluated condition, it will be converted
+/// @return the condition as a bool
+inline bool nativeCondition(ManyType& x) {
+    convertToBool(x);
+    return x.getBool();
+}
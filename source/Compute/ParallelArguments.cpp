@@ -0,0 +1,173 @@
+/**
+ * @file ParallelArguments.cpp
+ * @author Aaron Stanek
+*/
+#include "ParallelArguments.h"
+#include "EvaluateExpression.h"
+#include "Memoize.h"
+#include "WorkStealingPool.h"
+#include <exception>
+
+/// The estimated work of calling a user-defined function,
+/// in units of one expression element.
+#define USER_CALL_WORK 1024
+/// The estimated work, not counting the largest argument,
+/// that makes evaluating arguments in parallel worthwhile.
+#define PARALLEL_WORK_THRESHOLD 2048
+/// The number of expression elements examined for each call
+/// before giving up on evaluating its arguments in parallel.
+#define PARALLEL_SCAN_BUDGET 4096
+/// Marks an ArgumentBatch with no errors.
+#define NO_FAILED_TASK ((uint_least32_t)(-1))
+
+/// The arguments of one call, being evaluated in parallel.
+struct ArgumentBatch {
+    /// The function call, [function_name,args...].
+    mtvec& callVec;
+    /// The index in callVec of each task.
+    std::vector<uint_least32_t> indices;
+    long recursionJuice;
+    /// The exception thrown by each task, if any.
+    std::vector<std::exception_ptr> errors;
+    /// The lowest task that threw, or NO_FAILED_TASK.
+    std::atomic<uint_least32_t> firstError;
+};
+
+/// @param x a call or symbol name in an argument
+/// @param baseName will point to the basename of the called symbol
+/// @param argCount will be set to the argCount passed to readSymbol
+/// @return the symbol it calls, or nullptr if
+/// that could not be found, which will be reported
+/// when it is evaluated one argument at a time
+const SymbolTableElement* findCalledSymbol(const ManyType& x, mtstring const*& baseName, char& argCount) {
+    const bool isVector = (x.type() == ManyTypeLabel::StructureVector);
+    if (isVector && (x.getStructureVector()[0].type() != ManyTypeLabel::StructureString || x.getStructureVector().size() > MAX_ARGS_USED)) {
+        return nullptr;
+    }
+    baseName = isVector ? &(x.getStructureVector()[0].getStructureString()) : &(x.getStructureString());
+    const uint_least32_t argumentCount = isVector ? x.getStructureVector().size() - 1 : 0;
+    argCount = (argumentCount >= MAX_ARGS_DEF) ? (char)(-1) : (char)(argumentCount);
+    return findSymbol(*baseName,argCount);
+}
+
+/// Estimates the work of evaluating an argument,
+/// and checks that evaluating it changes nothing
+/// that another argument could read.
+/// @param x the argument, or an element of it
+/// @param work the estimate is added to this
+/// @param budget the number of elements that may still be examined
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if x may not be pure, or if budget ran out
+bool estimateArgumentWork(const ManyType& x, unsigned long& work, long& budget, long recursionJuice) {
+    if (recursionJuice <= 0 || budget <= 0) {
+        return false;
+    }
+    else {
+        --recursionJuice;
+        --budget;
+    }
+    ++work;
+    if ((ManyTypeLabelInt)(x.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression)) {
+        // evaluateExpression leaves it as it is
+        return true;
+    }
+    const mtstring* baseName;
+    char argCount;
+    const SymbolTableElement* const symbol = findCalledSymbol(x,baseName,argCount);
+    if (symbol == nullptr || !symbolIsPure(*symbol,*baseName,argCount,recursionJuice)) {
+        return false;
+    }
+    if (!symbol->builtIn && !( (ManyTypeLabelInt)(symbol->value.user->definition.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression) )) {
+        work += USER_CALL_WORK;
+    }
+    if (x.type() != ManyTypeLabel::StructureVector) {
+        return true;
+    }
+    const mtvec& vec = x.getStructureVector();
+    for (int_fast32_t i = 1; i < vec.size(); ++i) {
+        if (passesAsWritten(*symbol,i)) {
+            // what a delayed argument does is up to the callee
+            return false;
+        }
+        if (!estimateArgumentWork(vec[i],work,budget,recursionJuice)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Evaluates one argument of an ArgumentBatch.
+/// Arguments after one that has failed are skipped,
+/// since their errors would never be reported.
+/// @param context the ArgumentBatch
+/// @param index the task to run
+void evaluateArgumentTask(void* context, uint_least32_t index) {
+    ArgumentBatch& batch = *(ArgumentBatch*)(context);
+    if (index > batch.firstError.load()) {
+        return;
+    }
+    try {
+        evaluateExpression(batch.callVec[batch.indices[index]],batch.recursionJuice);
+    }
+    catch (...) {
+        batch.errors[index] = std::current_exception();
+        uint_least32_t first = batch.firstError.load();
+        while (index < first && !batch.firstError.compare_exchange_weak(first,index)) {
+            // first was reloaded, try again
+        }
+    }
+}
+
+/// Evaluates the arguments of a call on several threads,
+/// if they are independent and there is enough work to share.
+/// Both the called symbol and every argument must be pure.
+/// The profiler only measures one thread, so nothing
+/// is evaluated in parallel while it is enabled.
+/// If several arguments fail, the first one is reported,
+/// as it would be if they were evaluated one at a time.
+/// @param callVec the function call, [function_name,args...]
+/// @param symbol the symbol being called
+/// @param recursionJuice how many layers of recursion may be used by
+/// the evaluation of each argument
+/// @return false if nothing was evaluated, in which case
+/// the caller should evaluate the arguments one at a time
+/// @throw UserAlert if an argument could not be evaluated
+bool evaluateArgumentsInParallel(mtvec& callVec, const SymbolTableElement& symbol, long recursionJuice) {
+    if (maximumWorkerThreads <= 0 || profilingEnabled || callVec.size() < 3) {
+        return false;
+    }
+    const char argCount = (callVec.size() > MAX_ARGS_DEF) ? (char)(-1) : (char)(callVec.size()-1);
+    if (!symbolIsPure(symbol,callVec[0].getStructureString(),argCount,recursionJuice)) {
+        return false;
+    }
+    ArgumentBatch batch = { callVec, std::vector<uint_least32_t>(), recursionJuice, std::vector<std::exception_ptr>(), {NO_FAILED_TASK} };
+    long budget = PARALLEL_SCAN_BUDGET;
+    unsigned long totalWork = 0;
+    unsigned long largestWork = 0;
+    for (int_fast32_t i = 1; i < callVec.size(); ++i) {
+        if (passesAsWritten(symbol,i)) {
+            continue;
+        }
+        unsigned long work = 0;
+        if (!estimateArgumentWork(callVec[i],work,budget,recursionJuice)) {
+            return false;
+        }
+        if (!( (ManyTypeLabelInt)(callVec[i].type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression) )) {
+            // arguments that are already evaluated are left alone
+            batch.indices.push_back(i);
+        }
+        totalWork += work;
+        if (work > largestWork) {
+            largestWork = work;
+        }
+    }
+    if (totalWork - largestWork < PARALLEL_WORK_THRESHOLD) {
+        return false;
+    }
+    batch.errors.resize(batch.indices.size());
+    runInParallel(&evaluateArgumentTask,&batch,batch.indices.size());
+    if (batch.firstError.load() != NO_FAILED_TASK) {
+        std::rethrow_exception(batch.errors[batch.firstError.load()]);
+    }
+    return true;
+}
@@ -0,0 +1,13 @@
+/**
+ * @file ParallelArguments.h
+ * @author Aaron Stanek
+ * @brief Function for evaluating the
+ * independent arguments of a call
+ * on several threads
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "../Symbols/Symbols.h"
+
+bool evaluateArgumentsInParallel(mtvec&, const SymbolTableElement&, long);
@@ -0,0 +1,134 @@
+/**
+ * @file ParameterSlots.cpp
+ * @author Aaron Stanek
+*/
+#include "ParameterSlots.h"
+#include <memory>
+#include <vector>
+
+/// @param x a function body element
+/// @param definitionVec the definition containing x
+/// @return the index of x in definitionVec if x is
+/// a local variable name, 0 otherwise
+uint_least32_t findParameter(const ManyType& x, const mtvec& definitionVec) {
+    if (x.type() != ManyTypeLabel::StructureString) {
+        return 0;
+    }
+    const mtstring& name = x.getStructureString();
+    // the first match wins, as it does in loadUserSymbol
+    for (uint_least32_t i = 1; i < definitionVec.size(); ++i) {
+        if (definitionVec[i].getStructureString() == name) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+/// @param x a function body element
+/// @param definitionVec the definition containing x
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return true if x or any of its children
+/// would be replaced by loadUserSymbol,
+/// or if that could not be determined
+bool containsParameter(const ManyType& x, const mtvec& definitionVec, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        return true;
+    }
+    else {
+        --recursionJuice;
+    }
+    if (findParameter(x,definitionVec)) {
+        return true;
+    }
+    if ((ManyTypeLabelInt)(x.type()) & (ManyTypeLabelInt)(ManyTypeLabel::Vector)) {
+        const mtvec& vec = (x.type() == ManyTypeLabel::StructureVector) ? x.getStructureVector() : x.getDataVector();
+        for (int_fast32_t i = 0; i < vec.size(); ++i) {
+            if (containsParameter(vec[i],definitionVec,recursionJuice)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/// Fills in the local variable names in x,
+/// and in elements pointed to by x.
+/// @param uses where the names found are recorded,
+/// in the order they are evaluated
+/// @param parameters where the names in x are placed,
+/// it must not move while uses is in use
+/// @param x a function body element
+/// @param definitionVec the definition containing x
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if recursionJuice ran out
+bool collectParameterUses(std::vector<ParameterSlot*>& uses, ParameterSlot& parameters, const ManyType& x, const mtvec& definitionVec, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        return false;
+    }
+    else {
+        --recursionJuice;
+    }
+    parameters.slot = findParameter(x,definitionVec);
+    parameters.lastUse = false;
+    if (parameters.slot) {
+        uses.push_back(&parameters);
+        return true;
+    }
+    if ((ManyTypeLabelInt)(x.type()) & (ManyTypeLabelInt)(ManyTypeLabel::Vector)) {
+        const mtvec& vec = (x.type() == ManyTypeLabel::StructureVector) ? x.getStructureVector() : x.getDataVector();
+        const size_t found = uses.size();
+        // the elements are not resized again, so they don't move
+        parameters.elements.resize(vec.size());
+        parameters.elements[0].slot = 0;
+        parameters.elements[0].lastUse = false;
+        // the first element is the function name or data type
+        // loadUserSymbol only replaces it if it starts with '%'
+        // and these local variable names never do
+        for (uint_least32_t i = 1; i < vec.size(); ++i) {
+            if (!collectParameterUses(uses,parameters.elements[i],vec[i],definitionVec,recursionJuice)) {
+                return false;
+            }
+        }
+        if (uses.size() == found) {
+            // nothing in it is replaced
+            std::vector<ParameterSlot>().swap(parameters.elements);
+        }
+    }
+    return true;
+}
+
+/// Finds the local variable names in the body of a user-defined function.
+/// Functions with delayed arguments are not handled,
+/// because their arguments may contain local variable names too.
+/// loadUserSymbol looks those up by name instead.
+/// @param definition a value of UserSymbol::definition,
+/// it must not move or change while the result is in use
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return a new ParameterSlots, or nullptr if definition
+/// is not function-like or could not be handled
+ParameterSlots* findParameterSlots(const ManyType& definition, long recursionJuice) {
+    if (definition.type() != ManyTypeLabel::StructureVector) {
+        // it's not function-like
+        return nullptr;
+    }
+    const mtvec& definitionVec = definition.getStructureVector();
+    for (int_fast32_t i = 1; i < definitionVec.size(); ++i) {
+        if (definitionVec[i].getStructureString()[0] == '%') {
+            return nullptr;
+        }
+    }
+    std::unique_ptr<ParameterSlots> output(new ParameterSlots);
+    std::vector<ParameterSlot*> uses;
+    if (!collectParameterUses(uses,output->body,definitionVec[0],definitionVec,recursionJuice)) {
+        return nullptr;
+    }
+    // the last use of each argument can take it
+    // instead of copying it
+    std::vector<bool> seen(definitionVec.size(),false);
+    for (auto it = uses.rbegin(); it != uses.rend(); ++it) {
+        ParameterSlot& parameter = **it;
+        parameter.lastUse = !seen[parameter.slot];
+        seen[parameter.slot] = true;
+    }
+    return output.release();
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+/**
+ * @file ParameterSlots.h
+ * @author Aaron Stanek
+ * @brief Structs and functions for finding the
+ * local variables of a user-defined function
+ * once, when it is defined
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include <vector>
+
+/// The local variable names in a function body element.
+/// It has the shape of the element, so they are found
+/// by walking both together, without a lookup.
+struct ParameterSlot {
+    /// The index of the argument that replaces
+    /// the element, counting from 1,
+    /// or 0 if it is not a local variable name.
+    uint_least32_t slot;
+    /// True for exactly one use of each slot,
+    /// the last one in evaluation order.
+    /// That use may take the argument instead of copying it.
+    bool lastUse;
+    /// One for each element of the element, if it is a vector
+    /// that contains a local variable name, otherwise empty.
+    std::vector<ParameterSlot> elements;
+};
+
+/// Every local variable name in a function body.
+/// Owned by a UserSymbol.
+struct ParameterSlots {
+    /// Has the shape of the body, UserSymbol::definition[0].
+    ParameterSlot body;
+};
+
+/// @param parameters the local variable names in a function body element,
+/// or nullptr if there are none
+/// @param index the index of an element of that element
+/// @return the local variable names in element index,
+/// or nullptr if there are none
+inline const ParameterSlot* elementParameters(const ParameterSlot* const parameters, const uint_least32_t index) noexcept {
+    if (parameters == nullptr || parameters->elements.empty()) {
+        return nullptr;
+    }
+    const ParameterSlot& element = parameters->elements[index];
+    return (element.slot || !element.elements.empty()) ? &element : nullptr;
+}
+
+uint_least32_t findParameter(const ManyType&, const mtvec&);
+
+bool containsParameter(const ManyType&, const mtvec&, long);
+
+ParameterSlots* findParameterSlots(const ManyType&, long);
@@ -0,0 +1,245 @@
+/**
+ * @file Profiler.cpp
+ * @author Aaron Stanek
+*/
+#include "Profiler.h"
+#include "../ManyType/AccountedAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/// What was measured for one symbol.
+struct ProfileEntry {
+    /// The number of calls.
+    unsigned long calls;
+    /// Time spent in the symbol, including the symbols it called.
+    /// Recursive calls are counted once.
+    double inclusiveSeconds;
+    /// Time spent in the symbol itself.
+    double exclusiveSeconds;
+    /// Bytes allocated by the symbol, including the symbols it called.
+    /// Recursive calls are counted once.
+    unsigned long long inclusiveBytes;
+    /// Bytes allocated by the symbol itself.
+    unsigned long long exclusiveBytes;
+    /// The number of calls to the symbol that have not returned.
+    unsigned long active;
+    /// The index of the name of the symbol in profileNames.
+    uint_least32_t symbol;
+};
+
+/// A distinct call stack, stored as the stack of its caller
+/// and the symbol called, so that each is only stored once.
+struct ProfileNode {
+    /// The index in profileNodes of the stack of the caller.
+    uint_least32_t parent;
+    /// The ProfileEntry::symbol of the innermost call.
+    uint_least32_t symbol;
+    /// Exclusive time in microseconds.
+    double microseconds;
+};
+
+/// A call that has not returned.
+struct ProfileFrame {
+    ProfileEntry* entry;
+    std::chrono::steady_clock::time_point start;
+    /// The bytes counted by profiledBytesOfCalls when the call started.
+    unsigned long long startBytes;
+    /// Time spent in the calls made by this call.
+    double childSeconds;
+    /// Bytes allocated by the calls made by this call.
+    unsigned long long childBytes;
+    /// The index in profileNodes of the stack ending with this call.
+    uint_least32_t node;
+};
+
+/// Keyed by basename/argumentCount.
+std::unordered_map<mtstring,ProfileEntry,std::hash<mtstring>,std::equal_to<mtstring>,
+    AccountedAllocator<std::pair<const mtstring,ProfileEntry> > > profileTable;
+
+/// The keys of profileTable, indexed by ProfileEntry::symbol.
+std::vector<const mtstring*,AccountedAllocator<const mtstring*> > profileNames;
+
+/// The calls that have not returned, innermost last.
+std::vector<ProfileFrame,AccountedAllocator<ProfileFrame> > profileStack;
+
+/// Every call stack measured. The first is the empty stack,
+/// which is the parent of the outermost calls.
+std::vector<ProfileNode,AccountedAllocator<ProfileNode> > profileNodes;
+
+/// The index in profileNodes of each stack,
+/// keyed by (parent << 32) | symbol.
+std::unordered_map<uint_least64_t,uint_least32_t,std::hash<uint_least64_t>,std::equal_to<uint_least64_t>,
+    AccountedAllocator<std::pair<const uint_least64_t,uint_least32_t> > > profileChildren;
+
+/// Bytes allocated by the tables above while profiling,
+/// which are not counted against the calls being measured.
+unsigned long long profilerBytes = 0;
+
+/// @return the bytes allocated by the calls being measured
+inline unsigned long long profiledBytesOfCalls() noexcept {
+    return profiledBytes - profilerBytes;
+}
+
+/// Starts measuring a call.
+/// Only call this if profilingEnabled is true.
+/// Parallel evaluation is off while profiling,
+/// so everything here is only used by one thread.
+/// @param baseName the basename of the called symbol
+/// @param argumentCount the number of arguments passed
+/// @throw UserAlert if maximumMemory is reached,
+/// in which case the call is not measured
+void profileEnter(const mtstring& baseName, const uint_least32_t argumentCount) {
+    const unsigned long long bytesBefore = profiledBytes;
+    try {
+        mtstring name(baseName);
+        name.push_back('/');
+        const std::string count = std::to_string(argumentCount);
+        name.append(count.c_str(),count.size());
+        auto found = profileTable.find(name);
+        if (found == profileTable.end()) {
+            profileNames.reserve(profileNames.size() + 1);
+            found = profileTable.insert(std::make_pair(name,ProfileEntry())).first;
+            found->second.symbol = profileNames.size();
+            profileNames.push_back(&(found->first));
+        }
+        ProfileEntry& entry = found->second;
+        const uint_least32_t parent = profileStack.empty() ? 0 : profileStack.back().node;
+        const uint_least64_t key = ((uint_least64_t)(parent) << 32) | entry.symbol;
+        auto child = profileChildren.find(key);
+        if (child == profileChildren.end()) {
+            profileNodes.reserve(profileNodes.size() + 1);
+            child = profileChildren.insert(std::make_pair(key,(uint_least32_t)(profileNodes.size()))).first;
+            ProfileNode node;
+            node.parent = parent;
+            node.symbol = entry.symbol;
+            node.microseconds = 0;
+            profileNodes.push_back(node);
+        }
+        profileStack.resize(profileStack.size() + 1);
+        ++(entry.calls);
+        ++(entry.active);
+        ProfileFrame& frame = profileStack.back();
+        frame.entry = &entry;
+        frame.childSeconds = 0;
+        frame.childBytes = 0;
+        frame.node = child->second;
+    }
+    catch (...) {
+        profilerBytes += profiledBytes - bytesBefore;
+        throw;
+    }
+    profilerBytes += profiledBytes - bytesBefore;
+    profileStack.back().startBytes = profiledBytesOfCalls();
+    // read the clock last, so that the work above is not counted
+    profileStack.back().start = std::chrono::steady_clock::now();
+}
+
+/// Finishes measuring the innermost call.
+/// Does nothing if there is no such call,
+/// which happens if profiling was restarted during a call.
+void profileExit() noexcept {
+    const auto now = std::chrono::steady_clock::now();
+    if (profileStack.empty()) {
+        return;
+    }
+    ProfileFrame& frame = profileStack.back();
+    ProfileEntry& entry = *(frame.entry);
+    const double seconds = std::chrono::duration<double>(now - frame.start).count();
+    const unsigned long long bytes = profiledBytesOfCalls() - frame.startBytes;
+    const double exclusiveSeconds = seconds - frame.childSeconds;
+    entry.exclusiveSeconds += exclusiveSeconds;
+    entry.exclusiveBytes += bytes - frame.childBytes;
+    if (--(entry.active) == 0) {
+        // the outermost call to this symbol
+        entry.inclusiveSeconds += seconds;
+        entry.inclusiveBytes += bytes;
+    }
+    profileNodes[frame.node].microseconds += exclusiveSeconds * 1e6;
+    profileStack.pop_back();
+    if (!profileStack.empty()) {
+        profileStack.back().childSeconds += seconds;
+        profileStack.back().childBytes += bytes;
+    }
+}
+
+/// Discards everything measured so far, and starts measuring.
+/// Call between user inputs.
+void startProfiling() {
+    profileTable.clear();
+    profileNames.clear();
+    profileStack.clear();
+    profileChildren.clear();
+    // the storage is given back, rather than kept for the next run
+    std::vector<ProfileNode,AccountedAllocator<ProfileNode> >().swap(profileNodes);
+    ProfileNode root;
+    root.parent = 0;
+    root.symbol = 0;
+    root.microseconds = 0;
+    profileNodes.push_back(root);
+    profiledBytes = 0;
+    profilerBytes = 0;
+    profilingEnabled = true;
+}
+
+/// Stops measuring. What was measured is kept.
+void stopProfiling() noexcept {
+    profilingEnabled = false;
+}
+
+/// Writes one line per symbol, most exclusive time first.
+/// Times are in milliseconds.
+/// @param output where the table is written
+void writeProfileTable(std::ostream& output) {
+    std::vector< std::pair<std::string,ProfileEntry> > rows;
+    for (auto it = profileTable.begin(); it != profileTable.end(); ++it) {
+        rows.push_back(std::make_pair(std::string(it->first.c_str(),it->first.size()),it->second));
+    }
+    std::sort(rows.begin(),rows.end(),[](const std::pair<std::string,ProfileEntry>& a, const std::pair<std::string,ProfileEntry>& b) {
+        return a.second.exclusiveSeconds > b.second.exclusiveSeconds;
+    });
+    output << std::left << std::setw(24) << "symbol" << std::right
+        << std::setw(12) << "calls"
+        << std::setw(14) << "incl ms"
+        << std::setw(14) << "excl ms"
+        << std::setw(16) << "incl bytes"
+        << std::setw(16) << "excl bytes" << '\n';
+    output << std::fixed << std::setprecision(3);
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        const ProfileEntry& entry = it->second;
+        output << std::left << std::setw(24) << it->first << std::right
+            << std::setw(12) << entry.calls
+            << std::setw(14) << entry.inclusiveSeconds * 1e3
+            << std::setw(14) << entry.exclusiveSeconds * 1e3
+            << std::setw(16) << entry.inclusiveBytes
+            << std::setw(16) << entry.exclusiveBytes << '\n';
+    }
+}
+
+/// Writes one line per distinct call stack, in the folded
+/// format read by flame graph tools: names separated by ';',
+/// then the exclusive time in microseconds.
+/// The stacks are in the order they were first entered.
+/// Each line is built from profileNodes as it is written,
+/// so only one is held in memory at a time.
+/// @param output where the stacks are written
+void writeFoldedStacks(std::ostream& output) {
+    std::vector<uint_least32_t> path;
+    for (uint_least32_t i = 1; i < profileNodes.size(); ++i) {
+        path.clear();
+        for (uint_least32_t node = i; node != 0; node = profileNodes[node].parent) {
+            path.push_back(node);
+        }
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            if (it != path.rbegin()) {
+                output << ';';
+            }
+            const mtstring& name = *(profileNames[profileNodes[*it].symbol]);
+            output.write(name.c_str(),name.size());
+        }
+        output << ' ' << (unsigned long long)(profileNodes[i].microseconds + 0.5) << '\n';
+    }
+}
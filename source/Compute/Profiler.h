@@ -0,0 +1,52 @@
+/**
+ * @file Profiler.h
+ * @author Aaron Stanek
+ * @brief Functions for measuring the time
+ * and memory used by each symbol
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include <ostream>
+
+void profileEnter(const mtstring&, const uint_least32_t);
+
+void profileExit() noexcept;
+
+void startProfiling();
+
+void stopProfiling() noexcept;
+
+void writeProfileTable(std::ostream&);
+
+void writeFoldedStacks(std::ostream&);
+
+/// Measures a call for as long as this object exists,
+/// if profilingEnabled was true when it was created.
+struct ProfileScope {
+    const bool active;
+    /// @param baseName the basename of the called symbol
+    /// @param argumentCount the number of arguments passed
+    inline ProfileScope(const mtstring& baseName, const uint_least32_t argumentCount) : active(profilingEnabled) {
+        if (active) {
+            profileEnter(baseName,argumentCount);
+        }
+    };
+    inline ~ProfileScope() noexcept {
+        if (active) {
+            profileExit();
+        }
+    };
+};
+
+/// Closes the calls that evaluateExpression opened
+/// one after another, when it returns.
+struct ProfileScopes {
+    long count;
+    inline ProfileScopes() noexcept : count(0) {};
+    inline ~ProfileScopes() noexcept {
+        for (; count > 0; --count) {
+            profileExit();
+        }
+    };
+};
@@ -0,0 +1,289 @@
+/**
+ * @file Reactive.cpp
+ * @author Aaron Stanek
+*/
+#include "Reactive.h"
+#include "Memoize.h"
+#include <algorithm>
+#include <new>
+#include <unordered_map>
+#include <unordered_set>
+
+/// Every user-defined overload that has been placed,
+/// keyed by exact name. Nodes never move or get erased.
+std::unordered_map<mtstring,ReactiveNode> reactiveNodes;
+
+/// The nodes whose definitions call each basename.
+std::unordered_map< mtstring, std::vector<ReactiveNode*> > reactiveDependents;
+
+/// False once the graph failed to record a definition.
+/// Values are never cached after that,
+/// because a missing edge could leave one stale.
+bool reactiveGraphIntact = true;
+
+/// Incremented by every marking pass.
+unsigned long reactiveVisit = 0;
+
+/// Forgets every cached value.
+void invalidateAllNodes() noexcept {
+    for (auto it = reactiveNodes.begin(); it != reactiveNodes.end(); ++it) {
+        it->second.cached = false;
+        it->second.value.putNone();
+    }
+}
+
+/// Removes the edges from the dependencies of node to node.
+/// @param node the node to detach
+void detachDependencies(ReactiveNode& node) noexcept {
+    for (auto it = node.dependencies.begin(); it != node.dependencies.end(); ++it) {
+        const auto found = reactiveDependents.find(*it);
+        if (found == reactiveDependents.end()) {
+            continue;
+        }
+        std::vector<ReactiveNode*>& dependents = found->second;
+        dependents.erase(std::remove(dependents.begin(),dependents.end(),&node),dependents.end());
+        if (dependents.empty()) {
+            reactiveDependents.erase(found);
+        }
+    }
+    node.dependencies.clear();
+}
+
+/// Finds every basename called by x, including names
+/// passed as written, which a delayed argument may call.
+/// Local variable names are included too, which
+/// only makes the graph mark a little more than it must.
+/// @param names where the basenames are recorded
+/// @param x a function body
+void collectCalledNames(std::unordered_set<mtstring>& names, const ManyType& x) {
+    std::vector<const ManyType*> pending(1,&x);
+    while (!pending.empty()) {
+        const ManyType& element = *(pending.back());
+        pending.pop_back();
+        if (element.type() == ManyTypeLabel::StructureString) {
+            names.insert(element.getStructureString());
+        }
+        else if ((ManyTypeLabelInt)(element.type()) & (ManyTypeLabelInt)(ManyTypeLabel::Vector)) {
+            const bool isCall = (element.type() == ManyTypeLabel::StructureVector);
+            const mtvec& vec = isCall ? element.getStructureVector() : element.getDataVector();
+            // the first element of a DataVector is its data type
+            for (size_t i = isCall ? 0 : 1; i < vec.size(); ++i) {
+                pending.push_back(&(vec[i]));
+            }
+        }
+    }
+}
+
+/// Records what the new definition of a user-defined
+/// overload calls, replacing what the old one called.
+/// Called by placeUserSymbol for every definition,
+/// whether reactive mode is on or not, so that the
+/// graph is complete when it is turned on.
+/// If the graph can't be updated within maximumMemory,
+/// values are not cached anymore.
+/// @param user the new definition, its reactive field is set
+/// @param exactName the exact name of the overload
+/// @param baseName the basename of the overload
+void recordDefinition(UserSymbol& user, const mtstring& exactName, const mtstring& baseName) noexcept {
+    user.reactive = nullptr;
+    try {
+        ReactiveNode& node = reactiveNodes[exactName];
+        if (node.baseName.empty()) {
+            node.baseName = baseName;
+            node.visit = 0;
+        }
+        detachDependencies(node);
+        node.serial = user.serial;
+        node.cached = false;
+        node.value.putNone();
+        node.derived = false;
+        if (user.definition.type() == ManyTypeLabel::StructureVector) {
+            const mtvec& definitionVec = user.definition.getStructureVector();
+            std::unordered_set<mtstring> names;
+            collectCalledNames(names,definitionVec[0]);
+            node.dependencies.reserve(names.size());
+            for (auto it = names.begin(); it != names.end(); ++it) {
+                reactiveDependents[*it].push_back(&node);
+                // only recorded once the edge exists
+                node.dependencies.push_back(*it);
+            }
+            node.derived = (definitionVec.size() == 1);
+        }
+        user.reactive = &node;
+    }
+    catch (...) {
+        reactiveGraphIntact = false;
+        invalidateAllNodes();
+    }
+}
+
+/// Detaches a user-defined overload that is being removed.
+/// Its node is kept, see ReactiveNode.
+/// @param exactName the exact name of the overload
+void forgetDefinition(const mtstring& exactName) noexcept {
+    const auto it = reactiveNodes.find(exactName);
+    if (it == reactiveNodes.end()) {
+        return;
+    }
+    ReactiveNode& node = it->second;
+    detachDependencies(node);
+    node.cached = false;
+    node.value.putNone();
+    node.derived = false;
+}
+
+/// Forgets the cached values of everything that
+/// depends on baseName, directly or through other symbols.
+/// A derived variable that is already dirty is not passed
+/// through, because what depends on it is dirty too:
+/// storeReactiveValue only caches a value if every derived
+/// variable it depends on, through any number of functions,
+/// was cached, and a derived variable only becomes dirty
+/// when it is passed through or redefined.
+/// Other nodes keep no value of their own, so they are
+/// always passed through.
+/// Nothing is recomputed here. Derived variables are
+/// recomputed when they are next read, after the
+/// derived variables they read, which is topological order.
+/// @param baseName the basename that was redefined or removed
+void markDependentsDirty(const mtstring& baseName) noexcept {
+    try {
+        ++reactiveVisit;
+        std::vector<const mtstring*> pending(1,&baseName);
+        while (!pending.empty()) {
+            const auto it = reactiveDependents.find(*(pending.back()));
+            pending.pop_back();
+            if (it == reactiveDependents.end()) {
+                continue;
+            }
+            const std::vector<ReactiveNode*>& dependents = it->second;
+            for (auto jt = dependents.begin(); jt != dependents.end(); ++jt) {
+                ReactiveNode& node = **jt;
+                if (node.visit == reactiveVisit) {
+                    continue;
+                }
+                node.visit = reactiveVisit;
+                if (node.derived && !node.cached) {
+                    continue;
+                }
+                node.cached = false;
+                node.value.putNone();
+                pending.push_back(&(node.baseName));
+            }
+        }
+    }
+    catch (...) {
+        // too much to mark within maximumMemory
+        invalidateAllNodes();
+    }
+}
+
+/// Turns reactive mode on or off.
+/// Turning it off frees the cached values.
+/// The graph is kept either way.
+/// @param enabled true to cache the values of derived variables
+void setReactiveMode(const bool enabled) noexcept {
+    reactiveEnabled = enabled;
+    if (!enabled) {
+        invalidateAllNodes();
+    }
+}
+
+/// Reads the cached value of a derived variable.
+/// @param ret where the value will be placed, if it is cached
+/// @param user the derived variable, hasReactiveValue(user) must be true
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if the value must be computed
+bool readReactiveValue(ManyType& ret, const UserSymbol& user, long recursionJuice) {
+    // worker threads may be reading it too
+    std::lock_guard<std::mutex> lock(memoMutex);
+    const ReactiveNode& node = *(user.reactive);
+    if (!node.cached || node.serial != user.serial) {
+        return false;
+    }
+    ret.makeCopyFrom(node.value,recursionJuice);
+    return true;
+}
+
+/// @param user a derived variable
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return true if everything user calls is pure,
+/// and the derived variables it reads are cached,
+/// whether it reads them directly or through functions,
+/// so that the marking of the graph covers everything
+/// the value of user depends on
+bool dependenciesAreCached(const UserSymbol& user, long recursionJuice) {
+    try {
+        // the functions whose dependencies are still to be checked
+        std::vector<const UserSymbol*> pending(1,&user);
+        std::unordered_set<const UserSymbol*> seen;
+        seen.insert(&user);
+        while (!pending.empty()) {
+            const std::vector<MemoDependency>& dependencies = pending.back()->memo->dependencies;
+            pending.pop_back();
+            for (auto it = dependencies.begin(); it != dependencies.end(); ++it) {
+                const SymbolTableElement* const element = findSymbol(it->baseName,it->argCount);
+                if (element == nullptr) {
+                    return false;
+                }
+                if (!element->builtIn) {
+                    const UserSymbol& callee = *(element->value.user);
+                    if (hasReactiveValue(callee)) {
+                        // its own value was only cached
+                        // if what it depends on was
+                        std::lock_guard<std::mutex> lock(memoMutex);
+                        if (!callee.reactive->cached || callee.reactive->serial != callee.serial) {
+                            return false;
+                        }
+                        continue;
+                    }
+                }
+                // a built-in symbol, variable, or function
+                if (!symbolIsPure(*element,it->baseName,it->argCount,recursionJuice)) {
+                    return false;
+                }
+                if (!element->builtIn && element->value.user->memo && seen.insert(element->value.user).second) {
+                    // a function, it may read derived variables too
+                    pending.push_back(element->value.user);
+                }
+            }
+        }
+    }
+    catch (std::bad_alloc&) {
+        return false;
+    }
+    catch (UserAlert&) {
+        // recordAllocation ran out
+        return false;
+    }
+    return true;
+}
+
+/// Caches the value of a derived variable,
+/// if it can be kept until the graph marks it dirty.
+/// If the value can not be copied within maximumMemory,
+/// it is not cached.
+/// @param user the derived variable, hasReactiveValue(user) must be true
+/// @param value the value just computed, a DataExpression
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void storeReactiveValue(const UserSymbol& user, const ManyType& value, long recursionJuice) {
+    if (!reactiveGraphIntact || !dependenciesAreCached(user,recursionJuice)) {
+        return;
+    }
+    ManyType copy;
+    try {
+        copy.makeCopyFrom(value,recursionJuice);
+    }
+    catch (UserAlert&) {
+        // caching it is not worth failing over
+        return;
+    }
+    std::lock_guard<std::mutex> lock(memoMutex);
+    ReactiveNode& node = *(user.reactive);
+    if (node.serial != user.serial) {
+        // redefined while it was computed
+        return;
+    }
+    node.value = copy;
+    node.cached = true;
+}
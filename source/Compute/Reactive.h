@@ -0,0 +1,57 @@
+/**
+ * @file Reactive.h
+ * @author Aaron Stanek
+ * @brief A graph of which user-defined symbols
+ * call which, so that the values of derived
+ * variables can be kept until something they
+ * depend on is redefined
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "../Symbols/Symbols.h"
+#include <vector>
+
+/// One user-defined overload in the dependency graph.
+/// Kept after the symbol is removed, so that a
+/// UserSymbol that is still running can point to it.
+struct ReactiveNode {
+    /// The basename of the symbol.
+    /// Redefining any overload of it marks the dependents dirty.
+    mtstring baseName;
+    /// The basenames called by the current definition,
+    /// without repeats.
+    std::vector<mtstring> dependencies;
+    /// The UserSymbol::serial of the current definition.
+    unsigned long serial;
+    /// True if the current definition is a derived variable,
+    /// a symbol with no arguments defined by an expression.
+    /// Only derived variables keep a value.
+    bool derived;
+    /// True if value holds the value of the current definition.
+    /// A derived variable that is not cached is dirty.
+    bool cached;
+    /// The value of the current definition, if cached is true.
+    ManyType value;
+    /// Used to visit each node once while marking.
+    unsigned long visit;
+};
+
+/// @param user a user-defined symbol
+/// @return true if reactive mode is on and the value
+/// of user should be read with readReactiveValue
+inline bool hasReactiveValue(const UserSymbol& user) noexcept {
+    return reactiveEnabled && user.reactive && user.memo && user.reactive->derived;
+}
+
+void recordDefinition(UserSymbol&, const mtstring&, const mtstring&) noexcept;
+
+void forgetDefinition(const mtstring&) noexcept;
+
+void markDependentsDirty(const mtstring&) noexcept;
+
+void setReactiveMode(const bool) noexcept;
+
+bool readReactiveValue(ManyType&, const UserSymbol&, long);
+
+void storeReactiveValue(const UserSymbol&, const ManyType&, long);
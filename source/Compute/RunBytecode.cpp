@@ -0,0 +1,484 @@
+/**
+ * @file RunBytecode.cpp
+ * @author Aaron Stanek
+*/
+#include "RunBytecode.h"
+#include "EvaluateExpression.h"
+#include "EvaluateConstExpression.h"
+#include "WorkStealingPool.h"
+#include "Profiler.h"
+#include "Memoize.h"
+#include "Reactive.h"
+#include "InferTypes.h"
+#include "../Bindings/Bindings.h"
+#include "../LowLevelConvert/LowLevelConvert.h"
+#include "../Globals/Trace.h"
+
+/// Looks up the symbol called by a CallSite.
+/// Reuses the previous lookup if symbolTable
+/// has not gained or lost any entries since.
+/// The lookup is not saved while worker threads
+/// are running, since they may be reading the same CallSite.
+/// @param site the CallSite to resolve
+/// @return a reference to a value in the built-in table or in symbolTable
+/// @throw UserAlert if there is no match
+const SymbolTableElement& resolveCallSite(CallSite& site) {
+    if (site.element == nullptr || site.generation != symbolTableGeneration) {
+        const SymbolTableElement& element = readSymbol(site.baseName,site.argCount);
+        if (parallelBatchesRunning.load(std::memory_order_relaxed) == 0) {
+            site.element = &element;
+            site.generation = symbolTableGeneration;
+        }
+        return element;
+    }
+    return *(site.element);
+}
+
+/// @param symbol the symbol being called
+/// @param argumentCount the number of arguments being passed
+/// @return true if symbol delays any of the arguments,
+/// or takes any of them lazily
+inline bool delaysArguments(const SymbolTableElement& symbol, const uint_least32_t argumentCount) noexcept {
+    if (!symbol.builtIn && !symbol.value.user->lazyParameters.empty()) {
+        return true;
+    }
+    if (argumentCount >= 8) {
+        return symbol.delayMask != 0;
+    }
+    return (symbol.delayMask & ((1 << argumentCount) - 1)) != 0;
+}
+
+/// @param user a user-defined symbol
+/// @return true if calls to user run in a BytecodeFrame,
+/// rather than through callSymbol
+inline bool runsInFrame(const UserSymbol& user) noexcept {
+    return user.compiled && user.native.load(std::memory_order_acquire) == nullptr && !hasReactiveValue(user);
+}
+
+/// Moves the top values of the stack into callVec.
+/// @param stack the stack of the running function
+/// @param callVec will be set to [None,args...]
+/// @param argumentCount the number of values to move
+void popArguments(mtvec& stack, mtvec& callVec, const uint_least32_t argumentCount) {
+    callVec.resize(argumentCount + 1);
+    const uint_least32_t base = stack.size() - argumentCount;
+    for (uint_least32_t i = 0; i < argumentCount; ++i) {
+        callVec[i+1] = stack[base+i];
+    }
+    // the stack now holds whatever callVec held before
+    stack.resize(base);
+}
+
+/// Calls the built-in function of a CallSite
+/// with the top values of the stack, and replaces them with the result.
+/// @param stack the stack of the running function
+/// @param callVec storage for the arguments
+/// @param site the CallSite of a CallBuiltIn
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void callBuiltInSite(mtvec& stack, mtvec& callVec, const CallSite& site, long recursionJuice) {
+    popArguments(stack,callVec,site.argumentCount);
+    checkProcessingTime();
+    stack.resize(stack.size() + 1);
+    const ProfileScope scope(site.baseName,site.argumentCount);
+    const TraceScope traceScope(TraceEventKind::Call,site.baseName.data(),site.baseName.size(),site.argumentCount);
+    site.element->value.func(stack.back(),callVec,recursionJuice);
+    if (!( (ManyTypeLabelInt)(stack.back().type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression) )) {
+        evaluateExpression(stack.back(),recursionJuice);
+    }
+}
+
+/// Counts a call made by a CallBuiltIn, and once it has
+/// run QUICKEN_AFTER_CALLS times, rewrites it to a CallQuickened
+/// specialized for the types of the arguments it is about to be called with.
+/// Each attempt counts towards MAX_QUICKENINGS, so calls that have
+/// no specialized form, or whose types keep changing, stop trying.
+/// Must not be called while worker threads are running,
+/// since they may be running the same code.
+/// @param instruction the CallBuiltIn
+/// @param site its CallSite
+/// @param stack the stack of the running function, holding the arguments
+void quickenCallSite(Instruction& instruction, CallSite& site, const mtvec& stack) noexcept {
+    if (site.quickenings >= MAX_QUICKENINGS || ++(site.calls) < QUICKEN_AFTER_CALLS) {
+        return;
+    }
+    site.calls = 0;
+    ++(site.quickenings);
+    // only calls of one or two arguments are specialized
+    if (site.argumentCount < 1 || site.argumentCount > 2) {
+        return;
+    }
+    ManyTypeLabel labels[2];
+    for (uint_least32_t i = 0; i < site.argumentCount; ++i) {
+        labels[i] = stack[stack.size() - site.argumentCount + i].type();
+    }
+    site.quickened = quickenBuiltIn(site.element->value.func,labels,site.argumentCount);
+    if (site.quickened) {
+        instruction.opcode = Opcode::CallQuickened;
+    }
+}
+
+/// The state of one running compiled function.
+/// Calls between compiled functions push a BytecodeFrame
+/// instead of recursing, so deep recursion is limited by
+/// maximumRecursionDepth and maximumMemory rather than by
+/// the size of the thread's stack.
+struct BytecodeFrame {
+    /// The running function, held while the frame is in use.
+    UserSymbol* user;
+    /// The function call, [function_name,args...].
+    mtvec arguments;
+    mtvec stack;
+    /// The values of common sub-expressions.
+    mtvec locals;
+    std::vector<bool> stored;
+    /// The index of the next instruction,
+    /// saved while a call made by this frame runs.
+    uint_least32_t pc;
+    long recursionJuice;
+    /// Where the result is remembered when the frame
+    /// returns, or nullptr if it is not remembered.
+    MemoTable* memo;
+    MemoKey key;
+    /// True if profileEnter was called for this frame.
+    bool profiled;
+    /// True if a Call was traced for this frame.
+    bool traced;
+};
+
+/// The frames of one call to runBytecode.
+/// Frames above depth are kept after they return,
+/// so that the next call at that depth reuses their storage.
+struct BytecodeFrames {
+    std::vector<BytecodeFrame,AccountedAllocator<BytecodeFrame> > frames;
+    /// The number of frames in use.
+    size_t depth;
+    BytecodeFrames() : depth(0) {};
+    ~BytecodeFrames() noexcept;
+    /// @return the innermost frame in use
+    inline BytecodeFrame& top() noexcept {
+        return frames[depth-1];
+    };
+};
+
+/// Starts running a compiled function in a new frame.
+/// @param frames where the frame is pushed, references
+/// into frames.frames are no longer valid afterwards
+/// @param user the function to run, user.compiled must not be nullptr
+/// @param recursionJuice how many layers of recursion may be used by the call
+/// @throw UserAlert if recursionJuice or maximumMemory run out,
+/// in which case no frame is pushed
+void pushFrame(BytecodeFrames& frames, UserSymbol& user, const long recursionJuice) {
+    if (recursionJuice <= 0) {
+        throw UserAlert(UserMessage::MaximumRecursionDepthReached,nullptr);
+    }
+    if (frames.depth == frames.frames.size()) {
+        frames.frames.resize(frames.depth + 1);
+    }
+    BytecodeFrame& frame = frames.frames[frames.depth];
+    const CompiledFunction& compiled = *(user.compiled);
+    frame.stack.reserve(compiled.maximumStackSize);
+    frame.locals.resize(compiled.localSources.size());
+    frame.stored.assign(compiled.localSources.size(),false);
+    frame.pc = 0;
+    frame.recursionJuice = recursionJuice - 1;
+    frame.memo = nullptr;
+    frame.profiled = false;
+    frame.traced = false;
+    // nothing below can fail
+    frame.user = &user;
+    ++(user.useCount);
+    ++(frames.depth);
+}
+
+/// Replaces the function running in the innermost frame,
+/// for a tail call. The frame keeps its memo, profiler entry and traced call,
+/// so the call that started the chain gets the final result.
+/// @param frames holds the frame to reuse
+/// @param user the function to run, user.compiled must not be nullptr
+/// @param callVec the arguments of the tail call, they will be taken
+/// @throw UserAlert if maximumMemory is reached,
+/// in which case the frame is unchanged
+void replaceFrame(BytecodeFrames& frames, UserSymbol& user, mtvec& callVec) {
+    BytecodeFrame& frame = frames.top();
+    const CompiledFunction& compiled = *(user.compiled);
+    frame.locals.clear();
+    frame.locals.resize(compiled.localSources.size());
+    frame.stored.assign(compiled.localSources.size(),false);
+    frame.stack.reserve(compiled.maximumStackSize);
+    // nothing below can fail
+    frame.stack.clear();
+    frame.arguments.swap(callVec);
+    frame.pc = 0;
+    ++(user.useCount);
+    // the old function may be deleted here,
+    // nothing refers to its code anymore
+    releaseUserSymbol(frame.user);
+    frame.user = &user;
+}
+
+/// Stops using the innermost frame.
+/// Its values are freed, but its storage is kept.
+/// @param frames holds the frame to pop
+void popFrame(BytecodeFrames& frames) noexcept {
+    BytecodeFrame& frame = frames.top();
+    if (frame.profiled) {
+        profileExit();
+    }
+    if (frame.traced) {
+        traceExit();
+    }
+    frame.arguments.clear();
+    frame.stack.clear();
+    frame.locals.clear();
+    frame.key.arguments.clear();
+    releaseUserSymbol(frame.user);
+    --(frames.depth);
+}
+
+/// Specializes the function running in the innermost frame
+/// for the types of its arguments, if this is its first call.
+/// @param frames holds the frame, its arguments must be in place
+inline void specializeFrame(BytecodeFrames& frames) noexcept {
+    BytecodeFrame& frame = frames.top();
+    if (!frame.user->compiled->specialized && parallelBatchesRunning.load(std::memory_order_relaxed) == 0) {
+        specializeCompiledFunction(*(frame.user),frame.arguments,frame.recursionJuice);
+    }
+}
+
+/// Pops the frames that are still in use,
+/// which happens if a call fails.
+BytecodeFrames::~BytecodeFrames() noexcept {
+    while (depth > 0) {
+        popFrame(*this);
+    }
+}
+
+/// Finishes the innermost frame, and passes its
+/// result to the frame below it.
+/// @param frames holds the frames, there must be at least two
+/// @param result the result of the innermost frame, it will be taken
+void returnFromFrame(BytecodeFrames& frames, ManyType& result) {
+    BytecodeFrame& frame = frames.top();
+    if (frame.memo) {
+        rememberResult(*(frame.memo),frame.key,result,frame.recursionJuice);
+    }
+    popFrame(frames);
+    BytecodeFrame& caller = frames.top();
+    caller.stack.resize(caller.stack.size() + 1);
+    caller.stack.back() = result;
+    // continue after the CallSymbol
+    ++(caller.pc);
+}
+
+/// Runs the compiled form of a user-defined function.
+/// Calls to other compiled functions run in the same loop,
+/// on frames kept on the heap, rather than recursing.
+/// If the function ends by calling a user-defined symbol,
+/// that call is left for the caller to make, so that
+/// chains of tail calls don't nest.
+/// @param ret where the result will be placed, it will be a DataExpression,
+/// unless a tail call is returned
+/// @param user the function to run, user.compiled must not be nullptr
+/// @param arguments the function call, [function_name,args...],
+/// all arguments must already be evaluated. They may be taken from it.
+/// If a tail call is returned, it holds the arguments of that call
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return the symbol of the tail call, or nullptr if ret was set
+const SymbolTableElement* runBytecode(ManyType& ret, UserSymbol& user, mtvec& arguments, long recursionJuice) {
+    BytecodeFrames frames;
+    pushFrame(frames,user,recursionJuice);
+    frames.top().arguments.swap(arguments);
+    specializeFrame(frames);
+    // holds the arguments of each call
+    // callVec[0] is never set
+    mtvec callVec;
+    while (true) {
+        // a call or return changes the innermost frame,
+        // and may move the frames, so this is set again after each
+        BytecodeFrame& frame = frames.top();
+        CompiledFunction& compiled = *(frame.user->compiled);
+        mtvec& stack = frame.stack;
+        mtvec& locals = frame.locals;
+        const long juice = frame.recursionJuice;
+        bool switching = false;
+        for (uint_least32_t pc = frame.pc; !switching; ++pc) {
+            const Instruction& instruction = compiled.code[pc];
+            switch (instruction.opcode) {
+                case Opcode::PushConstant:
+                    stack.resize(stack.size() + 1);
+                    stack.back().makeCopyFrom(compiled.constants[instruction.operand],juice);
+                    break;
+                case Opcode::PushArgument:
+                    forceArgument(frame.arguments[instruction.operand],juice);
+                    stack.resize(stack.size() + 1);
+                    stack.back().makeCopyFrom(frame.arguments[instruction.operand],juice);
+                    break;
+                case Opcode::MoveArgument:
+                    forceArgument(frame.arguments[instruction.operand],juice);
+                    stack.resize(stack.size() + 1);
+                    stack.back() = frame.arguments[instruction.operand];
+                    break;
+                case Opcode::StoreLocal:
+                    locals[instruction.operand].makeCopyFrom(stack.back(),juice);
+                    frame.stored[instruction.operand] = true;
+                    break;
+                case Opcode::PushLocal:
+                    if (!frame.stored[instruction.operand]) {
+                        // the first appearance was evaluated the slow way
+                        // it only calls pure built-in functions,
+                        // so evaluating it now gives the same value
+                        Frame slow(frame.arguments);
+                        evaluateInFrame(locals[instruction.operand],*(compiled.localSources[instruction.operand]),compiled.localParameters[instruction.operand],&slow,juice);
+                        frame.stored[instruction.operand] = true;
+                    }
+                    stack.resize(stack.size() + 1);
+                    stack.back().makeCopyFrom(locals[instruction.operand],juice);
+                    break;
+                case Opcode::CallBuiltIn: {
+                    CallSite& site = compiled.callSites[instruction.operand];
+                    if (parallelBatchesRunning.load(std::memory_order_relaxed) == 0) {
+                        quickenCallSite(compiled.code[pc],site,stack);
+                    }
+                    callBuiltInSite(stack,callVec,site,juice);
+                    break;
+                }
+                case Opcode::CallQuickened: {
+                    CallSite& site = compiled.callSites[instruction.operand];
+                    // the profiler and the trace see every call,
+                    // which only the generic path records
+                    if (!profilingEnabled && !tracingEnabled) {
+                        checkProcessingTime();
+                        const uint_least32_t base = stack.size() - site.argumentCount;
+                        if (site.quickened(&(stack[base]))) {
+                            stack.resize(base + 1);
+                            break;
+                        }
+                        if (parallelBatchesRunning.load(std::memory_order_relaxed) == 0) {
+                            // the types have changed
+                            // count calls again before specializing for the new ones
+                            compiled.code[pc].opcode = Opcode::CallBuiltIn;
+                            site.quickened = nullptr;
+                        }
+                    }
+                    callBuiltInSite(stack,callVec,site,juice);
+                    break;
+                }
+                case Opcode::ResolveSymbol: {
+                    CallSite& site = compiled.callSites[instruction.operand];
+                    const SymbolTableElement& symbol = resolveCallSite(site);
+                    if (delaysArguments(symbol,site.argumentCount)) {
+                        // the arguments must be passed as written
+                        // so evaluate the whole call from the function body
+                        Frame slow(frame.arguments);
+                        if (!symbol.builtIn && frames.depth == 1 && compiled.code[site.skip].opcode == Opcode::Return) {
+                            // a tail call, the caller of runBytecode makes it
+                            // as it would for runInFrame
+                            const SymbolTableElement& next = prepareCall(callVec,*(site.source),site.parameters,&slow,juice);
+                            arguments.swap(callVec);
+                            return &next;
+                        }
+                        stack.resize(stack.size() + 1);
+                        evaluateInFrame(stack.back(),*(site.source),site.parameters,&slow,juice);
+                        // continue after the CallSymbol
+                        pc = site.skip - 1;
+                    }
+                    break;
+                }
+                case Opcode::CallSymbol: {
+                    CallSite& site = compiled.callSites[instruction.operand];
+                    // evaluating the arguments may have changed symbolTable
+                    // in which case this will look the symbol up again
+                    const SymbolTableElement& symbol = resolveCallSite(site);
+                    popArguments(stack,callVec,site.argumentCount);
+                    checkProcessingTime();
+                    UserSymbol* const callee = symbol.builtIn ? nullptr : symbol.value.user;
+                    if (callee && compiled.code[pc+1].opcode == Opcode::Return) {
+                        // a tail call
+                        if (frames.depth == 1) {
+                            // the caller of runBytecode makes it
+                            arguments.swap(callVec);
+                            return &symbol;
+                        }
+                        if (runsInFrame(*callee)) {
+                            // checkProcessingTime was called above
+                            replaceFrame(frames,*callee,callVec);
+                            specializeFrame(frames);
+                            switching = true;
+                            break;
+                        }
+                        // otherwise it is made like any other call
+                    }
+                    if (callee && runsInFrame(*callee)) {
+                        // run it in a new frame
+                        MemoKey key;
+                        MemoLookup found = MemoLookup::Unusable;
+                        if (callee->memo && maximumMemoizedResults > 0) {
+                            stack.resize(stack.size() + 1);
+                            found = lookUpMemoizedResult(stack.back(),*(callee->memo),key,callVec,juice);
+                            if (found == MemoLookup::Found) {
+                                break;
+                            }
+                            stack.pop_back();
+                        }
+                        frame.pc = pc;
+                        pushFrame(frames,*callee,juice);
+                        // frame may have moved
+                        BytecodeFrame& next = frames.top();
+                        next.arguments.swap(callVec);
+                        specializeFrame(frames);
+                        if (found == MemoLookup::Missing) {
+                            next.memo = callee->memo;
+                            next.key.hash = key.hash;
+                            next.key.arguments.swap(key.arguments);
+                        }
+                        if (profilingEnabled) {
+                            profileEnter(site.baseName,site.argumentCount);
+                            next.profiled = true;
+                        }
+                        if (tracingEnabled) {
+                            next.traced = traceSymbol(TraceEventKind::Call,site.baseName.data(),site.baseName.size(),site.argumentCount);
+                        }
+                        switching = true;
+                        break;
+                    }
+                    stack.resize(stack.size() + 1);
+                    ManyType& result = stack.back();
+                    const ProfileScope scope(site.baseName,site.argumentCount);
+                    const TraceScope traceScope(TraceEventKind::Call,site.baseName.data(),site.baseName.size(),site.argumentCount);
+                    callSymbol(result,symbol,callVec,juice);
+                    if (!( (ManyTypeLabelInt)(result.type()) & (ManyTypeLabelInt)(ManyTypeLabel::DataExpression) )) {
+                        evaluateExpression(result,juice);
+                    }
+                    break;
+                }
+                case Opcode::Jump:
+                    pc = instruction.operand - 1;
+                    break;
+                case Opcode::JumpIfFalse: {
+                    convertToBool(stack.back());
+                    const bool condition = stack.back().getBool();
+                    stack.pop_back();
+                    if (!condition) {
+                        pc = instruction.operand - 1;
+                    }
+                    break;
+                }
+                case Opcode::ConvertToBool:
+                    convertToBool(stack.back());
+                    break;
+                default: {
+                    // Opcode::Return
+                    if (frames.depth == 1) {
+                        ret = stack.back();
+                        return nullptr;
+                    }
+                    ManyType result;
+                    result = stack.back();
+                    returnFromFrame(frames,result);
+                    switching = true;
+                    break;
+                }
+            }
+        }
+    }
+}
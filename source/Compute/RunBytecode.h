@@ -0,0 +1,13 @@
+/**
+ * @file RunBytecode.h
+ * @author Aaron Stanek
+ * @brief Function for running
+ * a compiled user-defined function
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "../Symbols/Symbols.h"
+#include "Bytecode.h"
+
+const SymbolTableElement* runBytecode(ManyType&, UserSymbol&, mtvec&, long);
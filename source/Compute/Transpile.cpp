@@ -0,0 +1,630 @@
+/**
+ * @file Transpile.cpp
+ * @author Aaron Stanek
+*/
+#include "Transpile.h"
+#include "ParameterSlots.h"
+#include "Memoize.h"
+#include "../Bindings/Bindings.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/// The directory holding the headers that transpiled code includes.
+/// Set by the Makefile.
+#ifndef UCALC_SOURCE_DIRECTORY
+#define UCALC_SOURCE_DIRECTORY "source"
+#endif
+
+/// Changed whenever the generated code changes,
+/// so that cached libraries are not reused.
+#define NATIVE_GENERATOR_VERSION 3
+
+/// How transpiled code is compiled.
+#define NATIVE_COMPILER "g++ -std=c++11 -pthread -O2 -fno-rtti -fPIC -shared"
+
+/// The name of the function that every transpiled library exports.
+#define NATIVE_ENTRY_POINT "ucalcNativeEntry"
+
+/// How long to wait between checks of
+/// the processing time while the compiler runs.
+#define NATIVE_COMPILER_POLL_MICROSECONDS 10000
+
+/// A translation to C++ in progress.
+struct Transpilation {
+    /// The definition being translated.
+    const mtvec& definitionVec;
+    /// The symbol being translated, calls to it call the translation.
+    const mtstring& baseName;
+    const char argCount;
+    /// The statements of the function body.
+    std::string body;
+    /// Variables holding the built-in functions that are
+    /// called through nativeCall, found when the library is loaded.
+    std::string declarations;
+    /// The variable holding each built-in function,
+    /// keyed by its basename and argCount.
+    std::map<std::pair<std::string,char>,std::string> builtIns;
+    /// The recursive calls in tail position, which start
+    /// the function body again instead of nesting.
+    std::vector<const ManyType*> tailCalls;
+    /// The number of variables declared so far,
+    /// used to give each a new name.
+    uint_least32_t variables;
+    /// The number of blocks the next statement is inside of.
+    uint_least32_t depth;
+};
+
+/// Adds a statement to the function body.
+/// @param t the translation in progress
+/// @param statement the statement, without indentation
+void writeLine(Transpilation& t, const std::string& statement) {
+    t.body.append(4 * (t.depth + 1),' ');
+    t.body.append(statement);
+    t.body.push_back('\n');
+}
+
+/// @param t the translation in progress
+/// @return the name of a new variable
+std::string newVariable(Transpilation& t) {
+    return "v" + std::to_string(++(t.variables));
+}
+
+/// @param x a Float
+/// @return a C++ literal with the same value
+std::string floatLiteral(const ftype x) {
+    char buffer[64];
+    snprintf(buffer,sizeof(buffer),"%.*g",std::numeric_limits<ftype>::max_digits10,(double)(x));
+    std::string output(buffer);
+    if (output.find_first_of(".e") == std::string::npos) {
+        // keep it a floating point literal, -0 must stay -0.0
+        output.append(".0");
+    }
+    return "(ftype)(" + output + ")";
+}
+
+bool transpileExpression(Transpilation&, const ManyType&, const std::string&, long);
+
+/// Finds the recursive calls whose result is the result of the function,
+/// which are x itself and the branches of if in tail position.
+/// @param t the translation in progress, the calls are added to t.tailCalls
+/// @param x a function body element in tail position
+/// @param recursionJuice how many layers of recursion may be used by this operation
+void findTailCalls(Transpilation& t, const ManyType& x, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        // the calls that were not found nest instead
+        return;
+    }
+    else {
+        --recursionJuice;
+    }
+    if (findParameter(x,t.definitionVec)) {
+        return;
+    }
+    const bool isVector = (x.type() == ManyTypeLabel::StructureVector);
+    if (isVector ? (x.getStructureVector()[0].type() != ManyTypeLabel::StructureString || x.getStructureVector().size() > MAX_ARGS_DEF) : x.type() != ManyTypeLabel::StructureString) {
+        return;
+    }
+    const mtstring& baseName = isVector ? x.getStructureVector()[0].getStructureString() : x.getStructureString();
+    const char argCount = isVector ? (char)(x.getStructureVector().size() - 1) : 0;
+    const BuiltInSymbol* builtIn = readBuiltInSymbol(baseName,argCount);
+    if (builtIn == nullptr) {
+        if (readBuiltInSymbol(baseName,-1) == nullptr && baseName == t.baseName && argCount == t.argCount) {
+            t.tailCalls.push_back(&x);
+        }
+        return;
+    }
+    const boundFunction func = builtIn->element.value.func;
+    if (func == &if2_implement || func == &if3_implement) {
+        for (char i = 2; i <= argCount; ++i) {
+            findTailCalls(t,x.getStructureVector()[i],recursionJuice);
+        }
+    }
+}
+
+/// Writes statements that evaluate the arguments of a call into a new array.
+/// @param t the translation in progress
+/// @param vec the call, [function_name,args...]
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return the name of the array, or the empty string if an argument can't be translated
+std::string transpileArguments(Transpilation& t, const mtvec& vec, long recursionJuice) {
+    const uint_least32_t argumentCount = vec.size() - 1;
+    if (argumentCount == 0) {
+        return "nullptr";
+    }
+    const std::string arguments = newVariable(t);
+    writeLine(t,"ManyType " + arguments + "[" + std::to_string(argumentCount) + "];");
+    for (uint_least32_t i = 1; i <= argumentCount; ++i) {
+        if (!transpileExpression(t,vec[i],arguments + "[" + std::to_string(i-1) + "]",recursionJuice)) {
+            return std::string();
+        }
+    }
+    return arguments;
+}
+
+/// Writes statements for if, and, and or, which only
+/// evaluate the arguments that they need.
+/// @param t the translation in progress
+/// @param func the built-in function called
+/// @param vec the call, [function_name,args...]
+/// @param target the variable where the result is placed
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if func is not one of them,
+/// or an argument can't be translated
+bool transpileControl(Transpilation& t, const boundFunction func, const mtvec& vec, const std::string& target, long recursionJuice) {
+    const bool isIf = (func == &if2_implement || func == &if3_implement);
+    if (!isIf && func != &and_implement && func != &or_implement) {
+        return false;
+    }
+    const std::string condition = newVariable(t);
+    writeLine(t,"ManyType " + condition + ";");
+    if (!transpileExpression(t,vec[1],condition,recursionJuice)) {
+        return false;
+    }
+    if (func == &and_implement) {
+        writeLine(t,"if (!nativeCondition(" + condition + ")) {");
+        ++(t.depth);
+        writeLine(t,target + ".putBool(false);");
+    }
+    else if (func == &or_implement) {
+        writeLine(t,"if (nativeCondition(" + condition + ")) {");
+        ++(t.depth);
+        writeLine(t,target + ".putBool(true);");
+    }
+    else {
+        writeLine(t,"if (nativeCondition(" + condition + ")) {");
+        ++(t.depth);
+        if (!transpileExpression(t,vec[2],target,recursionJuice)) {
+            return false;
+        }
+    }
+    --(t.depth);
+    writeLine(t,"}");
+    writeLine(t,"else {");
+    ++(t.depth);
+    if (func == &if2_implement) {
+        writeLine(t,target + ".putNone();");
+    }
+    else if (!transpileExpression(t,vec[isIf ? 3 : 2],target,recursionJuice)) {
+        return false;
+    }
+    if (!isIf) {
+        writeLine(t,"convertToBool(" + target + ");");
+    }
+    --(t.depth);
+    writeLine(t,"}");
+    return true;
+}
+
+/// Writes statements for a call.
+/// Calls to the symbol being translated call the translation.
+/// Calls to built-in functions that don't delay their arguments
+/// are made directly, or through nativeCall.
+/// Other user-defined symbols can be redefined, so they are not translated.
+/// @param t the translation in progress
+/// @param x a StructureString or StructureVector
+/// @param target the variable where the result is placed
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if the call can't be translated
+bool transpileCall(Transpilation& t, const ManyType& x, const std::string& target, long recursionJuice) {
+    // a symbol name is treated as a function call
+    // with no arguments, as in evaluateExpression
+    ManyType wrapped;
+    if (x.type() == ManyTypeLabel::StructureString) {
+        wrapped.makeCopyFrom(x,recursionJuice);
+        wrapped.wrapInVector();
+    }
+    const mtvec& vec = (x.type() == ManyTypeLabel::StructureVector) ? x.getStructureVector() : wrapped.getStructureVector();
+    if (vec[0].type() != ManyTypeLabel::StructureString || vec.size() > MAX_ARGS_DEF) {
+        return false;
+    }
+    const mtstring& baseName = vec[0].getStructureString();
+    const char argCount = (char)(vec.size() - 1);
+    const BuiltInSymbol* builtIn = readBuiltInSymbol(baseName,argCount);
+    if (builtIn == nullptr) {
+        builtIn = readBuiltInSymbol(baseName,-1);
+    }
+    writeLine(t,"{");
+    ++(t.depth);
+    if (builtIn == nullptr) {
+        if (baseName != t.baseName || argCount != t.argCount) {
+            return false;
+        }
+        // a recursive call
+        const std::string arguments = transpileArguments(t,vec,recursionJuice);
+        if (arguments.empty()) {
+            return false;
+        }
+        if (std::find(t.tailCalls.begin(),t.tailCalls.end(),&x) != t.tailCalls.end()) {
+            // a tail call, which runs the body again with these arguments
+            // like a tail call in callUserSymbol, it is only
+            // limited by maximumProcessingTime
+            writeLine(t,"checkProcessingTime();");
+            for (char i = 0; i < t.argCount; ++i) {
+                writeLine(t,"arguments[" + std::to_string((int)(i)) + "] = " + arguments + "[" + std::to_string((int)(i)) + "];");
+            }
+            writeLine(t,"continue;");
+        }
+        else {
+            writeLine(t,"nativeBody(" + target + "," + arguments + ",recursionJuice,nativeDepth + 1);");
+        }
+    }
+    else {
+        const boundFunction func = builtIn->element.value.func;
+        const uint_least32_t argumentCount = vec.size() - 1;
+        if (transpileControl(t,func,vec,target,recursionJuice)) {
+            // nothing else to do
+        }
+        else if (argumentCount >= 8 ? builtIn->element.delayMask != 0 : (builtIn->element.delayMask & ((1 << argumentCount) - 1)) != 0) {
+            // the arguments would be passed as written
+            return false;
+        }
+        else {
+            const std::string arguments = transpileArguments(t,vec,recursionJuice);
+            if (arguments.empty()) {
+                return false;
+            }
+            if (func == &add_implement && argumentCount == 2) {
+                writeLine(t,"nativeAdd(" + target + "," + arguments + ",recursionJuice);");
+            }
+            else if (func == &sub_implement && argumentCount == 2) {
+                writeLine(t,"nativeSub(" + target + "," + arguments + ",recursionJuice);");
+            }
+            else if (func == &float_implement) {
+                writeLine(t,"nativeConvert(" + target + "," + arguments + ",&convertToFtype,&float_implement,recursionJuice);");
+            }
+            else if (func == &int_implement) {
+                writeLine(t,"nativeConvert(" + target + "," + arguments + ",&convertToInt,&int_implement,recursionJuice);");
+            }
+            else if (func == &bool_implement) {
+                writeLine(t,"nativeConvert(" + target + "," + arguments + ",&convertToBool,&bool_implement,recursionJuice);");
+            }
+            else {
+                const std::pair<std::string,char> key(baseName.c_str(),builtIn->argCount);
+                auto found = t.builtIns.find(key);
+                if (found == t.builtIns.end()) {
+                    const std::string variable = "builtIn" + std::to_string(t.builtIns.size() + 1);
+                    t.declarations.append("const boundFunction " + variable + " = nativeBuiltIn(\"" + key.first + "\"," + std::to_string((int)(key.second)) + ");\n");
+                    found = t.builtIns.insert(std::make_pair(key,variable)).first;
+                }
+                writeLine(t,"nativeCall(" + target + "," + found->second + "," + arguments + "," + std::to_string(argumentCount) + ",recursionJuice);");
+            }
+        }
+    }
+    --(t.depth);
+    writeLine(t,"}");
+    return true;
+}
+
+/// Writes statements that place the value of x in target.
+/// @param t the translation in progress
+/// @param x a function body element
+/// @param target the variable where the value is placed
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if x can't be translated
+bool transpileExpression(Transpilation& t, const ManyType& x, const std::string& target, long recursionJuice) {
+    if (recursionJuice <= 0) {
+        return false;
+    }
+    else {
+        --recursionJuice;
+    }
+    switch (x.type()) {
+        case ManyTypeLabel::None:
+        writeLine(t,target + ".putNone();");
+        return true;
+
+        case ManyTypeLabel::Bool:
+        writeLine(t,target + (x.getBool() ? ".putBool(true);" : ".putBool(false);"));
+        return true;
+
+        case ManyTypeLabel::Int:
+        writeLine(t,target + ".putInt(" + std::to_string(x.getInt()) + "L);");
+        return true;
+
+        case ManyTypeLabel::Ftype:
+        writeLine(t,target + ".putFtype(" + floatLiteral(x.getFtype()) + ");");
+        return true;
+
+        case ManyTypeLabel::StructureString:
+        case ManyTypeLabel::StructureVector:
+        break;
+
+        default:
+        // strings and vectors are left to the interpreter
+        return false;
+    }
+    if (const uint_least32_t slot = findParameter(x,t.definitionVec)) {
+        writeLine(t,target + ".makeCopyFrom(arguments[" + std::to_string(slot - 1) + "],recursionJuice);");
+        return true;
+    }
+    return transpileCall(t,x,target,recursionJuice);
+}
+
+/// @param path a file
+/// @return the contents of the file, empty if it can't be read
+std::string readWholeFile(const std::string& path) {
+    std::ifstream file(path.c_str(),std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+/// Identifies this build of ucalc, and the headers that transpiled
+/// code includes. A library compiled for another build, or against
+/// other headers, may not agree with this one on the layout of ManyType,
+/// so this is part of the name and of the source of each library.
+/// @return a hash of the running program, NativeSupport.h and ManyType.h
+size_t nativeBuildHash() {
+    static const size_t hash = []() {
+        std::string contents = readWholeFile("/proc/self/exe");
+        if (contents.empty()) {
+            contents = __DATE__ " " __TIME__;
+        }
+        contents += readWholeFile(UCALC_SOURCE_DIRECTORY "/Compute/NativeSupport.h");
+        contents += readWholeFile(UCALC_SOURCE_DIRECTORY "/ManyType/ManyType.h");
+        return std::hash<std::string>()(contents);
+    }();
+    return hash;
+}
+
+/// Translates a user-defined function to C++.
+/// The translation defines the bound function NATIVE_ENTRY_POINT,
+/// which gives the same results and errors as the function.
+/// Only bodies made of numbers, local variable names, recursive calls,
+/// and calls to built-in functions that don't delay their arguments
+/// (other than if, and, and or) can be translated.
+/// Recursive calls in tail position run the body again in a loop,
+/// so they don't nest.
+/// @param output where the C++ source will be placed
+/// @param definition a value of UserSymbol::definition
+/// @param baseName the name of the function
+/// @param argCount the number of arguments of the function
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if the function can't be translated
+bool transpileDefinition(std::string& output, const ManyType& definition, const mtstring& baseName, const char argCount, long recursionJuice) {
+    if (definition.type() != ManyTypeLabel::StructureVector) {
+        return false;
+    }
+    const mtvec& definitionVec = definition.getStructureVector();
+    for (int_fast32_t i = 1; i < definitionVec.size(); ++i) {
+        if (definitionVec[i].getStructureString()[0] == '%') {
+            // delayed arguments are passed as written
+            return false;
+        }
+    }
+    Transpilation t = { definitionVec, baseName, argCount, std::string(), std::string(), {}, {}, 0, 0 };
+    findTailCalls(t,definitionVec[0],recursionJuice);
+    writeLine(t,"if (recursionJuice <= 0 || nativeDepth >= NATIVE_RECURSION_LIMIT) {");
+    writeLine(t,"    throw UserAlert(UserMessage::MaximumRecursionDepthReached,nullptr);");
+    writeLine(t,"}");
+    writeLine(t,"--recursionJuice;");
+    if (!t.tailCalls.empty()) {
+        // each tail call starts the loop again
+        writeLine(t,"while (true) {");
+        ++(t.depth);
+    }
+    writeLine(t,"ManyType result;");
+    if (!transpileExpression(t,definitionVec[0],"result",recursionJuice)) {
+        return false;
+    }
+    writeLine(t,"ret = result;");
+    if (!t.tailCalls.empty()) {
+        writeLine(t,"return;");
+        --(t.depth);
+        writeLine(t,"}");
+    }
+    std::ostringstream source;
+    char build[32];
+    snprintf(build,sizeof(build),"%016llx",(unsigned long long)(nativeBuildHash()));
+    source << "// " << baseName.c_str() << " with " << (int)(argCount) << " arguments, transpiled by ucalc build " << build << "\n";
+    source << "#include \"" UCALC_SOURCE_DIRECTORY "/Compute/NativeSupport.h\"\n\n";
+    source << "namespace {\n\n";
+    source << t.declarations << "\n";
+    source << "void nativeBody(ManyType& ret, ManyType* const arguments, long recursionJuice, const long nativeDepth) {\n";
+    source << t.body;
+    source << "}\n\n";
+    source << "}\n\n";
+    source << "extern \"C\" void " NATIVE_ENTRY_POINT "(ManyType& ret, mtvec& arr, long recursionJuice) {\n";
+    source << "    nativeBody(ret,arr.data() + 1,recursionJuice,0);\n";
+    source << "}\n";
+    output = source.str();
+    return true;
+}
+
+/// Finds the directory where transpiled libraries are kept, and makes it
+/// if needed. It is the environment variable UCALC_NATIVE_CACHE if it is set,
+/// otherwise ucalc-native in $XDG_CACHE_HOME or $HOME/.cache,
+/// so that it belongs to the user running ucalc.
+/// @return the directory
+/// @throw UserAlert if there is no such directory, and it can't be made
+std::string nativeCacheDirectory() {
+    const char* const directory = getenv("UCALC_NATIVE_CACHE");
+    if (directory && directory[0]) {
+        if (mkdir(directory,0700) != 0 && errno != EEXIST) {
+            throw UserAlert(UserMessage::NativeCompilationFailed,"Cache Directory");
+        }
+        return std::string(directory);
+    }
+    std::string parent;
+    const char* const cacheHome = getenv("XDG_CACHE_HOME");
+    const char* const home = getenv("HOME");
+    if (cacheHome && cacheHome[0] == '/') {
+        parent = cacheHome;
+    }
+    else if (home && home[0] == '/') {
+        parent = std::string(home) + "/.cache";
+    }
+    else {
+        throw UserAlert(UserMessage::NativeCompilationFailed,"Cache Directory");
+    }
+    const std::string cache = parent + "/ucalc-native";
+    if ((mkdir(parent.c_str(),0700) != 0 && errno != EEXIST) || (mkdir(cache.c_str(),0700) != 0 && errno != EEXIST)) {
+        throw UserAlert(UserMessage::NativeCompilationFailed,"Cache Directory");
+    }
+    return cache;
+}
+
+/// Checks that only the user running ucalc could have
+/// made or changed a path, since libraries found there are loaded.
+/// @param path a directory or file
+/// @param directory true if path must be a directory,
+/// false if it must be a regular file
+/// @return false if path is missing, a symbolic link, of the wrong kind,
+/// owned by someone else, or writable by the group or by anyone
+bool isTrustedPath(const std::string& path, const bool directory) {
+    struct stat info;
+    if (lstat(path.c_str(),&info) != 0) {
+        return false;
+    }
+    if (directory ? !S_ISDIR(info.st_mode) : !S_ISREG(info.st_mode)) {
+        // S_ISDIR and S_ISREG are false for symbolic links, since lstat doesn't follow them
+        return false;
+    }
+    return info.st_uid == getuid() && (info.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+/// Runs the system compiler and waits for it to finish.
+/// The processing time is checked while it runs, so a slow
+/// compilation stops when maximumProcessingTime runs out
+/// or cancelProcessing is called.
+/// @param command the shell command that compiles the library
+/// @return true if the command succeeded
+/// @throw UserAlert if time runs out or processing is cancelled,
+/// once the compiler has been stopped
+bool runNativeCompiler(const std::string& command) {
+    const pid_t child = fork();
+    if (child < 0) {
+        return false;
+    }
+    if (child == 0) {
+        // a process group of its own, so that the
+        // compiler that the shell starts is stopped with it
+        setpgid(0,0);
+        execl("/bin/sh","sh","-c",command.c_str(),(char*)(nullptr));
+        _exit(127);
+    }
+    setpgid(child,child);
+    while (true) {
+        int status = 0;
+        const pid_t finished = waitpid(child,&status,WNOHANG);
+        if (finished == child) {
+            return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        if (finished < 0 && errno != EINTR) {
+            return false;
+        }
+        try {
+            sampleProcessingTime();
+        }
+        catch (...) {
+            kill(-child,SIGKILL);
+            waitpid(child,&status,0);
+            throw;
+        }
+        usleep(NATIVE_COMPILER_POLL_MICROSECONDS);
+    }
+}
+
+/// Compiles transpiled source to a library, unless the cache already holds it.
+/// Libraries are named by the structural hash of the definition
+/// and nativeBuildHash, and are only reused if they were
+/// compiled from the same source.
+/// @param source the C++ source
+/// @param hash the structural hash of the definition
+/// @return the path of the library
+/// @throw UserAlert if the library can't be compiled
+std::string compileNativeLibrary(const std::string& source, const size_t hash) {
+    const std::string directory = nativeCacheDirectory();
+    if (directory.find('\'') != std::string::npos || !isTrustedPath(directory,true)) {
+        // it can't be quoted for the shell,
+        // or another user could plant libraries in it
+        throw UserAlert(UserMessage::NativeCompilationFailed,"Cache Directory");
+    }
+    char name[32];
+    snprintf(name,sizeof(name),"%016llx",(unsigned long long)(hash));
+    const std::string sourcePath = directory + "/" + name + ".cpp";
+    const std::string libraryPath = directory + "/" + name + ".so";
+    if (isTrustedPath(libraryPath,false) && isTrustedPath(sourcePath,false) && readWholeFile(sourcePath) == source) {
+        // compiled before
+        return libraryPath;
+    }
+    {
+        std::ofstream file(sourcePath.c_str(),std::ios::binary | std::ios::trunc);
+        file << source;
+        if (!file) {
+            throw UserAlert(UserMessage::NativeCompilationFailed,"Cache Directory");
+        }
+    }
+    // compile to a temporary name, so that a library
+    // that is half written is never loaded
+    const std::string temporaryPath = libraryPath + "." + std::to_string((long)(getpid())) + ".tmp";
+    const std::string command = NATIVE_COMPILER " -I'" UCALC_SOURCE_DIRECTORY "' -o '" + temporaryPath + "' '" + sourcePath + "' 2>/dev/null";
+    bool compiled;
+    try {
+        compiled = runNativeCompiler(command);
+    }
+    catch (...) {
+        remove(temporaryPath.c_str());
+        remove(sourcePath.c_str());
+        throw;
+    }
+    if (!compiled || rename(temporaryPath.c_str(),libraryPath.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+        remove(sourcePath.c_str());
+        throw UserAlert(UserMessage::NativeCompilationFailed,"Compiler");
+    }
+    return libraryPath;
+}
+
+/// Compiles a user-defined function to machine code.
+/// The function is translated to C++, compiled with the
+/// system compiler, and loaded. Calls to the function run
+/// the machine code until it is redefined or removed.
+/// @param baseName the name of the function
+/// @param argCount the number of arguments of the overload to replace
+/// @param recursionJuice how many layers of recursion may be used by this operation
+/// @return false if the function can't be translated
+/// @throw UserAlert if the function is not defined, or can't be compiled or loaded
+bool transpileUserSymbol(const mtstring& baseName, const char argCount, long recursionJuice) {
+    const SymbolTableElement& element = readSymbol(baseName,argCount);
+    if (element.builtIn) {
+        return false;
+    }
+    UserSymbol& user = *(element.value.user);
+    if (user.definition.type() != ManyTypeLabel::StructureVector || user.definition.getStructureVector().size() - 1 != (size_t)(argCount) || !user.lazyParameters.empty()) {
+        // an n-matched overload, or one with lazy parameters
+        return false;
+    }
+    std::string source;
+    if (!transpileDefinition(source,user.definition,baseName,argCount,recursionJuice)) {
+        return false;
+    }
+    size_t hash = hashValue(user.definition,(size_t)(NATIVE_GENERATOR_VERSION) ^ nativeBuildHash(),recursionJuice);
+    hash = hashValue(user.definition.getStructureVector()[0],hash ^ std::hash<mtstring>()(baseName),recursionJuice);
+    const std::string libraryPath = compileNativeLibrary(source,hash);
+    // the library is never closed, since the
+    // built-in function may be called at any time
+    void* const library = dlopen(libraryPath.c_str(),RTLD_NOW | RTLD_LOCAL);
+    if (library == nullptr) {
+        throw UserAlert(UserMessage::NativeCompilationFailed,"Loader");
+    }
+    const boundFunction func = (boundFunction)(dlsym(library,NATIVE_ENTRY_POINT));
+    if (func == nullptr) {
+        throw UserAlert(UserMessage::NativeCompilationFailed,"Loader");
+    }
+    // a later definition is a new UserSymbol, without this
+    user.native.store(func,std::memory_order_release);
+    return true;
+}
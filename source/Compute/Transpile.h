@@ -0,0 +1,16 @@
+/**
+ * @file Transpile.h
+ * @author Aaron Stanek
+ * @brief Functions for translating user-defined
+ * functions to C++, compiling them, and loading
+ * them as built-in functions
+*/
+#pragma once
+#include "../Globals/Globals.h"
+#include "../ManyType/ManyType.h"
+#include "../Symbols/Symbols.h"
+#include <string>
+
+bool transpileDefinition(std::string&, const ManyType&, const mtstring&, const char, long);
+
+bool transpileUserSymbol(const mtstring&, const char, long);
@@ -0,0 +1,213 @@
+/**
+ * @file WorkStealingPool.cpp
+ * @author Aaron Stanek
+*/
+#include "WorkStealingPool.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/// The number of calls to runInParallel that have not returned.
+/// While it is not 0, caches shared between threads must not be written.
+std::atomic<long> parallelBatchesRunning(0);
+
+/// A call to runInParallel.
+struct PoolBatch {
+    batchFunction run;
+    void* context;
+    /// The number of indices that have not finished.
+    std::atomic<uint_least32_t> remaining;
+};
+
+/// One index of a PoolBatch.
+struct PoolTask {
+    PoolBatch* batch;
+    uint_least32_t index;
+};
+
+/// The tasks pushed by one thread.
+/// Its owner takes the newest task,
+/// other threads steal the oldest.
+struct PoolQueue {
+    std::mutex mutex;
+    std::deque<PoolTask> tasks;
+};
+
+/// Worker threads and their queues.
+/// Workers are started when they are first needed,
+/// and run until the program exits.
+struct WorkStealingPool {
+    /// queues[0] is shared by every thread that is not a worker.
+    /// queues[n] belongs to worker n.
+    PoolQueue queues[MAX_maximumWorkerThreads + 1];
+    /// The number of workers started.
+    std::atomic<long> workerCount;
+    /// The number of tasks in all queues.
+    std::atomic<long> pendingTasks;
+    /// Guards threads, and is held while starting a worker.
+    std::mutex threadsMutex;
+    std::vector<std::thread> threads;
+    /// Idle workers wait on wake.
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    /// Set when the program exits.
+    bool stopping;
+    WorkStealingPool() : workerCount(0), pendingTasks(0), stopping(false) {};
+    ~WorkStealingPool();
+};
+
+WorkStealingPool pool;
+
+/// The index of the queue of this thread in pool.queues.
+thread_local uint_least32_t poolQueueIndex = 0;
+
+/// Takes a task, preferring the newest task of this thread,
+/// then the oldest task of any other thread.
+/// @param task where the task will be placed
+/// @return false if there are no tasks
+bool takeTask(PoolTask& task) {
+    {
+        PoolQueue& own = pool.queues[poolQueueIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            --(pool.pendingTasks);
+            return true;
+        }
+    }
+    const uint_least32_t queueCount = pool.workerCount.load() + 1;
+    for (uint_least32_t i = 1; i < queueCount; ++i) {
+        PoolQueue& other = pool.queues[(poolQueueIndex + i) % queueCount];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = other.tasks.front();
+            other.tasks.pop_front();
+            --(pool.pendingTasks);
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Runs a task and marks it finished.
+/// Its batch may be gone as soon as it is marked.
+/// @param task the task to run
+inline void runTask(const PoolTask& task) {
+    PoolBatch& batch = *(task.batch);
+    batch.run(batch.context,task.index);
+    batch.remaining.fetch_sub(1,std::memory_order_release);
+}
+
+/// The body of each worker thread.
+/// Workers numbered above maximumWorkerThreads stay idle.
+/// @param index the index of the queue of this worker
+void workerMain(const uint_least32_t index) {
+    poolQueueIndex = index;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(pool.sleepMutex);
+            pool.wake.wait(lock,[index]() {
+                return pool.stopping || (pool.pendingTasks.load() > 0 && (long)(index) <= maximumWorkerThreads);
+            });
+            if (pool.stopping) {
+                return;
+            }
+        }
+        PoolTask task;
+        while (takeTask(task)) {
+            runTask(task);
+        }
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+}
+
+/// Starts workers until there are maximumWorkerThreads of them.
+/// If a thread can't be started, the workers that
+/// have already started are used.
+void startWorkers() {
+    if (pool.workerCount.load() >= maximumWorkerThreads) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(pool.threadsMutex);
+    try {
+        while (pool.workerCount.load() < maximumWorkerThreads) {
+            const uint_least32_t index = pool.workerCount.load() + 1;
+            pool.threads.push_back(std::thread(&workerMain,index));
+            // the queue is ready, other threads may now steal from it
+            ++(pool.workerCount);
+        }
+    }
+    catch (...) {
+        // run with fewer workers
+    }
+}
+
+/// Calls run(context,i) for every i from 0 to count-1,
+/// on this thread and on idle workers.
+/// While waiting for the other threads, this thread
+/// runs any task it can find, so batches started inside
+/// of a batch can't deadlock.
+/// @param run the function to call, it must not throw
+/// @param context passed to run
+/// @param count the number of indices
+/// @throw std::bad_alloc if the tasks could not be queued,
+/// in which case run has not been called
+void runInParallel(const batchFunction run, void* const context, const uint_least32_t count) {
+    if (count == 0) {
+        return;
+    }
+    startWorkers();
+    PoolBatch batch;
+    batch.run = run;
+    batch.context = context;
+    batch.remaining.store(count);
+    {
+        PoolQueue& own = pool.queues[poolQueueIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        const size_t previousSize = own.tasks.size();
+        try {
+            // index 1 is taken next by this thread,
+            // the highest indices are stolen first
+            for (uint_least32_t i = count - 1; i >= 1; --i) {
+                PoolTask task = { &batch, i };
+                own.tasks.push_back(task);
+            }
+        }
+        catch (...) {
+            // no one has seen them, since the lock is held
+            own.tasks.resize(previousSize);
+            throw;
+        }
+        pool.pendingTasks += count - 1;
+        ++parallelBatchesRunning;
+    }
+    {
+        // so that no worker misses the new tasks
+        std::lock_guard<std::mutex> lock(pool.sleepMutex);
+    }
+    pool.wake.notify_all();
+    run(context,0);
+    batch.remaining.fetch_sub(1,std::memory_order_release);
+    PoolTask task;
+    while (batch.remaining.load(std::memory_order_acquire) > 0) {
+        if (takeTask(task)) {
+            runTask(task);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    --parallelBatchesRunning;
+}
@@ -0,0 +1,17 @@
+/**
+ * @file WorkStealingPool.h
+ * @author Aaron Stanek
+ * @brief A pool of worker threads that
+ * take work from each other when idle
+*/
+#pragma once
+#include "../Globals/Globals.h"
+
+/// A function that runs one index of a batch.
+/// The first argument is the context passed to runInParallel.
+/// It must not throw.
+typedef void (*batchFunction)(void*,uint_least32_t);
+
+extern std::atomic<long> parallelBatchesRunning;
+
+void runInParallel(const batchFunction, void* const, const uint_least32_t);
@@ -3,8 +3,12 @@
  * @author Aaron Stanek
 */
 #include "Globals.h"
+#include <thread>
+#include <pthread.h>
 
-UserAlert::UserAlert(const UserMessage base, const char* const extra) {
+/// @param base the kind of error
+/// @return the text shown for base
+const char* userMessageText(const UserMessage base) noexcept {
     const char* memo;
     switch (base) {
         case UserMessage::MaximumRecursionDepthReached:
@@ -19,6 +23,14 @@ UserAlert::UserAlert(const UserMessage base, const char* const extra) {
         memo = "Max Processing Time Reached";
         break;
 
+        case UserMessage::Cancelled:
+        memo = "Processing Cancelled";
+        break;
+
+        case UserMessage::MemoryLimitReached:
+        memo = "Max Memory Reached";
+        break;
+
         case UserMessage::StructureStringFormatError:
         memo = "Malformed Symbol";
         break;
@@ -63,17 +75,45 @@ UserAlert::UserAlert(const UserMessage base, const char* const extra) {
         memo = "Infinity Error During";
         break;
 
+        case UserMessage::ShapeMismatch:
+        memo = "Shape Mismatch During";
+        break;
+
+        case UserMessage::NativeCompilationFailed:
+        memo = "Native Compilation Failed In";
+        break;
+
         default:
         memo = "Unknown Error";
     }
-    message.assign(memo);
-    if (extra) {
-        message.append(": ");
-        message.append(extra);
+    return memo;
+}
+
+/// Records the error. Nothing is formatted yet.
+/// @param b the kind of error
+/// @param e details about the error, or nullptr, copied
+UserAlert::UserAlert(const UserMessage b, const char* const e) : base(b) {
+    if (e) {
+        extra.assign(e);
     }
 }
 
+/// Formats the message the first time it is called.
+/// @return the message shown to the user
 const char* UserAlert::what() const noexcept {
+    if (message.empty()) {
+        try {
+            message.assign(userMessageText(base));
+            if (!extra.empty()) {
+                message.append(": ");
+                message.append(extra);
+            }
+        }
+        catch (...) {
+            message.clear();
+            return userMessageText(base);
+        }
+    }
     return message.c_str();
 }
 
@@ -85,10 +125,71 @@ long maximumRecursionDepth = 500;
 long maximumLogicalRecursionDepth = 10000;
 /// Initial value is 120. In seconds.
 double maximumProcessingTime = 120;
-/// Set to the current time when processing of
-/// a user input begins.
-/// Initially undefined.
-time_t processingStartTime;
+/// Set to the current time by startProcessing,
+/// when processing of a user input begins.
+/// Initially the epoch of steady_clock.
+std::chrono::steady_clock::time_point processingStartTime;
+/// Set by cancelProcessing, cleared by startProcessing.
+/// Initial value is false.
+std::atomic<bool> processingCancelled(false);
+/// The number of calls to checkProcessingTime left
+/// before the clock is read again, on this thread.
+/// Initial value is PROCESSING_FUEL_PER_SAMPLE.
+thread_local long processingFuel = PROCESSING_FUEL_PER_SAMPLE;
+/// The lowest address checkNativeStack allows on this thread,
+/// 0 until it is found.
+thread_local uintptr_t nativeStackLimit = 0;
+/// Initial value is 268435456 (256 MiB). In bytes.
+size_t maximumMemory = 268435456;
+/// The number of bytes currently allocated
+/// on behalf of ManyType objects.
+/// Atomic, because worker threads allocate too.
+/// Initial value is 0.
+std::atomic<size_t> currentMemoryUsage(0);
+/// The largest value that currentMemoryUsage
+/// has held since the program started.
+/// Initial value is 0.
+std::atomic<size_t> peakMemoryUsage(0);
+/// The number of results remembered for each
+/// pure user-defined function before they are discarded.
+/// 0 disables memoization.
+/// Initial value is 4096.
+long maximumMemoizedResults = 4096;
+
+/// @return one less than the number of hardware threads,
+/// within the limits of maximumWorkerThreads
+long defaultWorkerThreads() noexcept {
+    const long hardwareThreads = std::thread::hardware_concurrency();
+    if (hardwareThreads - 1 > MAX_maximumWorkerThreads) {
+        return MAX_maximumWorkerThreads;
+    }
+    if (hardwareThreads - 1 < MIN_maximumWorkerThreads) {
+        return MIN_maximumWorkerThreads;
+    }
+    return hardwareThreads - 1;
+}
+
+/// The number of threads that may evaluate
+/// independent arguments alongside the thread
+/// that evaluates the user input.
+/// 0 disables parallel evaluation.
+/// Initial value is one less than the number of hardware threads.
+long maximumWorkerThreads = defaultWorkerThreads();
+/// True while calls are being measured.
+/// Initial value is false.
+std::atomic<bool> profilingEnabled(false);
+/// True while evaluation events are recorded
+/// into the ring buffer of each thread.
+/// Initial value is false.
+std::atomic<bool> tracingEnabled(false);
+/// The number of bytes allocated while profilingEnabled was true,
+/// including bytes that have since been freed.
+/// Initial value is 0.
+std::atomic<unsigned long long> profiledBytes(0);
+/// True while the values of derived variables are
+/// kept until something they depend on is redefined.
+/// Initial value is false.
+std::atomic<bool> reactiveEnabled(false);
 
 /// Stores an updated value of maximumRecursionDepth
 /// until the current user input has finished.
@@ -108,21 +209,126 @@ long newMaximumLogicalRecursionDepth = -1;
 /// not be updated.
 /// Initial value is -1.
 double newMaximumProcessingTime = -1;
+/// Stores an updated value of maximumMemory
+/// until the current user input has finished.
+/// A value of 0 indicates that maximumMemory should
+/// not be updated.
+/// Initial value is 0.
+size_t newMaximumMemory = 0;
+/// Stores an updated value of maximumMemoizedResults
+/// until the current user input has finished.
+/// A value of -1 indicates that maximumMemoizedResults should
+/// not be updated.
+/// Initial value is -1.
+long newMaximumMemoizedResults = -1;
+/// Stores an updated value of maximumWorkerThreads
+/// until the current user input has finished.
+/// A value of -1 indicates that maximumWorkerThreads should
+/// not be updated.
+/// Initial value is -1.
+long newMaximumWorkerThreads = -1;
+
+/// Sets processingStartTime to now, and clears processingCancelled.
+/// Call when processing of a user input begins.
+void startProcessing() noexcept {
+    processingStartTime = std::chrono::steady_clock::now();
+    processingCancelled.store(false);
+    processingFuel = PROCESSING_FUEL_PER_SAMPLE;
+}
+
+/// Makes evaluation stop with a UserAlert, on every thread,
+/// within PROCESSING_FUEL_PER_SAMPLE steps.
+/// Safe to call from a signal handler or from another thread.
+void cancelProcessing() noexcept {
+    processingCancelled.store(true);
+}
 
+/// The slow path of checkProcessingTime.
+/// Reads the clock and refills processingFuel.
 /// @throw UserAlert if time elapsed since processingStartTime
-/// is greater than or equal to maximumProcessingTime
-void checkProcessingTime() {
-    if (difftime(time(NULL),processingStartTime) >= maximumProcessingTime) {
+/// is greater than or equal to maximumProcessingTime,
+/// or if cancelProcessing was called
+void sampleProcessingTime() {
+    processingFuel = PROCESSING_FUEL_PER_SAMPLE;
+    if (processingCancelled.load()) {
+        throw UserAlert(UserMessage::Cancelled,nullptr);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - processingStartTime;
+    if (elapsed.count() >= maximumProcessingTime) {
         throw UserAlert(UserMessage::Timeout,nullptr);
     }
 }
 
+/// The slow path of checkNativeStack, run once on each thread.
+/// Sets nativeStackLimit to NATIVE_STACK_RESERVE bytes above
+/// the bottom of the stack of the calling thread.
+void findNativeStackLimit() noexcept {
+    const char marker = 0;
+    const uintptr_t here = (uintptr_t)(&marker);
+    uintptr_t bottom = 0;
+    size_t size = 0;
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(pthread_self(),&attributes) == 0) {
+        void* address = nullptr;
+        if (pthread_attr_getstack(&attributes,&address,&size) == 0) {
+            bottom = (uintptr_t)(address);
+        }
+        pthread_attr_destroy(&attributes);
+    }
+    if (bottom == 0 || here <= bottom || here - bottom > size) {
+        // the stack could not be found
+        // assume it is as small as the stacks of
+        // threads made by most systems
+        size = 512 * 1024;
+        bottom = here - size;
+    }
+    // small stacks keep half of what is left
+    const size_t reserve = (here - bottom < 2 * NATIVE_STACK_RESERVE) ? (here - bottom) / 2 : NATIVE_STACK_RESERVE;
+    nativeStackLimit = bottom + reserve;
+}
+
+/// Records that bytes have been allocated on behalf of a ManyType object.
+/// Updates currentMemoryUsage and peakMemoryUsage.
+/// @param bytes the size of the allocation
+/// @throw UserAlert if currentMemoryUsage would exceed maximumMemory,
+/// in which case nothing is recorded
+void recordAllocation(const size_t bytes) {
+    if (bytes > maximumMemory) {
+        throw UserAlert(UserMessage::MemoryLimitReached,nullptr);
+    }
+    // another thread may be allocating at the same time,
+    // so the check is made on the value that was added to
+    const size_t previous = currentMemoryUsage.fetch_add(bytes,std::memory_order_relaxed);
+    if (previous > maximumMemory - bytes) {
+        currentMemoryUsage.fetch_sub(bytes,std::memory_order_relaxed);
+        throw UserAlert(UserMessage::MemoryLimitReached,nullptr);
+    }
+    if (profilingEnabled) {
+        // worker threads allocate too
+        profiledBytes.fetch_add(bytes,std::memory_order_relaxed);
+    }
+    const size_t current = previous + bytes;
+    size_t peak = peakMemoryUsage.load(std::memory_order_relaxed);
+    while (current > peak && !peakMemoryUsage.compare_exchange_weak(peak,current,std::memory_order_relaxed)) {
+        // peak was reloaded, try again
+    }
+}
+
+/// Records that bytes previously passed to
+/// recordAllocation have been freed.
+/// @param bytes the size of the allocation
+void recordDeallocation(const size_t bytes) noexcept {
+    currentMemoryUsage.fetch_sub(bytes,std::memory_order_relaxed);
+}
+
 /// Updates maximumRecursionDepth, maximumLogicalRecursionDepth,
-/// and maximumProcessingTime, if indicated by newMaximumRecursionDepth,
-/// newMaximumLogicalRecursionDepth, and newMaximumProcessingTime, respectively.
+/// maximumProcessingTime, maximumMemory, maximumMemoizedResults, and maximumWorkerThreads,
+/// if indicated by newMaximumRecursionDepth, newMaximumLogicalRecursionDepth,
+/// newMaximumProcessingTime, newMaximumMemory, newMaximumMemoizedResults, and newMaximumWorkerThreads, respectively.
 /// newMaximumRecursionDepth, newMaximumLogicalRecursionDepth,
-/// and newMaximumProcessingTime will be set to -1 if the corresponding
-/// value was updated.
+/// newMaximumProcessingTime, newMaximumMemoizedResults, and newMaximumWorkerThreads will be set to -1 if the corresponding
+/// value was updated. newMaximumMemory will be set to 0.
+/// maximumMemory is kept between MIN_maximumMemory and MAX_maximumMemory.
 void applyNewLimits() noexcept {
     if (newMaximumRecursionDepth > 0) {
         maximumRecursionDepth = newMaximumRecursionDepth;
@@ -136,4 +342,24 @@ void applyNewLimits() noexcept {
         maximumProcessingTime = newMaximumProcessingTime;
         newMaximumProcessingTime = -1;
     }
+    if (newMaximumMemory > 0) {
+        if (newMaximumMemory < MIN_maximumMemory) {
+            maximumMemory = MIN_maximumMemory;
+        }
+        else if (newMaximumMemory > MAX_maximumMemory) {
+            maximumMemory = MAX_maximumMemory;
+        }
+        else {
+            maximumMemory = newMaximumMemory;
+        }
+        newMaximumMemory = 0;
+    }
+    if (newMaximumMemoizedResults >= 0) {
+        maximumMemoizedResults = newMaximumMemoizedResults;
+        newMaximumMemoizedResults = -1;
+    }
+    if (newMaximumWorkerThreads >= 0) {
+        maximumWorkerThreads = newMaximumWorkerThreads;
+        newMaximumWorkerThreads = -1;
+    }
 }
\ No newline at end of file
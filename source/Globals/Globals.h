@@ -13,6 +13,8 @@
 #include <math.h>
 #include <stdint.h>
 #include <time.h>
+#include <atomic>
+#include <chrono>
 #include <exception>
 #include <string>
 #include <vector>
@@ -27,6 +29,8 @@ enum class UserMessage: uint_fast8_t {
     MaximumRecursionDepthReached,
     MaximumLogicalRecursionDepthReached,
     Timeout,
+    Cancelled,
+    MemoryLimitReached,
     StructureStringFormatError,
     // text processing
     InputTooLong,
@@ -39,11 +43,21 @@ enum class UserMessage: uint_fast8_t {
     UnexpectedType,
     DomainError,
     NanError,
-    InfinityError
+    InfinityError,
+    ShapeMismatch,
+    NativeCompilationFailed
 };
 
+/// An error to be shown to the user.
+/// The message is only formatted if what() is called,
+/// so alerts that are caught and discarded stay cheap.
 struct UserAlert : public std::exception {
-    std::string message;
+    UserMessage base;
+    /// Details about the error, may be empty.
+    /// Usually a symbol name, short enough to need no allocation.
+    std::string extra;
+    /// Formatted by what().
+    mutable std::string message;
     UserAlert(const UserMessage, const char* const);
     const char* what() const noexcept;
 };
@@ -51,15 +65,68 @@ struct UserAlert : public std::exception {
 extern long maximumRecursionDepth;
 extern long maximumLogicalRecursionDepth;
 extern double maximumProcessingTime;
-extern time_t processingStartTime;
+extern std::chrono::steady_clock::time_point processingStartTime;
+extern std::atomic<bool> processingCancelled;
+extern thread_local long processingFuel;
+extern thread_local uintptr_t nativeStackLimit;
+extern size_t maximumMemory;
+extern std::atomic<size_t> currentMemoryUsage;
+extern std::atomic<size_t> peakMemoryUsage;
+extern long maximumMemoizedResults;
+extern long maximumWorkerThreads;
+extern std::atomic<bool> profilingEnabled;
+extern std::atomic<bool> tracingEnabled;
+extern std::atomic<bool> reactiveEnabled;
+extern std::atomic<unsigned long long> profiledBytes;
 
 // add places to hold updated values
 
 extern long newMaximumRecursionDepth;
 extern long newMaximumLogicalRecursionDepth;
 extern double newMaximumProcessingTime;
+extern size_t newMaximumMemory;
+extern long newMaximumMemoizedResults;
+extern long newMaximumWorkerThreads;
 
-void checkProcessingTime();
+void startProcessing() noexcept;
+
+void cancelProcessing() noexcept;
+
+void sampleProcessingTime();
+
+/// Counts one step of evaluation. Every PROCESSING_FUEL_PER_SAMPLE
+/// steps, the clock and the cancellation flag are checked.
+/// @throw UserAlert if time elapsed since processingStartTime
+/// is greater than or equal to maximumProcessingTime,
+/// or if cancelProcessing was called
+inline void checkProcessingTime() {
+    if (--processingFuel <= 0) {
+        sampleProcessingTime();
+    }
+}
+
+void findNativeStackLimit() noexcept;
+
+/// Makes sure that the native stack has room for another layer
+/// of recursion. maximumRecursionDepth may allow more layers
+/// than the stack of the thread can hold, this stops
+/// evaluation with an alert before the stack overflows.
+/// @throw UserAlert if fewer than NATIVE_STACK_RESERVE bytes
+/// of the stack are left
+inline void checkNativeStack() {
+    const char marker = 0;
+    if (nativeStackLimit == 0) {
+        findNativeStackLimit();
+    }
+    // the stack grows down
+    if ((uintptr_t)(&marker) < nativeStackLimit) {
+        throw UserAlert(UserMessage::MaximumRecursionDepthReached,nullptr);
+    }
+}
+
+void recordAllocation(const size_t);
+
+void recordDeallocation(const size_t) noexcept;
 
 void applyNewLimits() noexcept;
 
@@ -70,6 +137,28 @@ void applyNewLimits() noexcept;
 #define MAX_maximumProcessingTime 86401
 /// In seconds.
 #define MIN_maximumProcessingTime 3
+/// In bytes.
+#define MAX_maximumMemory ((size_t)(-1))
+/// In bytes. Enough to hold a few copies of the largest user input.
+#define MIN_maximumMemory (4 * MAX_INPUT_SIZE)
+/// Per user-defined function.
+#define MAX_maximumMemoizedResults 1048576
+/// Disables memoization.
+#define MIN_maximumMemoizedResults 0
+/// Not counting the thread that evaluates the user input.
+#define MAX_maximumWorkerThreads 64
+/// Disables parallel evaluation.
+#define MIN_maximumWorkerThreads 0
+
+/// The number of calls to checkProcessingTime between
+/// readings of the clock. Small enough that a cancellation
+/// is noticed within milliseconds.
+#define PROCESSING_FUEL_PER_SAMPLE 1024
+
+/// In bytes. The part of each thread's native stack that
+/// checkNativeStack leaves for the work done between checks,
+/// and for unwinding the alert it throws.
+#define NATIVE_STACK_RESERVE (256 * 1024)
 
 /// Maximum number of elements in a StructureVector
 /// representing a function definition
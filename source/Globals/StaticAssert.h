@@ -40,4 +40,8 @@ static_assert( (unsigned long)( (time_t)(MIN_TIME_BITS) ) == (unsigned long)(MIN
 static_assert( DBL_MANT_DIG >= 17 , "double must hold at least 17 bits of precision" );
 
 // this should hold true on pretty much every platform ever, but it can't hurt
-// to be sure about this
\ No newline at end of file
+// to be sure about this
+
+// cancelProcessing may be called from a signal handler,
+// which is only safe if the flag is always lock-free
+static_assert( ATOMIC_BOOL_LOCK_FREE == 2 , "std::atomic<bool> must be lock-free" );
\ No newline at end of file
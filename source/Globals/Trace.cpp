@@ -0,0 +1,356 @@
+/**
+ * @file Trace.cpp
+ * @author Aaron Stanek
+*/
+#include "Trace.h"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+/// The number of events kept by each thread.
+/// Older events are overwritten. Must be a power of 2.
+#define TRACE_RING_CAPACITY 65536
+
+/// The first 8 bytes of a trace file.
+#define TRACE_FILE_MAGIC "UCTRACE1"
+
+/// The events recorded by one thread.
+/// Only that thread writes to it while tracingEnabled is true,
+/// so recording an event takes no lock.
+struct TraceRing {
+    /// The order in which threads first recorded an event, from 0.
+    uint_least32_t thread;
+    /// The number of events ever recorded. The newest
+    /// is at index (written - 1) % TRACE_RING_CAPACITY.
+    std::atomic<uint_least64_t> written;
+    TraceEvent events[TRACE_RING_CAPACITY];
+    /// The names of the symbols in the events, indexed by
+    /// the symbol in TraceEvent::word.
+    std::vector<std::string> names;
+    /// The index in names of each name, keyed by a hash of it.
+    std::unordered_map<uint_least64_t,uint_least32_t> ids;
+};
+
+/// Every ring ever made. Rings are kept until the program
+/// exits, since a worker thread keeps a pointer to its own.
+std::vector< std::unique_ptr<TraceRing> > traceRings;
+
+/// Guards traceRings.
+std::mutex traceRingsMutex;
+
+/// The ring of this thread, made by its first event.
+thread_local TraceRing* traceRing = nullptr;
+
+/// When startTracing was last called.
+std::chrono::steady_clock::time_point traceStartTime;
+
+/// @return the ring of this thread, or nullptr if it could not be made
+TraceRing* findTraceRing() noexcept {
+    if (traceRing) {
+        return traceRing;
+    }
+    try {
+        std::unique_ptr<TraceRing> ring(new TraceRing());
+        std::lock_guard<std::mutex> lock(traceRingsMutex);
+        ring->thread = traceRings.size();
+        ring->written.store(0);
+        traceRings.push_back(std::move(ring));
+        traceRing = traceRings.back().get();
+    }
+    catch (...) {
+        // this thread records nothing
+    }
+    return traceRing;
+}
+
+/// Adds an event to the ring of this thread.
+/// @param ring the ring of this thread
+/// @param kind what happened
+/// @param symbol the index of the symbol name, or 0
+/// @param size the number of arguments or bytes
+inline void recordTraceEvent(TraceRing& ring, const TraceEventKind kind, const uint_least32_t symbol, const uint_least32_t size) noexcept {
+    const uint_least64_t index = ring.written.load(std::memory_order_relaxed);
+    TraceEvent& event = ring.events[index & (TRACE_RING_CAPACITY - 1)];
+    event.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceStartTime).count();
+    event.word = ((uint_least32_t)(kind) << TRACE_SYMBOL_BITS) | symbol;
+    event.size = size;
+    ring.written.store(index + 1,std::memory_order_release);
+}
+
+/// 64 bit FNV-1a.
+/// @param name the bytes to hash
+/// @param length the number of bytes
+/// @return the hash
+uint_least64_t traceNameHash(const char* const name, const size_t length) noexcept {
+    uint_least64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+        h = (h ^ (unsigned char)(name[i])) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/// Records that a symbol was called or loaded.
+/// Only call this if tracingEnabled is true.
+/// The event is dropped if memory for it runs out.
+/// @param kind TraceEventKind::Call or TraceEventKind::Load
+/// @param name the basename of the symbol, not null-terminated
+/// @param length the length of name
+/// @param argumentCount the number of arguments passed
+/// @return true if the event was recorded
+bool traceSymbol(const TraceEventKind kind, const char* const name, const size_t length, const uint_least32_t argumentCount) noexcept {
+    TraceRing* const ring = findTraceRing();
+    if (ring == nullptr) {
+        return false;
+    }
+    // names that hash the same are told apart by
+    // moving on to the next hash, as in open addressing
+    uint_least64_t h = traceNameHash(name,length);
+    uint_least32_t symbol;
+    while (true) {
+        auto found = ring->ids.find(h);
+        if (found == ring->ids.end()) {
+            if (ring->names.size() >= ((uint_least32_t)(1) << TRACE_SYMBOL_BITS)) {
+                return false;
+            }
+            try {
+                ring->names.push_back(std::string(name,length));
+                ring->ids[h] = ring->names.size() - 1;
+            }
+            catch (...) {
+                // drop the event, the name may be recorded later
+                if (ring->names.size() > ring->ids.size()) {
+                    ring->names.pop_back();
+                }
+                return false;
+            }
+            symbol = ring->names.size() - 1;
+            break;
+        }
+        if (ring->names[found->second].compare(0,std::string::npos,name,length) == 0) {
+            symbol = found->second;
+            break;
+        }
+        ++h;
+    }
+    recordTraceEvent(*ring,kind,symbol,argumentCount);
+    return true;
+}
+
+/// Records that the innermost call or load returned.
+/// Only call this if traceSymbol returned true for it,
+/// so that a dropped call has no return.
+void traceExit() noexcept {
+    TraceRing* const ring = findTraceRing();
+    if (ring) {
+        recordTraceEvent(*ring,TraceEventKind::Return,0,0);
+    }
+}
+
+/// Records that a string or vector was copied.
+/// Only call this if tracingEnabled is true.
+/// @param bytes the size of what was copied
+void traceCopy(const size_t bytes) noexcept {
+    TraceRing* const ring = findTraceRing();
+    if (ring) {
+        recordTraceEvent(*ring,TraceEventKind::Copy,0,(bytes > UINT_LEAST32_MAX) ? UINT_LEAST32_MAX : bytes);
+    }
+}
+
+/// Discards every recorded event, and starts recording.
+/// Call between user inputs, while no thread is evaluating.
+void startTracing() {
+    std::lock_guard<std::mutex> lock(traceRingsMutex);
+    for (auto it = traceRings.begin(); it != traceRings.end(); ++it) {
+        (*it)->written.store(0);
+        (*it)->names.clear();
+        (*it)->ids.clear();
+    }
+    traceStartTime = std::chrono::steady_clock::now();
+    tracingEnabled = true;
+}
+
+/// Stops recording. What was recorded is kept.
+void stopTracing() noexcept {
+    tracingEnabled = false;
+}
+
+/// Writes an unsigned integer, least significant byte first,
+/// so that trace files can be read on any machine.
+/// @param output where the integer is written
+/// @param value the integer
+/// @param bytes the number of bytes to write
+void writeTraceInteger(std::ostream& output, uint_least64_t value, const uint_fast8_t bytes) {
+    for (uint_fast8_t i = 0; i < bytes; ++i) {
+        output.put((char)(value & 0xFF));
+        value >>= 8;
+    }
+}
+
+/// Reads an unsigned integer written by writeTraceInteger.
+/// @param input where the integer is read from
+/// @param value where the integer will be placed
+/// @param bytes the number of bytes to read
+/// @return false if input ended first
+bool readTraceInteger(std::istream& input, uint_least64_t& value, const uint_fast8_t bytes) {
+    value = 0;
+    for (uint_fast8_t i = 0; i < bytes; ++i) {
+        const int c = input.get();
+        if (c == std::char_traits<char>::eof()) {
+            return false;
+        }
+        value |= (uint_least64_t)(c & 0xFF) << (8 * i);
+    }
+    return true;
+}
+
+/// Writes the events kept by every thread, oldest first, in a
+/// compact binary form that decodeTraceFile can read later.
+/// Call between user inputs, while no thread is evaluating.
+/// \n The file is TRACE_FILE_MAGIC, the number of threads (4 bytes),
+/// then for each thread: its number (4 bytes), the number of names
+/// (4 bytes), each name as a length (4 bytes) and its bytes,
+/// the number of events (8 bytes), and each event as
+/// time (8 bytes), word (4 bytes), and size (4 bytes).
+/// @param output where the trace is written, opened in binary mode
+void writeTraceFile(std::ostream& output) {
+    std::lock_guard<std::mutex> lock(traceRingsMutex);
+    output.write(TRACE_FILE_MAGIC,8);
+    writeTraceInteger(output,traceRings.size(),4);
+    for (auto it = traceRings.begin(); it != traceRings.end(); ++it) {
+        const TraceRing& ring = **it;
+        writeTraceInteger(output,ring.thread,4);
+        writeTraceInteger(output,ring.names.size(),4);
+        for (auto name = ring.names.begin(); name != ring.names.end(); ++name) {
+            writeTraceInteger(output,name->size(),4);
+            output.write(name->data(),name->size());
+        }
+        const uint_least64_t written = ring.written.load(std::memory_order_acquire);
+        const uint_least64_t first = (written > TRACE_RING_CAPACITY) ? written - TRACE_RING_CAPACITY : 0;
+        writeTraceInteger(output,written - first,8);
+        for (uint_least64_t i = first; i < written; ++i) {
+            const TraceEvent& event = ring.events[i & (TRACE_RING_CAPACITY - 1)];
+            writeTraceInteger(output,event.time,8);
+            writeTraceInteger(output,event.word,4);
+            writeTraceInteger(output,event.size,4);
+        }
+    }
+}
+
+/// Writes a string as a JSON string literal.
+/// @param output where the literal is written
+/// @param s the string
+void writeJsonString(std::ostream& output, const std::string& s) {
+    output << '"';
+    for (auto it = s.begin(); it != s.end(); ++it) {
+        const unsigned char c = *it;
+        if (c == '"' || c == '\\') {
+            output << '\\' << (char)(c);
+        }
+        else if (c < 0x20) {
+            char escape[8];
+            snprintf(escape,sizeof(escape),"\\u%04x",(unsigned int)(c));
+            output << escape;
+        }
+        else {
+            output << (char)(c);
+        }
+    }
+    output << '"';
+}
+
+/// Converts a file written by writeTraceFile into the JSON trace
+/// format read by chrome://tracing and Perfetto.
+/// Calls and loads become slices, copies become instant events.
+/// Returns whose call was overwritten in the ring are left out.
+/// @param input the trace file, opened in binary mode
+/// @param output where the JSON is written
+/// @return false if input is not a trace file, or is cut short,
+/// in which case output holds the events decoded so far
+bool decodeTraceFile(std::istream& input, std::ostream& output) {
+    char magic[8];
+    if (!input.read(magic,8) || std::string(magic,8) != TRACE_FILE_MAGIC) {
+        return false;
+    }
+    uint_least64_t threadCount;
+    if (!readTraceInteger(input,threadCount,4)) {
+        return false;
+    }
+    output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    bool complete = true;
+    for (uint_least64_t t = 0; complete && t < threadCount; ++t) {
+        uint_least64_t thread, nameCount, eventCount;
+        if (!readTraceInteger(input,thread,4) || !readTraceInteger(input,nameCount,4)) {
+            complete = false;
+            break;
+        }
+        std::vector<std::string> names;
+        for (uint_least64_t n = 0; n < nameCount; ++n) {
+            uint_least64_t length;
+            if (!readTraceInteger(input,length,4)) {
+                complete = false;
+                break;
+            }
+            std::string name(length,'\0');
+            if (length > 0 && !input.read(&(name[0]),length)) {
+                complete = false;
+                break;
+            }
+            names.push_back(name);
+        }
+        if (!complete || !readTraceInteger(input,eventCount,8)) {
+            complete = false;
+            break;
+        }
+        // the calls that are open, so that returns whose
+        // call was overwritten can be left out
+        uint_least64_t depth = 0;
+        for (uint_least64_t e = 0; e < eventCount; ++e) {
+            uint_least64_t time, word, size;
+            if (!readTraceInteger(input,time,8) || !readTraceInteger(input,word,4) || !readTraceInteger(input,size,4)) {
+                complete = false;
+                break;
+            }
+            const TraceEventKind kind = (TraceEventKind)(word >> TRACE_SYMBOL_BITS);
+            const uint_least64_t symbol = word & (((uint_least64_t)(1) << TRACE_SYMBOL_BITS) - 1);
+            if (kind == TraceEventKind::Return) {
+                if (depth == 0) {
+                    continue;
+                }
+                --depth;
+            }
+            if ((kind == TraceEventKind::Call || kind == TraceEventKind::Load) && symbol >= names.size()) {
+                complete = false;
+                break;
+            }
+            // microseconds, keeping the nanoseconds
+            char timestamp[32];
+            snprintf(timestamp,sizeof(timestamp),"%llu.%03u",(unsigned long long)(time / 1000),(unsigned int)(time % 1000));
+            output << (first ? "\n" : ",\n");
+            first = false;
+            switch (kind) {
+                case TraceEventKind::Call:
+                case TraceEventKind::Load:
+                ++depth;
+                output << "{\"name\":";
+                writeJsonString(output,(kind == TraceEventKind::Load ? "load " : "") + names[symbol] + "/" + std::to_string(size));
+                output << ",\"cat\":\"" << (kind == TraceEventKind::Load ? "load" : "call") << "\",\"ph\":\"B\",\"ts\":" << timestamp
+                    << ",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"arguments\":" << size << "}}";
+                break;
+
+                case TraceEventKind::Return:
+                output << "{\"ph\":\"E\",\"ts\":" << timestamp << ",\"pid\":1,\"tid\":" << thread << "}";
+                break;
+
+                default:
+                output << "{\"name\":\"copy\",\"cat\":\"copy\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << timestamp
+                    << ",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"bytes\":" << size << "}}";
+                break;
+            }
+        }
+    }
+    output << "\n]}\n";
+    return complete;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file Trace.h
+ * @author Aaron Stanek
+ * @brief Functions for recording evaluation events
+ * into a ring buffer on each thread, and for decoding
+ * them into a file that trace viewers can read
+*/
+#pragma once
+#include "Globals.h"
+#include <istream>
+#include <ostream>
+
+/// What a TraceEvent records.
+enum class TraceEventKind : uint_least32_t {
+    /// evaluateExpression called a symbol.
+    Call = 0,
+    /// loadUserSymbol copied a definition.
+    Load = 1,
+    /// The innermost Call or Load returned.
+    Return = 2,
+    /// makeCopyFrom copied a string or vector.
+    Copy = 3
+};
+
+/// The number of bits of TraceEvent::word that hold the symbol.
+#define TRACE_SYMBOL_BITS 30
+
+/// One event, 16 bytes, as kept in the ring buffers.
+struct TraceEvent {
+    /// Nanoseconds since startTracing was called.
+    uint_least64_t time;
+    /// The TraceEventKind in the top 2 bits. For Call and Load,
+    /// the index of the symbol name in the names of the thread.
+    uint_least32_t word;
+    /// For Call and Load, the number of arguments.
+    /// For Copy, the number of bytes copied.
+    uint_least32_t size;
+};
+
+bool traceSymbol(const TraceEventKind, const char* const, const size_t, const uint_least32_t) noexcept;
+
+void traceExit() noexcept;
+
+void traceCopy(const size_t) noexcept;
+
+void startTracing();
+
+void stopTracing() noexcept;
+
+void writeTraceFile(std::ostream&);
+
+bool decodeTraceFile(std::istream&, std::ostream&);
+
+/// Records a call or load from when it is created to when it is destroyed,
+/// if tracingEnabled was true when it was created.
+/// If the call could not be recorded, neither is its return.
+struct TraceScope {
+    const bool active;
+    /// @param kind TraceEventKind::Call or TraceEventKind::Load
+    /// @param name the basename of the symbol, not null-terminated
+    /// @param length the length of name
+    /// @param argumentCount the number of arguments passed
+    inline TraceScope(const TraceEventKind kind, const char* const name, const size_t length, const uint_least32_t argumentCount) noexcept
+        : active(tracingEnabled && traceSymbol(kind,name,length,argumentCount)) {};
+    inline ~TraceScope() noexcept {
+        if (active) {
+            traceExit();
+        }
+    };
+};
+
+/// Closes the calls that evaluateExpression opened
+/// one after another, when it returns.
+/// Only the calls that were recorded are counted.
+struct TraceScopes {
+    long count;
+    inline TraceScopes() noexcept : count(0) {};
+    inline ~TraceScopes() noexcept {
+        for (; count > 0; --count) {
+            traceExit();
+        }
+    };
+};
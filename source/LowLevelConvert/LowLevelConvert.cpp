@@ -148,7 +148,7 @@ void convertToStructureString(ManyType& x) {
         return;
     }
     // DataString
-    const std::string& s = x.getDataString();
+    const mtstring& s = x.getDataString();
     if (s.size() == 0) {
         throw UserAlert(UserMessage::StructureStringFormatError,"Empty String");
     }
@@ -0,0 +1,54 @@
+/**
+ * @file AccountedAllocator.h
+ * @author Aaron Stanek
+ * @brief An allocator that records every
+ * allocation in currentMemoryUsage
+*/
+#pragma once
+#include "../Globals/Globals.h"
+
+#include <new>
+
+/// A minimal C++11 allocator.
+/// Every allocation and deallocation is recorded
+/// through recordAllocation and recordDeallocation,
+/// so that the containers used by ManyType
+/// count towards maximumMemory.
+template <typename T>
+struct AccountedAllocator {
+    typedef T value_type;
+    inline AccountedAllocator() noexcept {};
+    template <typename U>
+    inline AccountedAllocator(const AccountedAllocator<U>&) noexcept {};
+    /// @param n the number of objects to allocate space for
+    /// @return uninitialized storage for n objects
+    /// @throw UserAlert if maximumMemory would be exceeded
+    T* allocate(const size_t n) {
+        recordAllocation(n * sizeof(T));
+        try {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        catch (...) {
+            recordDeallocation(n * sizeof(T));
+            throw;
+        }
+    }
+    /// @param p storage returned by allocate
+    /// @param n the same n that was passed to allocate
+    void deallocate(T* const p, const size_t n) noexcept {
+        recordDeallocation(n * sizeof(T));
+        ::operator delete(p);
+    }
+};
+
+/// All AccountedAllocator objects are interchangeable.
+template <typename T, typename U>
+inline bool operator==(const AccountedAllocator<T>&, const AccountedAllocator<U>&) noexcept {
+    return true;
+}
+
+/// All AccountedAllocator objects are interchangeable.
+template <typename T, typename U>
+inline bool operator!=(const AccountedAllocator<T>&, const AccountedAllocator<U>&) noexcept {
+    return false;
+}
@@ -3,6 +3,39 @@
  * @author Aaron Stanek
 */
 #include "ManyType.h"
+#include "../Globals/Trace.h"
+
+/// Allocates the mtstring held by a ManyType object.
+/// The mtstring object itself counts towards maximumMemory,
+/// its characters are counted by AccountedAllocator.
+/// @return a pointer to an empty mtstring
+/// @throw UserAlert if maximumMemory would be exceeded
+mtstring* newAccountedString() {
+    recordAllocation(sizeof(mtstring));
+    try {
+        return new mtstring;
+    }
+    catch (...) {
+        recordDeallocation(sizeof(mtstring));
+        throw;
+    }
+}
+
+/// Allocates the mtvec held by a ManyType object.
+/// The mtvec object itself counts towards maximumMemory,
+/// its elements are counted by AccountedAllocator.
+/// @return a pointer to an empty mtvec
+/// @throw UserAlert if maximumMemory would be exceeded
+mtvec* newAccountedVector() {
+    recordAllocation(sizeof(mtvec));
+    try {
+        return new mtvec;
+    }
+    catch (...) {
+        recordDeallocation(sizeof(mtvec));
+        throw;
+    }
+}
 
 /// Raw copies the bytes from other.
 /// Then default constructs other.
@@ -28,9 +61,11 @@ ManyType::~ManyType() noexcept {
     if ((ManyTypeLabelInt)(label) & (ManyTypeLabelInt)(ManyTypeLabel::Pointer)) {
         if ((ManyTypeLabelInt)(label) & (ManyTypeLabelInt)(ManyTypeLabel::String)) {
             delete value.String;
+            recordDeallocation(sizeof(mtstring));
         }
         else {
             delete value.Vector;
+            recordDeallocation(sizeof(mtvec));
         }
     }
 }
@@ -123,27 +158,27 @@ ftype ManyType::getFtype() const {
     }
 }
 
-/// Creates std::string in this object, if not present.
+/// Creates mtstring in this object, if not present.
 /// If the current value is DataString or StructureString, the value will be unchanged.
 /// Sets label to DataString.
-/// @return reference to the std::string stored by this object.
-std::string& ManyType::putDataString() {
+/// @return reference to the mtstring stored by this object.
+mtstring& ManyType::putDataString() {
     if (label != ManyTypeLabel::DataString) {
         if (label != ManyTypeLabel::StructureString) {
             // this is not a string at all
             // we need to clear the value
             this->~ManyType();
             // and then set up a new string
-            value.String = new std::string;
+            value.String = newAccountedString();
         }
         label = ManyTypeLabel::DataString;
     }
     return *(value.String);
 }
 
-/// @return reference to the std::string stored by this object.
+/// @return reference to the mtstring stored by this object.
 /// @throw ManyTypeAccessError if value is not DataString.
-std::string& ManyType::getDataString() const {
+mtstring& ManyType::getDataString() const {
     if (label != ManyTypeLabel::DataString) {
         throw ManyTypeAccessError();
     }
@@ -163,7 +198,7 @@ mtvec& ManyType::putDataVector() {
             // we need to clear the value
             this->~ManyType();
             // and then set up a new vector
-            value.Vector = new mtvec;
+            value.Vector = newAccountedVector();
         }
         label = ManyTypeLabel::DataVector;
     }
@@ -181,27 +216,27 @@ mtvec& ManyType::getDataVector() const {
     }
 }
 
-/// Creates std::string in this object, if not present.
+/// Creates mtstring in this object, if not present.
 /// If the current value is DataString or StructureString, the value will be unchanged.
 /// Sets label to StructureString.
-/// @return reference to the std::string stored by this object.
-std::string& ManyType::putStructureString() {
+/// @return reference to the mtstring stored by this object.
+mtstring& ManyType::putStructureString() {
     if (label != ManyTypeLabel::StructureString) {
         if (label != ManyTypeLabel::DataString) {
             // this is not a string at all
             // we need to clear the value
             this->~ManyType();
             // and then set up a new string
-            value.String = new std::string;
+            value.String = newAccountedString();
         }
         label = ManyTypeLabel::StructureString;
     }
     return *(value.String);
 }
 
-/// @return reference to the std::string stored by this object.
+/// @return reference to the mtstring stored by this object.
 /// @throw ManyTypeAccessError if value is not StructureString.
-std::string& ManyType::getStructureString() const {
+mtstring& ManyType::getStructureString() const {
     if (label != ManyTypeLabel::StructureString) {
         throw ManyTypeAccessError();
     }
@@ -221,7 +256,7 @@ mtvec& ManyType::putStructureVector() {
             // we need to clear the value
             this->~ManyType();
             // and then set up a new vector
-            value.Vector = new mtvec;
+            value.Vector = newAccountedVector();
         }
         label = ManyTypeLabel::StructureVector;
     }
@@ -261,11 +296,14 @@ void ManyType::makeCopyFrom(const ManyType& other, long recursionJuice) {
             if ((ManyTypeLabelInt)(label) & ~(ManyTypeLabelInt)(ManyTypeLabel::String)) {
                 // value is not string-compatible
                 this->~ManyType();
-                value.String = new std::string;
+                value.String = newAccountedString();
             }
             // at this point, value will be string-compatible
             label = other.label;
             *(value.String) = *(other.value.String);
+            if (tracingEnabled) {
+                traceCopy(value.String->size());
+            }
             break;
         case ManyTypeLabel::DataVector:
         case ManyTypeLabel::StructureVector: {
@@ -275,16 +313,20 @@ void ManyType::makeCopyFrom(const ManyType& other, long recursionJuice) {
             else {
                 --recursionJuice;
             }
+            checkNativeStack();
             if ((ManyTypeLabelInt)(label) & ~(ManyTypeLabelInt)(ManyTypeLabel::Vector)) {
                 // value is not vector-compatible
                 this->~ManyType();
-                value.Vector = new mtvec;
+                value.Vector = newAccountedVector();
             }
             // at this point, value will be vector-compatible
             label = other.label;
             mtvec& destination = *(value.Vector);
             const mtvec& source = *(other.value.Vector);
             destination.resize(source.size());
+            if (tracingEnabled) {
+                traceCopy(source.size() * sizeof(ManyType));
+            }
             for (int_fast32_t i = 0; i < destination.size(); ++i) {
                 destination[i].makeCopyFrom(source[i],recursionJuice);
             }
@@ -6,6 +6,9 @@
 */
 #pragma once
 #include "../Globals/Globals.h"
+#include "AccountedAllocator.h"
+
+#include <functional>
 
 typedef uint_fast8_t ManyTypeLabelInt;
 
@@ -28,26 +31,46 @@ enum class ManyTypeLabel : ManyTypeLabelInt {
     /// \n types not accessible to the user
     StructureExpression = StructureString | StructureVector,
     /// bitmask: string, symbol name
-    /// \n types implemented with std::string
+    /// \n types implemented with mtstring
     String = DataString | StructureString,
     /// bitmask: rowvec, colvec, matrix, function call
-    /// \n types implemented with std::vector
+    /// \n types implemented with mtvec
     Vector = DataVector | StructureVector,
     /// bitmask: string, rowvec, colvec, matrix, symbol name, function call
-    /// \n types implemented with std::string or std::vector
+    /// \n types implemented with mtstring or mtvec
     /// \n indicates that a nontrivial destructor needs to be called upon deletion
     Pointer = String | Vector
 };
 
 class ManyType;
-typedef std::vector<ManyType> mtvec;
+/// The vector type held by ManyType.
+/// Its storage counts towards maximumMemory.
+typedef std::vector<ManyType,AccountedAllocator<ManyType> > mtvec;
+/// The string type held by ManyType.
+/// Its storage counts towards maximumMemory.
+typedef std::basic_string<char,std::char_traits<char>,AccountedAllocator<char> > mtstring;
+
+namespace std {
+    /// Allows mtstring to be used as the key of std::unordered_map.
+    template <>
+    struct hash<mtstring> {
+        /// 64 bit FNV-1a, truncated to size_t.
+        size_t operator()(const mtstring& s) const noexcept {
+            unsigned long long h = 14695981039346656037ULL;
+            for (mtstring::size_type i = 0; i < s.size(); ++i) {
+                h = (h ^ (unsigned char)(s[i])) * 1099511628211ULL;
+            }
+            return (size_t)(h);
+        }
+    };
+}
 
 /// stores one of: bool, long, ftype, string*, vector<ManyType>*
 union ManyTypeUnion {
     bool Bool;
     long Int;
     ftype Ftype;
-    std::string* String;
+    mtstring* String;
     mtvec* Vector;
 };
 
@@ -71,12 +94,12 @@ class ManyType {
     long getInt() const;
     void putFtype(const ftype) noexcept;
     ftype getFtype() const;
-    std::string& putDataString();
-    std::string& getDataString() const;
+    mtstring& putDataString();
+    mtstring& getDataString() const;
     mtvec& putDataVector();
     mtvec& getDataVector() const;
-    std::string& putStructureString();
-    std::string& getStructureString() const;
+    mtstring& putStructureString();
+    mtstring& getStructureString() const;
     mtvec& putStructureVector();
     mtvec& getStructureVector() const;
     void makeCopyFrom(const ManyType&,long);
@@ -3,8 +3,14 @@
  * @author Aaron Stanek
 */
 #include "Symbols.h"
+#include "../Bindings/Bindings.h"
+#include "../Compute/Bytecode.h"
+#include "../Compute/ParameterSlots.h"
+#include "../Compute/Memoize.h"
+#include "../Compute/Reactive.h"
 
-/// A table to record all the overloads of all defined language symbols.
+/// A table to record all the overloads of all defined language symbols,
+/// except those in the constexpr built-in table.
 /// The vector<char> represents a set of overloads of a given basename.
 /// Values >=0 are for user symbols,
 /// the value itself gives the number of arguments.
@@ -12,43 +18,94 @@
 /// Values <=-2 are for built-in symbols,
 /// -(value+2) gives the number of arguments
 /// for a built-in symbol.
-std::unordered_map< std::string, std::vector<char> > overloadsTable;
+std::unordered_map< mtstring, std::vector<char> > overloadsTable;
+
+/// Incremented whenever an entry is added to or removed from
+/// symbolTable, so that cached lookups can be validated.
+/// Overwriting a user symbol does not change this value,
+/// because the SymbolTableElement stays in place.
+unsigned long symbolTableGeneration = 0;
+
+/// Incremented whenever a user symbol is
+/// placed or removed, including overwrites,
+/// so that remembered results can be validated.
+/// Starts at 1, so that 0 never matches it.
+unsigned long userSymbolRevision = 1;
+
+/// The serial of the next UserSymbol.
+unsigned long nextUserSymbolSerial = 0;
+
+/// @return a UserSymbol with a None definition,
+/// no compiled code, and a useCount of 1
+UserSymbol* newUserSymbol() {
+    UserSymbol* user = new UserSymbol;
+    user->compiled = nullptr;
+    user->native = nullptr;
+    user->slots = nullptr;
+    user->memo = nullptr;
+    user->reactive = nullptr;
+    user->serial = nextUserSymbolSerial++;
+    user->useCount = 1;
+    return user;
+}
+
+/// Gives up one ownership of a UserSymbol.
+/// Deletes it, and everything it owns, if there are no owners left.
+/// @param user the UserSymbol to release
+void releaseUserSymbol(UserSymbol* const user) noexcept {
+    if (--(user->useCount) <= 0) {
+        delete user->compiled;
+        delete user->slots;
+        delete user->memo;
+        delete user;
+    }
+}
 
 /// Sets builtIn to false.
-/// Default constructs value.mt in-place.
+/// Takes ownership of user for value.user.
+/// @param user a UserSymbol from newUserSymbol
 /// @warning Calling more than once on a given
 /// object may result in a memory leak.
-/// @warning Attempting to access value.mt without first
+/// @warning Attempting to access value.user without first
 /// calling this method may result in undefined behavior.
-void SymbolTableElement::setAsUserSymbol() noexcept {
+void SymbolTableElement::setAsUserSymbol(UserSymbol* const user) noexcept {
+    value.user = user;
     builtIn = false;
-    new (&(value.mt)) ManyType();
-    // The ManyType constructor is noexcept
-    // and the new isn't allocating any memory
-    // so this function is also noexcept
 }
 
-/// If builtIn is false, it will call value.mt.~ManyType()
-SymbolTableElement::~SymbolTableElement() noexcept {
-    if (!builtIn) {
-        value.mt.~ManyType();
-    }
-}
+/// An entry in symbolTable.
+/// SymbolTableElement does not own value.user,
+/// so the entry does.
+struct SymbolTableEntry {
+    /// Built-in until setAsUserSymbol is called.
+    SymbolTableElement element;
+    inline SymbolTableEntry() noexcept {};
+    SymbolTableEntry(const SymbolTableEntry&) = delete;
+    SymbolTableEntry& operator=(const SymbolTableEntry&) = delete;
+    inline ~SymbolTableEntry() noexcept {
+        if (!element.builtIn) {
+            releaseUserSymbol(element.value.user);
+        }
+    };
+};
 
-/// Records the values of all symbols.
+/// Records the values of all symbols,
+/// except those in the constexpr built-in table.
 /// Keys have the form basename?argCount.
 /// Values are either a DataExpression
 /// or are a StructureVector of the form [expression,varnames...].
 /// The values can never be a StructureString.
-std::unordered_map< std::string, SymbolTableElement > symbolTable;
+/// The keys are not counted towards maximumMemory,
+/// so that looking a symbol up never reaches it.
+std::unordered_map< std::string, SymbolTableEntry > symbolTable;
 
 /// Creates a string of the form baseName?argCount.
 /// @param exactName where the result will be placed
 /// @param baseName the basename of the symbol
 /// @param argCount the number of arguments in the desired overload.
 /// -1 for n-matched symbols.
-void createExactName(std::string& exactName, const std::string& baseName, const unsigned char argCount) {
-    exactName = baseName;
+void createExactName(std::string& exactName, const mtstring& baseName, const unsigned char argCount) {
+    exactName.assign(baseName.data(),baseName.size());
     exactName.push_back('?');
     if (argCount == -1) {
         exactName.push_back('n');
@@ -64,10 +121,12 @@ void createExactName(std::string& exactName, const std::string& baseName, const
 /// if the symbol name is not defined
 SymbolTableElement* getElementFromSymbolTable(const std::string& exactName) noexcept {
     const auto it = symbolTable.find(exactName);
-    return (it == symbolTable.end()) ? nullptr : &(it->second);
+    return (it == symbolTable.end()) ? nullptr : &(it->second.element);
 }
 
-/// Loads a language built-in function into the symbol table.
+/// Loads a language built-in function into the symbol table at runtime.
+/// Built-ins that are known at compile time belong in the
+/// constexpr table in Bindings.cpp instead.
 /// @param baseName the name of the symbol to be created
 /// @param func a pointer to the implementation of the language built-in function
 /// @param argCount the number of arguments accepted by the built-in function
@@ -75,15 +134,16 @@ SymbolTableElement* getElementFromSymbolTable(const std::string& exactName) noex
 /// @see SymbolTableElement
 /// @warning does not check for name conflicts,
 /// may result in undefined behavior if the specific overload already exists
-void placeBuiltInSymbol(const std::string& baseName, const boundFunction func, const char argCount, const unsigned char delayMask) {
+void placeBuiltInSymbol(const mtstring& baseName, const boundFunction func, const char argCount, const unsigned char delayMask) {
     // this happens at the start of the program
     // there shouldn't be any name conflicts
     overloadsTable[baseName].push_back( (argCount == -1) ? -1 : -argCount-2 );
     // overloadsTable[baseName] was created if it didn't already exist
     std::string exactName;
     createExactName(exactName,baseName,argCount);
-    SymbolTableElement& elem = symbolTable[exactName];
+    SymbolTableElement& elem = symbolTable[exactName].element;
     // symbolTable[exactName] will be created at this line
+    ++symbolTableGeneration;
     elem.value.func = func;
     // ok because SymbolTableElement expects
     // to hold a function pointer by default
@@ -96,13 +156,20 @@ void placeBuiltInSymbol(const std::string& baseName, const boundFunction func, c
 /// @param mt the definition of the symbol, must conform to symbolTable structure
 /// @param argCount the number of arguments accepted by the user-defined symbol
 /// @param delayMask the delayMask of the user-defined symbol
+/// @return the UserSymbol now held by the table,
+/// its compiled, slots, and memo fields are nullptr
 /// @see symbolTable
 /// @see SymbolTableElement
 /// @throw UserAlert if the specific overload is a built-in symbol
-void placeUserSymbol(const std::string& baseName, const ManyType& mt, const char argCount, const unsigned char delayMask) {
+UserSymbol& placeUserSymbol(const mtstring& baseName, const ManyType& mt, const char argCount, const unsigned char delayMask) {
     // there might be a name conflict
+    if (readBuiltInSymbol(baseName,argCount)) {
+        throw UserAlert(UserMessage::WriteToBuiltInSymbol,baseName.c_str());
+    }
     std::string exactName;
     createExactName(exactName,baseName,argCount);
+    // the derived variable graph keeps its own copy of the name
+    const mtstring graphName(exactName.c_str());
     // check if a symbol with this name exists
     SymbolTableElement* elem = getElementFromSymbolTable(exactName);
     if (elem) {
@@ -114,28 +181,51 @@ void placeUserSymbol(const std::string& baseName, const ManyType& mt, const char
         // this symbol can be overwritten
         // no need to update overloads
         // it should already be set as a user symbol
+        // the old definition might still be running,
+        // so it gets replaced rather than modified
+        UserSymbol* const user = newUserSymbol();
+        releaseUserSymbol(elem->value.user);
+        elem->value.user = user;
     }
     else {
         // no symbol with this exact name exists
+        // the UserSymbol is made before the entry, so that
+        // running out of memory can't leave an entry
+        // in symbolTable that is built-in with no function
+        UserSymbolOwner user(newUserSymbol());
         overloadsTable[baseName].push_back(argCount);
         // overloadsTable[baseName] was created if it didn't already exist
-        elem = &(symbolTable[exactName]);
-        // symbolTable[exactName] will be created at this line
-        // and elem will not be nullptr
-        elem->setAsUserSymbol();
+        try {
+            elem = &(symbolTable[exactName].element);
+            // symbolTable[exactName] will be created at this line
+            // and elem will not be nullptr
+        }
+        catch (...) {
+            overloadsTable[baseName].pop_back();
+            throw;
+        }
+        ++symbolTableGeneration;
+        // the entry releases it from now on
+        elem->setAsUserSymbol(user.release());
         // mark it so that we can place a ManyType object
         // into the SymbolTableElement value
-        elem->delayMask = delayMask;
     }
+    ++userSymbolRevision;
+    // a redefinition may delay different arguments
+    elem->delayMask = delayMask;
     // now we actually do the copying
-    elem->value.mt = mt;
+    elem->value.user->definition = mt;
+    // derived variables that call this symbol need to be recomputed
+    recordDefinition(*(elem->value.user),graphName,baseName);
+    markDependentsDirty(baseName);
+    return *(elem->value.user);
 }
 
 /// Removes a user-defined overload from the symbol table.
 /// @param baseName the name of the symbol to be removed
 /// @param argCount the number of arguments accepted by the user-defined symbol
 /// @return true if the overload was deleted, false otherwise
-bool removeUserSymbol(const std::string& baseName, const char argCount) {
+bool removeUserSymbol(const mtstring& baseName, const char argCount) {
     std::string exactName;
     createExactName(exactName,baseName,argCount);
     // check if it exists and if we can delete it
@@ -147,7 +237,12 @@ bool removeUserSymbol(const std::string& baseName, const char argCount) {
             return false;
         }
         // it exists and we can delete it
+        forgetDefinition(mtstring(exactName.c_str()));
+        markDependentsDirty(baseName);
+        // the entry releases the UserSymbol
         symbolTable.erase(exactName);
+        ++symbolTableGeneration;
+        ++userSymbolRevision;
         std::vector<char>& vec = overloadsTable.at(baseName);
         // this will not fail because every entry in symbolTable
         // must have a corresponding entry in overloadsTable
@@ -182,7 +277,7 @@ bool removeUserSymbol(const std::string& baseName, const char argCount) {
 /// @param vec a vector onto which the result list will be appended in-place
 /// the values will have the same form as in overloadsTable
 /// @see overloadsTable
-void removeUserSymbolList(const std::string& baseName, std::vector<char>& vec) {
+void removeUserSymbolList(const mtstring& baseName, std::vector<char>& vec) {
     const auto it = overloadsTable.find(baseName);
     if (it != overloadsTable.end()) {
         // baseName is a key in overloadsTable
@@ -197,32 +292,55 @@ void removeUserSymbolList(const std::string& baseName, std::vector<char>& vec) {
     }
 }
 
-/// Returns a reference to the SymbolTableElement corresponding
-/// to the given baseName and argCount.
-/// May return n-match if an exact match is not present.
+/// Finds the SymbolTableElement corresponding
+/// to the given baseName and argCount, without
+/// throwing if there is none, for callers that
+/// only want to know whether a symbol exists.
+/// Exact matches are preferred over n-matches.
+/// Within each kind of match, the constexpr built-in
+/// table is consulted before symbolTable.
 /// @param baseName the baseName to look up
 /// @param argCount the number of arguments of the desired function / variable
-/// @return A reference to a value in symbolTable.
-/// @throw UserAlert if there is no match
-const SymbolTableElement& readSymbol(const std::string& baseName, const char argCount) {
+/// @return A pointer to a value in the built-in table or in symbolTable,
+/// or nullptr if there is no match.
+const SymbolTableElement* findSymbol(const mtstring& baseName, const char argCount) {
+    const BuiltInSymbol* builtIn;
     std::string exactName;
     SymbolTableElement* elem;
     if (argCount >= 0) {
+        builtIn = readBuiltInSymbol(baseName,argCount);
+        if (builtIn) {
+            return &(builtIn->element);
+        }
         createExactName(exactName,baseName,argCount);
         elem = getElementFromSymbolTable(exactName);
         if (elem) {
-            return *elem;
+            return elem;
         }
     }
     // there is not an exact match
     // try using n matched symbol
+    builtIn = readBuiltInSymbol(baseName,-1);
+    if (builtIn) {
+        return &(builtIn->element);
+    }
     createExactName(exactName,baseName,-1);
-    elem = getElementFromSymbolTable(exactName);
+    return getElementFromSymbolTable(exactName);
+}
+
+/// Returns a reference to the SymbolTableElement corresponding
+/// to the given baseName and argCount, as found by findSymbol.
+/// @param baseName the baseName to look up
+/// @param argCount the number of arguments of the desired function / variable
+/// @return A reference to a value in the built-in table or in symbolTable.
+/// @throw UserAlert if there is no match
+const SymbolTableElement& readSymbol(const mtstring& baseName, const char argCount) {
+    const SymbolTableElement* const elem = findSymbol(baseName,argCount);
     if (elem) {
         return *elem;
     }
     // there is no match
-    if (overloadsTable.count(baseName)) {
+    if (overloadsTable.count(baseName) || isBuiltInBaseName(baseName)) {
         // there is at least one overload for the baseName,
         // just not any that match here
         throw UserAlert(UserMessage::WrongNumberOfArguments,baseName.c_str());
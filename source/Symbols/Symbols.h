@@ -11,6 +11,10 @@
 #include "../ManyType/ManyType.h"
 
 #include <unordered_map>
+#include <vector>
+
+extern unsigned long symbolTableGeneration;
+extern unsigned long userSymbolRevision;
 
 /// A type suitable to reference all of the language
 /// built-in functions.
@@ -20,29 +24,117 @@
 /// in the computation.
 typedef void (*boundFunction)(ManyType&,mtvec&,long);
 
+/// A built-in function specialized for arguments of certain types.
+/// The argument is the first of the arguments, which are
+/// next to each other. The result replaces the first argument.
+/// Returns false without changing anything if
+/// the arguments are not of the expected types.
+typedef bool (*quickenedFunction)(ManyType*);
+
+struct CompiledFunction;
+struct ParameterSlots;
+struct MemoTable;
+struct ReactiveNode;
+
+/// The definition of a user-defined symbol.
+/// Shared by its SymbolTableElement and by any
+/// evaluation that is currently reading it,
+/// so that redefining a symbol while it is running is safe.
+struct UserSymbol {
+    /// Either a DataExpression or a StructureVector
+    /// of the form [expression,varnames...].
+    ManyType definition;
+    /// Bytecode for definition, or nullptr
+    /// if definition was not compiled.
+    CompiledFunction* compiled;
+    /// Machine code for definition made by native(), or nullptr.
+    /// Used in place of compiled and slots when set.
+    /// Atomic, because native() may set it while other threads read it.
+    std::atomic<boundFunction> native;
+    /// The local variable names in definition,
+    /// or nullptr if they are looked up by name.
+    ParameterSlots* slots;
+    /// Remembered results, or nullptr if
+    /// definition is not a pure function.
+    MemoTable* memo;
+    /// Indexed by argument number, counting from 1.
+    /// True for the parameters declared as lazy(name),
+    /// which are passed as written and evaluated by their first use.
+    /// Empty if there are none.
+    std::vector<bool> lazyParameters;
+    /// The node of this symbol in the dependency graph,
+    /// shared with later definitions of the same overload,
+    /// or nullptr if the graph could not record it.
+    ReactiveNode* reactive;
+    /// Unique to this object, never reused.
+    unsigned long serial;
+    /// The number of owners of this object.
+    /// Atomic, because worker threads hold it too.
+    std::atomic<long> useCount;
+};
+
+UserSymbol* newUserSymbol();
+
+void releaseUserSymbol(UserSymbol* const) noexcept;
+
+/// Keeps a UserSymbol alive for the lifetime of this object.
+struct UserSymbolHold {
+    UserSymbol* const user;
+    inline explicit UserSymbolHold(UserSymbol* const u) noexcept : user(u) {
+        ++(u->useCount);
+    };
+    inline ~UserSymbolHold() noexcept {
+        releaseUserSymbol(user);
+    };
+};
+
+/// Owns a UserSymbol until it is given away,
+/// releasing it if that never happens.
+struct UserSymbolOwner {
+    /// nullptr once given away.
+    UserSymbol* user;
+    /// @param u a UserSymbol from newUserSymbol, or nullptr
+    inline explicit UserSymbolOwner(UserSymbol* const u) noexcept : user(u) {};
+    UserSymbolOwner(const UserSymbolOwner&) = delete;
+    UserSymbolOwner& operator=(const UserSymbolOwner&) = delete;
+    inline ~UserSymbolOwner() noexcept {
+        if (user) {
+            releaseUserSymbol(user);
+        }
+    };
+    /// Gives the UserSymbol away.
+    /// @return the UserSymbol, now owned by the caller
+    inline UserSymbol* release() noexcept {
+        UserSymbol* const u = user;
+        user = nullptr;
+        return u;
+    };
+};
+
 /// A type to hold either a pointer to a language
-/// built-in function, or a user-defined ManyType object.
+/// built-in function, or a user-defined symbol.
+/// Both members are pointers so that built-in symbols
+/// can be declared in a constexpr table.
 union SymbolTableElementUnion {
     /// A pointer to a language built-in function.
     boundFunction func;
-    /// A user-defined ManyType object.
-    /// @warning must be constructed before use.
-    /// @warning must be destructed before deletion.
-    ManyType mt;
+    /// A pointer to a user-defined symbol.
+    /// @warning must be allocated before use.
+    /// @warning must be released by the owner of the table entry,
+    /// see UserSymbolOwner.
+    UserSymbol* user;
     /// Trivial constructor.
-    /// @warning Does not construct a ManyType
-    /// object, even if we expect mt to be defined.
-    inline SymbolTableElementUnion() noexcept {};
-    /// Trivial destructor.
-    /// @warning Does not call ManyType destructor,
-    /// even if mt is defined.
-    inline ~SymbolTableElementUnion() noexcept {};
+    /// @warning Does not define either member.
+    SymbolTableElementUnion() = default;
+    /// Defines func.
+    constexpr SymbolTableElementUnion(const boundFunction f) noexcept : func(f) {};
 };
 
 /// The value type of the table of symbols.
 /// Uses SymbolTableElementUnion to hold
 /// either a pointer to a built-in function,
-/// or a user-defined ManyType object.
+/// or a pointer to a user-defined symbol.
+/// This is a literal type, it does not own value.user.
 struct SymbolTableElement {
     /// The value held by this element.
     SymbolTableElementUnion value;
@@ -53,7 +145,7 @@ struct SymbolTableElement {
     unsigned char delayMask;
     /// Indicates if this object holds a pointer to a language built-in symbol.
     /// If true, value.func is defined.
-    /// If false, value.mt is defined.
+    /// If false, value.user is defined.
     bool builtIn;
     /// Default constructor.
     /// Sets builtIn to true, but does not define value.func
@@ -62,16 +154,57 @@ struct SymbolTableElement {
     inline SymbolTableElement() noexcept {
         builtIn = true;
     };
-    void setAsUserSymbol() noexcept;
-    ~SymbolTableElement() noexcept;
+    /// Built-in constructor.
+    /// Usable in constant expressions.
+    /// @param func the implementation of the language built-in function
+    /// @param mask the delayMask of the language built-in function
+    constexpr SymbolTableElement(const boundFunction func, const unsigned char mask) noexcept :
+        value(func), delayMask(mask), builtIn(true) {};
+    void setAsUserSymbol(UserSymbol* const) noexcept;
 };
 
-void placeBuiltInSymbol(const std::string&, const boundFunction, const char, const unsigned char);
+/// @param symbol the symbol being called
+/// @param i the index of an argument, counting from 1
+/// @return true if the argument should be left unevaluated
+/// when passed to symbol, either because symbol delays it
+/// or because it is a lazy parameter of symbol
+inline bool passesAsWritten(const SymbolTableElement& symbol, const uint_least32_t i) noexcept {
+    if (i <= 8 && ( (symbol.delayMask >> (i-1)) & 0x01 )) {
+        return true;
+    }
+    if (symbol.builtIn) {
+        return false;
+    }
+    const std::vector<bool>& lazy = symbol.value.user->lazyParameters;
+    return i < lazy.size() && lazy[i];
+}
+
+/// An entry in the table of language built-in symbols.
+/// The table is defined in Bindings.cpp and is
+/// fixed at compile time.
+struct BuiltInSymbol {
+    /// The basename of the symbol.
+    const char* baseName;
+    /// The number of arguments accepted,
+    /// -1 for n-matched symbols.
+    char argCount;
+    /// The function pointer and delayMask.
+    SymbolTableElement element;
+    /// True if the result depends only on the arguments
+    /// and calling it changes nothing else.
+    /// Functions that assign symbols, report on the
+    /// interpreter, or produce random values are not pure.
+    bool pure;
+};
+
+void placeBuiltInSymbol(const mtstring&, const boundFunction, const char, const unsigned char);
+
+UserSymbol& placeUserSymbol(const mtstring&, const ManyType&, const char, const unsigned char);
 
-void placeUserSymbol(const std::string&, const ManyType&, const char, const unsigned char);
+bool removeUserSymbol(const mtstring&, const char);
 
-bool removeUserSymbol(const std::string&, const char);
+void removeUserSymbolList(const mtstring&, std::vector<char>&);
 
-void removeUserSymbolList(const std::string&, std::vector<char>&);
+const SymbolTableElement* findSymbol(const mtstring&, const char);
 
-const SymbolTableElement& readSymbol(const std::string&, const char);
\ No newline at end of file
+const SymbolTableElement& readSymbol(const mtstring&, const char);
\ No newline at end of file
@@ -5,14 +5,21 @@
 #include "Globals/StaticAssert.h"
 // also includes Globals.h
 
+#include <atomic>
 #include <iostream>
+#include <sstream>
 
 #include "ManyType/ManyType.h"
 #include "Symbols/Symbols.h"
 #include "LowLevelConvert/LowLevelConvert.h"
 #include "Bindings/Bindings.h"
 #include "Compute/EvaluateExpression.h"
+#include "Compute/Bytecode.h"
+#include "Compute/Memoize.h"
 #include "Lexer/Lexer.h"
+#include "Compute/AsyncEvaluation.h"
+#include "Compute/Profiler.h"
+#include "Globals/Trace.h"
 
 #include "Globals/RNG.h"
 
@@ -86,14 +93,789 @@ void test_lexer(const char* z) {
         print_lexer_tokens(lex);
     }
     catch (UserAlert& e) {
-        std::cout << e.message << std::endl;
+        std::cout << e.what() << std::endl;
     }
 }
 
-int main() {
+/// @return a symbol name, for building test expressions
+ManyType symbol(const char* name) {
+    ManyType x;
+    x.putStructureString() = name;
+    return x;
+}
+
+/// @return a bool, for building test expressions
+ManyType boolean(const bool b) {
+    ManyType x;
+    x.putBool(b);
+    return x;
+}
+
+/// @return an int, for building test expressions
+ManyType integer(const long n) {
+    ManyType x;
+    x.putInt(n);
+    return x;
+}
+
+/// @return a float, for building test expressions
+ManyType real(const ftype f) {
+    ManyType x;
+    x.putFtype(f);
+    return x;
+}
+
+void appendArguments(mtvec&) noexcept {}
+
+template <typename... Rest>
+void appendArguments(mtvec& vec, ManyType first, Rest... rest) {
+    vec.resize(vec.size() + 1);
+    vec.back() = first;
+    appendArguments(vec,rest...);
+}
+
+/// @return a function call, for building test expressions
+template <typename... Arguments>
+ManyType call(const char* name, Arguments... arguments) {
+    ManyType x;
+    mtvec& vec = x.putStructureVector();
+    vec.resize(1);
+    vec[0] = symbol(name);
+    appendArguments(vec,arguments...);
+    return x;
+}
+
+/// Evaluates an expression, and reports
+/// whether it has the expected value.
+void test_value(const char* description, ManyType expression, ManyType expected) {
+    try {
+        startProcessing();
+        evaluateExpression(expression,maximumRecursionDepth);
+        if (sameValue(expression,expected,maximumRecursionDepth)) {
+            std::cout << description << ": ok" << std::endl;
+        }
+        else {
+            std::cout << description << ": Unexpected Value" << std::endl;
+        }
+    }
+    catch (UserAlert& e) {
+        std::cout << description << ": Unexpected Alert: " << e.what() << std::endl;
+    }
+}
+
+/// Evaluates an expression, and reports
+/// whether it raises the expected alert.
+void test_alert(const char* description, ManyType expression, const UserMessage expected) {
+    try {
+        startProcessing();
+        evaluateExpression(expression,maximumRecursionDepth);
+        std::cout << description << ": No Alert" << std::endl;
+    }
+    catch (UserAlert& e) {
+        if (e.base == expected) {
+            std::cout << description << ": ok" << std::endl;
+        }
+        else {
+            std::cout << description << ": Unexpected Alert: " << e.what() << std::endl;
+        }
+    }
+}
+
+/// Reports whether a user-defined function was compiled to bytecode.
+void test_compiled(const char* description, const char* baseName, const char argCount, const bool expected) {
+    try {
+        const SymbolTableElement& symbol = readSymbol(baseName,argCount);
+        const bool compiled = !symbol.builtIn && symbol.value.user->compiled != nullptr;
+        std::cout << description << ((compiled == expected) ? ": ok" : ": Unexpected Compilation") << std::endl;
+    }
+    catch (UserAlert& e) {
+        std::cout << description << ": Unexpected Alert: " << e.what() << std::endl;
+    }
+}
+
+void test_bytecode() {
+    test_value("define sum3",call("arrow",call("sum3",symbol("x"),symbol("y"),symbol("z")),
+        call("add",call("add",symbol("x"),symbol("y")),symbol("z"))),ManyType());
+    test_compiled("sum3 compiled","sum3",3,true);
+    test_value("sum3",call("sum3",integer(1),integer(2),integer(3)),real(6));
+    // a call from one compiled function to another
+    test_value("define twice",call("arrow",call("twice",symbol("x")),
+        call("sum3",symbol("x"),symbol("x"),integer(0))),ManyType());
+    test_compiled("twice compiled","twice",1,true);
+    test_value("twice",call("twice",integer(4)),real(8));
+    test_value("twice nested",call("twice",call("twice",integer(4))),real(16));
+    // alerts raised inside of the VM
+    ManyType text;
+    text.putDataString() = "a";
+    test_alert("sum3 type",call("sum3",integer(1),integer(2),text),UserMessage::UnexpectedType);
+    test_alert("sum3 arguments",call("sum3",integer(1),integer(2)),UserMessage::WrongNumberOfArguments);
+    // functions with delayed arguments are looked up by name instead
+    test_value("define apply",call("arrow",call("apply",symbol("%m"),symbol("x")),call("%m",symbol("x"))),ManyType());
+    test_compiled("apply not compiled","apply",2,false);
+    test_value("apply",call("apply",symbol("twice"),integer(5)),real(10));
+}
+
+/// Evaluates an expression, and describes its value or the alert it raised.
+/// @param value where the value is placed
+/// @return the text of the alert, or an empty string if there was none
+std::string evaluate_outcome(ManyType expression, ManyType& value) {
+    try {
+        startProcessing();
+        evaluateExpression(expression,maximumRecursionDepth);
+        value = expression;
+        return "";
+    }
+    catch (UserAlert& e) {
+        return e.what();
+    }
+}
+
+/// Calls a built-in function directly, and from a compiled function
+/// whose call to it has been quickened for the types of the arguments of warm,
+/// and reports whether both give the same value or the same alert.
+/// @param warm a call of the same built-in function,
+/// made QUICKEN_AFTER_CALLS times first
+/// @param expression the call that is compared
+void test_quickened(const char* description, ManyType warm, ManyType expression) {
+    // qk(a1,a2,...) calls the built-in function with its arguments
+    const mtvec& vec = expression.getStructureVector();
+    ManyType head = call("qk");
+    ManyType body;
+    body.makeCopyFrom(head,maximumRecursionDepth);
+    body.getStructureVector()[0] = vec[0];
+    for (uint_least32_t i = 1; i < vec.size(); ++i) {
+        const std::string name = "a" + std::to_string(i);
+        appendArguments(head.getStructureVector(),symbol(name.c_str()));
+        appendArguments(body.getStructureVector(),symbol(name.c_str()));
+    }
+    ManyType ignored;
+    evaluate_outcome(call("arrow",head,body),ignored);
+    // the first call specializes qk for the types it was given,
+    // and the ones after it quicken the call if that could not
+    for (int i = 0; i < QUICKEN_AFTER_CALLS; ++i) {
+        ManyType warmCall;
+        warmCall.makeCopyFrom(warm,maximumRecursionDepth);
+        warmCall.getStructureVector()[0] = symbol("qk");
+        evaluate_outcome(warmCall,ignored);
+    }
+    ManyType compiledCall, generic, quickened;
+    compiledCall.makeCopyFrom(expression,maximumRecursionDepth);
+    compiledCall.getStructureVector()[0] = symbol("qk");
+    const std::string quickenedAlert = evaluate_outcome(compiledCall,quickened);
+    const std::string genericAlert = evaluate_outcome(expression,generic);
+    if (quickenedAlert != genericAlert) {
+        std::cout << description << ": Unexpected Alert: " << quickenedAlert << std::endl;
+    }
+    else if (genericAlert.empty() && !sameValue(quickened,generic,maximumRecursionDepth)) {
+        std::cout << description << ": Unexpected Value" << std::endl;
+    }
+    else {
+        std::cout << description << ": ok" << std::endl;
+    }
+}
+
+/// Reports whether quickened calls behave as the built-in functions they replace.
+/// @param description what is tested
+/// @param expression a call of a built-in function
+void test_quickened(const char* description, ManyType expression) {
+    ManyType warm;
+    warm.makeCopyFrom(expression,maximumRecursionDepth);
+    test_quickened(description,warm,expression);
+}
+
+void test_quickening() {
+    // each result is computed, not remembered
+    const long memoizedResults = maximumMemoizedResults;
+    newMaximumMemoizedResults = MIN_maximumMemoizedResults;
+    applyNewLimits();
+    ManyType text;
+    text.putDataString() = "a";
+    test_quickened("quickened add int int",call("add",integer(2),integer(3)));
+    test_quickened("quickened add int float",call("add",integer(2),real(0.5)));
+    test_quickened("quickened add float int",call("add",real(0.5),integer(2)));
+    test_quickened("quickened sub float float",call("sub",real(0.5),real(2.25)));
+    test_quickened("quickened add infinity",call("add",real(1.7e308),real(1.7e308)));
+    test_quickened("quickened sub infinity",call("sub",real(-1.7e308),integer(1)),call("sub",real(-1.7e308),real(1.7e308)));
+    test_quickened("quickened float int",call("float",integer(-4)));
+    test_quickened("quickened float bool",call("float",boolean(true)));
+    test_quickened("quickened float float",call("float",real(2.5)));
+    test_quickened("quickened int float",call("int",real(-2.75)));
+    test_quickened("quickened int float range",call("int",real(1e300)));
+    test_quickened("quickened int bool",call("int",boolean(true)));
+    test_quickened("quickened int int",call("int",integer(7)));
+    test_quickened("quickened bool int",call("bool",integer(3)));
+    test_quickened("quickened bool int zero",call("bool",integer(0)));
+    test_quickened("quickened bool bool",call("bool",boolean(false)));
+    // the guard fails, and the call is made as it would have been
+    test_quickened("quickened add guard",call("add",integer(2),integer(3)),call("add",boolean(true),integer(3)));
+    test_quickened("quickened add vector",call("add",integer(2),integer(3)),call("add",call("rowvec",integer(1),integer(2)),integer(3)));
+    test_quickened("quickened add text",call("add",real(2),integer(3)),call("add",text,integer(3)));
+    test_quickened("quickened int guard",call("int",real(2.5)),call("int",ManyType()));
+    test_quickened("quickened bool guard",call("bool",integer(2)),call("bool",real(0.5)));
+    test_quickened("quickened float guard",call("float",integer(2)),call("float",text));
+    test_value("remove qk",call("remove",symbol("qk")),integer(2));
+    newMaximumMemoizedResults = memoizedResults;
+    applyNewLimits();
+}
+
+void test_memoization() {
+    test_value("define sq",call("arrow",call("sq",symbol("x")),call("add",symbol("x"),symbol("x"))),ManyType());
+    test_value("sq",call("sq",integer(3)),real(6));
+    test_value("sq remembered",call("sq",integer(3)),real(6));
+    // redefining a function forgets what it returned
+    test_value("redefine sq",call("arrow",call("sq",symbol("x")),call("add",symbol("x"),integer(1))),ManyType());
+    test_value("sq redefined",call("sq",integer(3)),real(4));
+    // and what the functions that call it returned
+    test_value("define outer",call("arrow",call("outer",symbol("x")),call("sq",symbol("x"))),ManyType());
+    test_value("outer",call("outer",integer(3)),real(4));
+    test_value("redefine sq again",call("arrow",call("sq",symbol("x")),call("sub",symbol("x"),integer(1))),ManyType());
+    test_value("outer redefined",call("outer",integer(3)),real(2));
+    // and what depended on a variable that was assigned or redefined
+    test_value("define k",call("assign",symbol("k"),integer(10)),integer(10));
+    test_value("define addk",call("arrow",call("addk",symbol("x")),call("add",symbol("x"),symbol("k"))),ManyType());
+    test_value("addk",call("addk",integer(1)),real(11));
+    test_value("assign k",call("assign",symbol("k"),integer(20)),integer(20));
+    test_value("addk assigned",call("addk",integer(1)),real(21));
+    test_value("redefine k",call("arrow",call("k"),integer(30)),ManyType());
+    test_value("addk redefined",call("addk",integer(1)),real(31));
+    test_value("remove k",call("remove",symbol("k")),integer(1));
+    test_alert("addk removed",call("addk",integer(1)),UserMessage::UnknownSymbol);
+}
+
+void test_parallel_arguments() {
+    const long workerThreads = maximumWorkerThreads;
+    newMaximumWorkerThreads = 3;
+    applyNewLimits();
+    ManyType text;
+    text.putDataString() = "a";
+    test_value("define fine",call("arrow",call("fine",symbol("x")),call("add",symbol("x"),integer(1))),ManyType());
+    // fails slowly, so that an argument after it fails first
+    test_value("define badtype",call("arrow",call("badtype",symbol("n")),
+        call("if",call("bool",symbol("n")),call("badtype",call("sub",symbol("n"),integer(1))),call("add",symbol("n"),text))),ManyType());
+    test_value("define badinf",call("arrow",call("badinf",symbol("x")),call("add",symbol("x"),real(1.7e308))),ManyType());
+    ManyType row = call("rowvec",real(2),real(3),real(4),real(5));
+    evaluateExpression(row,maximumRecursionDepth);
+    test_value("parallel",call("rowvec",call("fine",integer(1)),call("fine",integer(2)),call("fine",integer(3)),call("fine",integer(4))),row);
+    // the alert of the first argument that fails is raised,
+    // as it would be if they were evaluated one at a time
+    for (int i = 0; i < 10; ++i) {
+        test_alert("parallel first alert",call("rowvec",call("fine",integer(1)),call("badtype",integer(3000)),
+            call("badinf",real(1.7e308)),call("fine",integer(2))),UserMessage::UnexpectedType);
+        test_alert("parallel first alert swapped",call("rowvec",call("fine",integer(1)),call("badinf",real(1.7e308)),
+            call("badtype",integer(3000)),call("fine",integer(2))),UserMessage::InfinityError);
+    }
+    newMaximumWorkerThreads = workerThreads;
+    applyNewLimits();
+}
+
+void test_reactive() {
+    test_value("reactive on",call("reactive",boolean(true)),boolean(true));
+    test_value("define input",call("assign",symbol("input"),integer(1)),integer(1));
+    // read directly
+    test_value("define ra",call("arrow",call("ra"),call("add",symbol("input"),integer(1))),ManyType());
+    test_value("define rb",call("arrow",call("rb"),call("add",symbol("ra"),integer(1))),ManyType());
+    test_value("define rc",call("arrow",call("rc"),call("add",symbol("rb"),integer(1))),ManyType());
+    test_value("rc",symbol("rc"),real(4));
+    test_value("assign input",call("assign",symbol("input"),integer(5)),integer(5));
+    test_value("rc indirect",symbol("rc"),real(8));
+    test_value("rb indirect",symbol("rb"),real(7));
+    // read through functions, and never directly
+    test_value("define rd",call("arrow",call("rd"),call("add",symbol("input"),integer(1))),ManyType());
+    test_value("define rf",call("arrow",call("rf",symbol("x")),symbol("rd")),ManyType());
+    test_value("define rg",call("arrow",call("rg",symbol("x")),call("rf",symbol("x"))),ManyType());
+    test_value("define re",call("arrow",call("re"),call("rg",integer(0))),ManyType());
+    test_value("re",symbol("re"),real(6));
+    test_value("assign input again",call("assign",symbol("input"),integer(9)),integer(9));
+    test_value("re through functions",symbol("re"),real(10));
+    // redefinitions
+    test_value("redefine rd",call("arrow",call("rd"),call("sub",symbol("input"),integer(1))),ManyType());
+    test_value("re rd redefined",symbol("re"),real(8));
+    test_value("redefine ra",call("arrow",call("ra"),call("sub",symbol("input"),integer(1))),ManyType());
+    test_value("rc ra redefined",symbol("rc"),real(10));
+    test_value("redefine rf",call("arrow",call("rf",symbol("x")),call("add",symbol("rd"),integer(100))),ManyType());
+    test_value("re rf redefined",symbol("re"),real(108));
+    test_value("redefine input",call("arrow",call("input"),integer(2)),ManyType());
+    test_value("re input redefined",symbol("re"),real(101));
+    test_value("rc input redefined",symbol("rc"),real(3));
+    test_value("reactive off",call("reactive",boolean(false)),boolean(false));
+}
+
+/// Defines side(x), which adds x to count and returns count,
+/// so that tests can see whether an argument was evaluated.
+void define_side() {
+    test_value("define count",call("assign",symbol("count"),integer(0)),integer(0));
+    test_value("define side",call("arrow",call("side",symbol("x")),
+        call("assign",symbol("count"),call("add",symbol("count"),symbol("x")))),ManyType());
+}
+
+void test_lazy_parameters() {
+    define_side();
+    test_value("define lz",call("arrow",call("lz",call("lazy",symbol("a")),symbol("b")),
+        call("if",symbol("b"),call("add",symbol("a"),symbol("a")),integer(0))),ManyType());
+    // a branch that is not taken doesn't evaluate the lazy argument
+    test_value("lz skipped",call("lz",call("side",integer(7)),call("false")),integer(0));
+    test_value("lz skipped count",symbol("count"),integer(0));
+    test_value("lz undefined skipped",call("lz",symbol("undefinedthing"),call("false")),integer(0));
+    // a branch that is taken evaluates it once, for both uses
+    test_value("lz taken",call("lz",call("side",integer(7)),call("true")),real(14));
+    test_value("lz taken count",symbol("count"),real(7));
+    test_alert("lz undefined taken",call("lz",symbol("undefinedthing"),call("true")),UserMessage::UnknownSymbol);
+    // shared between a branch and a later use
+    test_value("define lm",call("arrow",call("lm",call("lazy",symbol("a")),symbol("b")),
+        call("add",call("if",symbol("b"),symbol("a"),integer(0)),symbol("a"))),ManyType());
+    test_value("lm",call("lm",call("side",integer(5)),call("true")),real(24));
+    test_value("lm count",symbol("count"),real(12));
+    // passed along by tail calls, and evaluated once at the end
+    test_value("define lp",call("arrow",call("lp",call("lazy",symbol("a")),symbol("n")),
+        call("if",call("bool",symbol("n")),call("lp",symbol("a"),call("sub",symbol("n"),integer(1))),symbol("a"))),ManyType());
+    test_value("lp",call("lp",call("side",integer(3)),integer(100)),real(15));
+    test_value("lp count",symbol("count"),real(15));
+}
+
+void test_short_circuit() {
+    define_side();
+    // the skipped operand would raise an alert, or add to count
+    test_value("if skipped",call("if",call("false"),symbol("undefinedthing")),ManyType());
+    test_value("if else skipped",call("if",call("true"),integer(1),call("side",integer(1))),integer(1));
+    test_value("if then skipped",call("if",call("false"),call("side",integer(1)),integer(2)),integer(2));
+    test_value("and skipped",call("and",call("false"),symbol("undefinedthing")),boolean(false));
+    test_value("or skipped",call("or",call("true"),symbol("undefinedthing")),boolean(true));
+    test_value("and or count",symbol("count"),integer(0));
+    // through lazy parameters
+    test_value("define g",call("arrow",call("g",call("lazy",symbol("a")),symbol("b")),
+        call("and",symbol("b"),call("bool",symbol("a")))),ManyType());
+    test_value("define h",call("arrow",call("h",call("lazy",symbol("a")),symbol("b")),
+        call("or",symbol("b"),call("bool",symbol("a")))),ManyType());
+    test_value("define k",call("arrow",call("k",call("lazy",symbol("a")),symbol("b")),
+        call("if",symbol("b"),integer(0),symbol("a"))),ManyType());
+    test_value("g skipped",call("g",call("side",integer(9)),call("false")),boolean(false));
+    test_value("h skipped",call("h",call("side",integer(9)),call("true")),boolean(true));
+    test_value("k skipped",call("k",call("side",integer(9)),call("true")),integer(0));
+    test_value("g h k skipped count",symbol("count"),integer(0));
+    test_value("g taken",call("g",call("side",integer(9)),call("true")),boolean(true));
+    test_value("g taken count",symbol("count"),real(9));
+}
+
+/// @return a list of types as infer describes them, for building expected values
+ManyType types(const char* description) {
+    ManyType x;
+    x.putDataString() = description;
+    return x;
+}
+
+void test_type_inference() {
+    // built-in functions that broadcast
+    test_value("infer add",call("infer",call("add",symbol("int"),symbol("int"))),types("Float"));
+    test_value("infer add vector",call("infer",call("add",symbol("vector"),symbol("int"))),types("Vector"));
+    test_value("infer add any",call("infer",call("add",symbol("any"),symbol("int"))),types("Float|Vector"));
+    test_value("infer int",call("infer",call("int",symbol("float"))),types("Int"));
+    test_value("infer rowvec",call("infer",call("rowvec",symbol("int"),symbol("float"))),types("Vector"));
+    test_value("infer if",call("infer",call("if",symbol("bool"),symbol("int"),symbol("float"))),types("Int|Float"));
+    // user-defined functions and variables, as they are defined now
+    test_value("define tinc",call("arrow",call("tinc",symbol("x")),call("add",symbol("x"),integer(1))),ManyType());
+    test_value("define tmaybe",call("arrow",call("tmaybe",symbol("b")),call("if",symbol("b"),call("int",real(2.5)))),ManyType());
+    test_value("define tvar",call("assign",symbol("tvar"),real(1.5)),real(1.5));
+    test_value("infer tinc",call("infer",call("tinc",symbol("int"))),types("Float"));
+    test_value("infer tinc vector",call("infer",call("tinc",symbol("vector"))),types("Vector"));
+    test_value("infer tmaybe",call("infer",call("tmaybe",symbol("bool"))),types("None|Int"));
+    test_value("infer tvar",call("infer",symbol("tvar")),types("Float"));
+    // recursive calls are followed until their types stop growing
+    test_value("define trec",call("arrow",call("trec",symbol("n")),
+        call("if",call("bool",symbol("n")),call("add",call("trec",call("sub",symbol("n"),integer(1))),integer(1)),integer(0))),ManyType());
+    test_value("define tcycle",call("arrow",call("tcycle",symbol("n")),call("tcycle",symbol("n"))),ManyType());
+    test_value("infer trec",call("infer",call("trec",symbol("int"))),types("Int|Float"));
+    test_value("infer tcycle",call("infer",call("tcycle",symbol("int"))),types("Nothing"));
+    // nothing is evaluated
+    define_side();
+    test_value("infer side",call("infer",call("side",symbol("int"))),types("Float"));
+    test_value("infer side count",symbol("count"),integer(0));
+    test_alert("infer unknown",call("infer",call("nothing",symbol("int"))),UserMessage::UnknownSymbol);
+    test_alert("infer not a type",call("infer",call("add",symbol("potato"),symbol("int"))),UserMessage::UnexpectedType);
+}
+
+/// Evaluates an expression, so that it can be
+/// the expected value of a test.
+ManyType evaluated(ManyType expression) {
+    evaluateExpression(expression,maximumRecursionDepth);
+    return expression;
+}
+
+void test_broadcasting() {
+    test_value("broadcast scalar",call("add",call("rowvec",integer(1),integer(2)),integer(10)),
+        evaluated(call("rowvec",real(11),real(12))));
+    test_value("broadcast row column",call("add",call("rowvec",integer(1),integer(2),integer(3)),call("colvec",integer(10),integer(20))),
+        evaluated(call("matrix",call("rowvec",real(11),real(12),real(13)),call("rowvec",real(21),real(22),real(23)))));
+    test_value("broadcast length 1",call("sub",call("colvec",integer(5),integer(6)),call("colvec",integer(1))),
+        evaluated(call("colvec",real(4),real(5))));
+    test_value("broadcast unary",call("bool",call("rowvec",integer(0),integer(2))),
+        evaluated(call("rowvec",boolean(false),boolean(true))));
+    // dimensions that are neither the same nor 1
+    test_alert("broadcast columns mismatch",call("add",call("rowvec",integer(1),integer(2),integer(3)),call("rowvec",integer(1),integer(2))),UserMessage::ShapeMismatch);
+    test_alert("broadcast rows mismatch",call("sub",call("colvec",integer(1),integer(2)),call("colvec",integer(1),integer(2),integer(3))),UserMessage::ShapeMismatch);
+    test_alert("broadcast matrix mismatch",call("add",call("matrix",call("rowvec",integer(1),integer(2)),call("rowvec",integer(3),integer(4))),
+        call("rowvec",integer(1),integer(2),integer(3))),UserMessage::ShapeMismatch);
+    test_alert("matrix ragged",call("matrix",call("rowvec",integer(1),integer(2)),call("rowvec",integer(3))),UserMessage::ShapeMismatch);
+    // a ragged matrix that was not made by the matrix function
+    ManyType ragged;
+    mtvec& rows = ragged.putDataVector();
+    rows.resize(3);
+    rows[0].putStructureString() = "matrix";
+    rows[1] = evaluated(call("rowvec",integer(1),integer(2)));
+    rows[2] = evaluated(call("rowvec",integer(3)));
+    test_alert("broadcast ragged",call("add",ragged,integer(1)),UserMessage::ShapeMismatch);
+    // elements and rows of the wrong type
+    ManyType text;
+    text.putDataString() = "a";
+    test_alert("rowvec text",call("rowvec",integer(1),text),UserMessage::UnexpectedType);
+    test_alert("matrix of colvec",call("matrix",call("colvec",integer(1),integer(2))),UserMessage::UnexpectedType);
+}
+
+/// @return a rowvec of 300 elements that efail accepts, except
+/// for the 6th and the 251st, which are first and second.
+/// They are far enough apart to be in different chunks.
+ManyType failing_row(const long first, const long second) {
+    ManyType row = call("rowvec");
+    for (long i = 0; i < 300; ++i) {
+        appendArguments(row.getStructureVector(),integer((i == 5) ? first : (i == 250) ? second : 1000 + i));
+    }
+    return row;
+}
+
+void test_map_reduce() {
+    const long workerThreads = maximumWorkerThreads;
+    newMaximumWorkerThreads = 3;
+    applyNewLimits();
+    ManyType text;
+    text.putDataString() = "a";
+    // efail fails slowly on 10, and quickly on 200
+    test_value("define eslow",call("arrow",call("eslow",symbol("n")),
+        call("if",call("bool",symbol("n")),call("eslow",call("sub",symbol("n"),integer(1))),call("add",symbol("n"),text))),ManyType());
+    test_value("define efail",call("arrow",call("efail",symbol("x")),
+        call("if",call("bool",call("sub",symbol("x"),integer(10))),
+            call("if",call("bool",call("sub",symbol("x"),integer(200))),call("add",symbol("x"),integer(1)),
+                call("add",real(1.7e308),call("add",symbol("x"),real(1.7e308)))),
+            call("eslow",integer(3000)))),ManyType());
+    test_value("define rfail",call("arrow",call("rfail",symbol("a"),symbol("b")),call("add",symbol("a"),call("efail",symbol("b")))),ManyType());
+    test_value("map",call("map",symbol("efail"),call("rowvec",integer(1),integer(2),integer(3))),
+        evaluated(call("rowvec",real(2),real(3),real(4))));
+    test_value("filter",call("filter",symbol("bool"),call("colvec",integer(1),integer(0),integer(3))),
+        evaluated(call("colvec",integer(1),integer(3))));
+    test_value("reduce",call("reduce",symbol("rfail"),call("rowvec",integer(1),integer(2),integer(3)),call("true")),real(8));
+    // the alert of the first element that fails is raised,
+    // as it would be if they were called one at a time
+    for (int i = 0; i < 10; ++i) {
+        test_alert("map first alert",call("map",symbol("efail"),failing_row(10,200)),UserMessage::UnexpectedType);
+        test_alert("map first alert swapped",call("map",symbol("efail"),failing_row(200,10)),UserMessage::InfinityError);
+        test_alert("filter first alert",call("filter",symbol("efail"),failing_row(10,200)),UserMessage::UnexpectedType);
+        test_alert("filter first alert swapped",call("filter",symbol("efail"),failing_row(200,10)),UserMessage::InfinityError);
+        test_alert("reduce first alert",call("reduce",symbol("rfail"),failing_row(10,200),call("true")),UserMessage::UnexpectedType);
+        test_alert("reduce first alert swapped",call("reduce",symbol("rfail"),failing_row(200,10),call("true")),UserMessage::InfinityError);
+    }
+    test_alert("reduce in order first alert",call("reduce",symbol("rfail"),failing_row(10,200)),UserMessage::UnexpectedType);
+    test_alert("map not a vector",call("map",symbol("efail"),integer(1)),UserMessage::UnexpectedType);
+    test_alert("filter matrix",call("filter",symbol("bool"),call("matrix",call("rowvec",integer(1)))),UserMessage::UnexpectedType);
+    newMaximumWorkerThreads = workerThreads;
+    applyNewLimits();
+}
+
+void test_deep_recursion() {
+    const long recursionDepth = maximumRecursionDepth;
+    const long logicalRecursionDepth = maximumLogicalRecursionDepth;
+    newMaximumRecursionDepth = MAX_maximumRecursionDepth;
+    newMaximumLogicalRecursionDepth = MAX_maximumRecursionDepth;
+    applyNewLimits();
+    test_value("define deep",call("arrow",call("deep",symbol("n")),
+        call("if",call("bool",symbol("n")),call("add",call("deep",call("sub",symbol("n"),integer(1))),integer(1)),integer(0))),ManyType());
+    test_compiled("deep compiled","deep",1,true);
+    test_value("deep",call("deep",integer(1000)),real(1000));
+    // more than the native stack could hold
+    test_value("deeper",call("deep",integer(300000)),real(300000));
+    newMaximumRecursionDepth = 5000;
+    applyNewLimits();
+    test_alert("deep overflow",call("deep",integer(10000)),UserMessage::MaximumRecursionDepthReached);
+    test_value("deep after overflow",call("deep",integer(1000)),real(1000));
+    newMaximumRecursionDepth = recursionDepth;
+    newMaximumLogicalRecursionDepth = logicalRecursionDepth;
+    applyNewLimits();
+    // tail calls are not limited by maximumLogicalRecursionDepth
+    test_value("define loop",call("arrow",call("loop",symbol("n")),
+        call("if",call("bool",symbol("n")),call("loop",call("sub",symbol("n"),integer(1))),integer(0))),ManyType());
+    test_value("loop",call("loop",integer(100000)),integer(0));
+    test_value("define inner loop",call("arrow",call("innerloop",symbol("n")),call("add",call("loop",symbol("n")),integer(1))),ManyType());
+    test_value("inner loop",call("innerloop",integer(100000)),real(1));
+}
+
+void test_memory() {
+    const size_t memory = maximumMemory;
+    // limits below the minimum are raised to it
+    newMaximumMemory = 1;
+    applyNewLimits();
+    test_value("memory limit clamped",call("memorylimit"),integer(MIN_maximumMemory));
+    newMaximumMemory = memory;
+    applyNewLimits();
+    {
+        // passing a ManyType by value takes it
+        ManyType text, expected;
+        text.putDataString().assign(3 * MAX_INPUT_SIZE,'a');
+        expected.makeCopyFrom(text,maximumRecursionDepth);
+        test_value("define big",call("assign",symbol("big"),text),expected);
+    }
+    // one more copy of big doesn't fit
+    newMaximumMemory = currentMemoryUsage + MAX_INPUT_SIZE;
+    applyNewLimits();
+    const size_t before = currentMemoryUsage;
+    test_alert("memory limit reached",call("rowvec",symbol("big"),symbol("big")),UserMessage::MemoryLimitReached);
+    std::cout << "memory released" << ((currentMemoryUsage == before) ? ": ok" : ": Unexpected Memory") << std::endl;
+    // looking a symbol up allocates nothing that is counted,
+    // even when its name is too long to be stored inline
+    test_value("define long name",call("arrow",call("averyveryverylongname",symbol("x")),symbol("x")),ManyType());
+    newMaximumMemory = currentMemoryUsage;
+    applyNewLimits();
+    try {
+        const bool found = findSymbol("averyveryverylongname",1) != nullptr;
+        std::cout << "lookup at memory limit" << (found ? ": ok" : ": Unexpected Value") << std::endl;
+    }
+    catch (UserAlert& e) {
+        std::cout << "lookup at memory limit: Unexpected Alert: " << e.what() << std::endl;
+    }
+    newMaximumMemory = memory;
+    applyNewLimits();
+    test_value("remove big",call("remove",symbol("big")),integer(1));
+    test_value("remove long name",call("remove",symbol("averyveryverylongname")),integer(1));
+}
+
+/// Traces the evaluation of an expression, and reports
+/// the calls it made as name/argc(...) with the calls
+/// each one made inside the parentheses.
+std::string trace_outline(ManyType expression) {
+    std::stringstream file, json;
+    startTracing();
+    try {
+        startProcessing();
+        evaluateExpression(expression,maximumRecursionDepth);
+    }
+    catch (UserAlert& e) {
+        stopTracing();
+        return std::string("alert: ") + e.what();
+    }
+    stopTracing();
+    writeTraceFile(file);
+    if (!decodeTraceFile(file,json)) {
+        return "bad trace file";
+    }
+    std::string outline, line;
+    while (std::getline(json,line)) {
+        if (line.find("\"ph\":\"B\"") != std::string::npos) {
+            const size_t start = line.find("\"name\":\"") + 8;
+            outline += line.substr(start,line.find('"',start) - start) + "(";
+        }
+        else if (line.find("\"ph\":\"E\"") != std::string::npos) {
+            outline += ")";
+        }
+    }
+    return outline;
+}
+
+/// Reports whether the outline of the trace of an expression is as expected.
+void test_trace(const char* description, ManyType expression, const std::string& expected) {
+    const std::string outline = trace_outline(expression);
+    if (outline == expected) {
+        std::cout << description << ": ok" << std::endl;
+    }
+    else {
+        std::cout << description << ": Unexpected Trace: " << outline << std::endl;
+    }
+}
+
+void test_tracing() {
+    test_value("define twice",call("arrow",call("twice",symbol("x")),call("add",symbol("x"),symbol("x"))),ManyType());
+    test_value("define cnt",call("arrow",call("cnt",symbol("n")),
+        call("if",call("bool",symbol("n")),call("add",call("cnt",call("sub",symbol("n"),integer(1))),integer(1)),integer(0))),ManyType());
+    test_value("define quad",call("arrow",call("quad",symbol("x")),call("twice",call("twice",symbol("x")))),ManyType());
+    // the inner call finishes before the outer one starts
+    test_trace("trace twice",call("twice",call("twice",integer(4))),"twice/1(add/2())twice/1(add/2())");
+    // the outer twice is a tail call, so it runs in the slice of quad
+    test_trace("trace quad",call("quad",integer(5)),"quad/1(twice/1(add/2())add/2())");
+    // calls made on heap frames and quickened calls
+    test_trace("trace cnt",call("cnt",integer(3)),
+        "cnt/1(bool/1()sub/2()cnt/1(bool/1()sub/2()cnt/1(bool/1()sub/2()cnt/1(bool/1())add/2())add/2())add/2())");
+}
+
+void test_batch() {
+    test_value("define bsum",call("arrow",call("bsum",symbol("x"),symbol("y")),call("add",symbol("x"),symbol("y"))),ManyType());
+    test_value("define bpick",call("arrow",call("bpick",symbol("x")),call("if",symbol("x"),integer(1),integer(2))),ManyType());
+    test_value("define bconst",call("arrow",call("bconst",symbol("x")),integer(5)),ManyType());
+    test_value("define brow",call("arrow",call("brow",symbol("x")),call("rowvec",symbol("x"),symbol("x"))),ManyType());
+    define_side();
+    // whole columns, with a single value repeated on every row
+    test_value("batch columns",call("batch",symbol("bsum"),call("colvec",integer(1),integer(2),integer(3)),integer(10)),
+        evaluated(call("colvec",real(11),real(12),real(13))));
+    test_trace("batch columns once",call("batch",symbol("bsum"),call("colvec",integer(4),integer(5),integer(6)),integer(10)),
+        "colvec/3()batch/3(bsum/2(add/2()))");
+    // if doesn't take a vector, so each row is evaluated by itself
+    test_value("batch rows",call("batch",symbol("bpick"),call("colvec",integer(0),integer(1),integer(2))),
+        evaluated(call("colvec",integer(2),integer(1),integer(1))));
+    test_trace("batch rows after columns",call("batch",symbol("bpick"),call("colvec",integer(0),integer(1),integer(3))),
+        "colvec/3()batch/2(bpick/1()bpick/1()bpick/1()bpick/1())");
+    // a rowvec is read as a column, and a constant is repeated
+    test_value("batch constant",call("batch",symbol("bconst"),call("rowvec",integer(0),integer(1))),
+        evaluated(call("colvec",integer(5),integer(5))));
+    // side effects happen once per row
+    test_trace("batch side rows",call("batch",symbol("side"),call("colvec",integer(1),integer(2))),
+        "colvec/2()batch/2(side/1(count/0(load /0())add/2()assign/2())side/1(count/0(load /0())add/2()assign/2()))");
+    test_value("batch side count",symbol("count"),real(3));
+    // rows that don't give a number, and columns that don't line up
+    test_alert("batch not a number",call("batch",symbol("brow"),call("colvec",integer(0),integer(1))),UserMessage::UnexpectedType);
+    test_alert("batch lengths",call("batch",symbol("bsum"),call("colvec",integer(1),integer(2)),call("rowvec",integer(1),integer(2),integer(3))),
+        UserMessage::ShapeMismatch);
+    test_alert("batch matrix",call("batch",symbol("bconst"),call("matrix",call("rowvec",integer(1)))),UserMessage::UnexpectedType);
+    test_alert("batch arguments",call("batch",symbol("bsum"),integer(1)),UserMessage::WrongNumberOfArguments);
+}
+
+/// @return the stacks written by writeFoldedStacks, without their times
+std::string folded_stacks() {
+    std::stringstream folded;
+    writeFoldedStacks(folded);
+    std::string stacks, line;
+    while (std::getline(folded,line)) {
+        stacks += line.substr(0,line.rfind(' ')) + "|";
+    }
+    return stacks;
+}
+
+void test_profiler() {
+    const long recursionDepth = maximumRecursionDepth;
+    test_value("define pcnt",call("arrow",call("pcnt",symbol("n")),
+        call("if",call("bool",symbol("n")),call("add",call("pcnt",call("sub",symbol("n"),integer(1))),integer(1)),integer(0))),ManyType());
+    startProfiling();
+    test_value("profile pcnt",call("pcnt",integer(2)),real(2));
+    stopProfiling();
+    const std::string stacks = folded_stacks();
+    std::cout << "profile stacks" << ((stacks ==
+        "pcnt/1|pcnt/1;bool/1|pcnt/1;sub/2|pcnt/1;pcnt/1|pcnt/1;pcnt/1;bool/1|pcnt/1;pcnt/1;sub/2|"
+        "pcnt/1;pcnt/1;pcnt/1|pcnt/1;pcnt/1;pcnt/1;bool/1|pcnt/1;pcnt/1;add/2|pcnt/1;add/2|") ? ": ok" : ": Unexpected Stacks") << std::endl;
+    // each stack is stored once, as its caller and the symbol called,
+    // and the tables count towards maximumMemory
+    newMaximumRecursionDepth = 10000;
+    applyNewLimits();
+    const size_t before = currentMemoryUsage;
+    startProfiling();
+    test_value("profile deep pcnt",call("pcnt",integer(2000)),real(2000));
+    stopProfiling();
+    const size_t bytes = currentMemoryUsage - before;
+    std::cout << "profile memory" << ((bytes > 0 && bytes < 1000000) ? ": ok" : ": Unexpected Memory") << std::endl;
+    startProfiling();
+    stopProfiling();
+    newMaximumRecursionDepth = recursionDepth;
+    applyNewLimits();
+}
+
+void test_native() {
+    test_value("define ncnt",call("arrow",call("ncnt",symbol("n")),
+        call("if",call("bool",symbol("n")),call("ncnt",call("sub",symbol("n"),integer(1))),integer(0))),ManyType());
+    test_value("native ncnt",call("native",symbol("ncnt"),integer(1)),boolean(true));
+    test_value("ncnt",call("ncnt",integer(3)),integer(0));
+    // the tail calls loop instead of nesting
+    test_value("ncnt tail calls",call("ncnt",integer(100000)),integer(0));
+    test_value("define nquarter",call("arrow",call("nquarter",symbol("n")),
+        call("if",symbol("n"),call("add",real(0.25),call("nquarter",call("sub",symbol("n"),integer(1)))),integer(0))),ManyType());
+    test_value("native nquarter",call("native",symbol("nquarter"),integer(1)),boolean(true));
+    test_value("nquarter",call("nquarter",integer(100)),real(25));
+    test_alert("nquarter type",call("nquarter",call("rowvec",integer(1),integer(2))),UserMessage::UnexpectedType);
+    // still a user-defined function
+    test_value("redefine ncnt",call("arrow",call("ncnt",symbol("n")),integer(7)),ManyType());
+    test_value("ncnt redefined",call("ncnt",integer(1)),integer(7));
+    test_value("remove nquarter",call("remove",symbol("nquarter")),integer(1));
+    // functions that can't be translated
+    test_value("define nfree",call("arrow",call("nfree",symbol("a")),call("add",symbol("a"),symbol("nothing"))),ManyType());
+    test_value("native nfree",call("native",symbol("nfree"),integer(1)),boolean(false));
+    test_value("native add",call("native",symbol("add"),integer(2)),boolean(false));
+    test_alert("native undefined",call("native",symbol("nothing"),integer(1)),UserMessage::UnknownSymbol);
+    // the compiler is stopped if processing is cancelled
+    test_value("define ncancel",call("arrow",call("ncancel",symbol("x")),call("sub",symbol("x"),integer(2))),ManyType());
+    try {
+        ManyType expression = call("native",symbol("ncancel"),integer(1));
+        startProcessing();
+        cancelProcessing();
+        evaluateExpression(expression,maximumRecursionDepth);
+        std::cout << "native cancelled: No Alert" << std::endl;
+    }
+    catch (UserAlert& e) {
+        std::cout << "native cancelled" << ((e.base == UserMessage::Cancelled) ? ": ok" : ": Unexpected Alert") << std::endl;
+    }
+    test_value("ncancel",call("ncancel",integer(5)),real(3));
+}
+
+/// Counts the calls made to it, the context is a std::atomic<long>.
+void count_callback(void* context, AsyncEvaluation&) noexcept {
+    ++*(std::atomic<long>*)(context);
+}
+
+/// Waits until an evaluation has started running.
+void wait_until_running(const EvaluationHandle& evaluation) {
+    while (pollEvaluation(evaluation) == EvaluationStatus::Queued) {
+        waitForEvaluation(evaluation,0.001);
+    }
+}
+
+/// Takes the result of an evaluation, and reports
+/// whether it raises the expected alert.
+void test_evaluation_alert(const char* description, const EvaluationHandle& evaluation, const UserMessage expected) {
     try {
+        ManyType result;
+        takeEvaluationResult(result,evaluation);
+        std::cout << description << ": No Alert" << std::endl;
+    }
+    catch (UserAlert& e) {
+        std::cout << description << ((e.base == expected) ? ": ok" : ": Unexpected Alert") << std::endl;
+    }
+}
+
+/// Shuts the executor down, so it must run last.
+void test_async_evaluation() {
+    std::atomic<long> callbacks(0);
+    ManyType expression = call("add",integer(1),integer(2));
+    EvaluationHandle sum = submitEvaluation(expression,&count_callback,&callbacks);
+    ManyType result;
+    takeEvaluationResult(result,sum);
+    std::cout << "async result" << (sameValue(result,real(3),maximumRecursionDepth) ? ": ok" : ": Unexpected Value") << std::endl;
+    // the callback may still be running when the wait returns
+    // but it has returned before the next evaluation starts
+    expression = call("unknownsymbol");
+    EvaluationHandle unknown = submitEvaluation(expression,&count_callback,&callbacks);
+    std::cout << "async failed" << ((waitForEvaluation(unknown) == EvaluationStatus::Failed) ? ": ok" : ": Unexpected Status") << std::endl;
+    test_evaluation_alert("async failed alert",unknown,UserMessage::UnknownSymbol);
+    // cancelled while running, and while queued behind it
+    expression = call("while",boolean(true),integer(0));
+    EvaluationHandle spin = submitEvaluation(expression,&count_callback,&callbacks);
+    expression = call("add",integer(1),integer(2));
+    EvaluationHandle queued = submitEvaluation(expression,&count_callback,&callbacks);
+    wait_until_running(spin);
+    const bool queuedCancelled = cancelEvaluation(queued) && pollEvaluation(queued) == EvaluationStatus::Cancelled;
+    std::cout << "async cancel queued" << (queuedCancelled ? ": ok" : ": Unexpected Status") << std::endl;
+    const bool spinCancelled = cancelEvaluation(spin) && waitForEvaluation(spin) == EvaluationStatus::Cancelled;
+    std::cout << "async cancel running" << (spinCancelled ? ": ok" : ": Unexpected Status") << std::endl;
+    std::cout << "async cancel settled" << (!cancelEvaluation(spin) ? ": ok" : ": Unexpected Status") << std::endl;
+    test_evaluation_alert("async cancelled alert",spin,UserMessage::Cancelled);
+    test_evaluation_alert("async cancelled queued alert",queued,UserMessage::Cancelled);
+    // shutting down cancels what is running and queued,
+    // and what is submitted afterwards
+    expression = call("while",boolean(true),integer(0));
+    spin = submitEvaluation(expression,&count_callback,&callbacks);
+    expression = call("add",integer(1),integer(2));
+    queued = submitEvaluation(expression,&count_callback,&callbacks);
+    wait_until_running(spin);
+    shutdownEvaluations();
+    const bool shutDown = pollEvaluation(spin) == EvaluationStatus::Cancelled && pollEvaluation(queued) == EvaluationStatus::Cancelled;
+    std::cout << "async shutdown" << (shutDown ? ": ok" : ": Unexpected Status") << std::endl;
+    expression = call("add",integer(1),integer(2));
+    EvaluationHandle late = submitEvaluation(expression,&count_callback,&callbacks);
+    std::cout << "async after shutdown" << ((pollEvaluation(late) == EvaluationStatus::Cancelled) ? ": ok" : ": Unexpected Status") << std::endl;
+    std::cout << "async callbacks" << ((callbacks == 7) ? ": ok" : ": Unexpected Count") << std::endl;
+}
 
-        bindEverything();
+int main() {
+    try {
 
         test_lexer("hi");
         test_lexer("");
@@ -108,6 +890,24 @@ int main() {
         test_lexer("appl%%e314");
         test_lexer("5 ()");
 
+        test_bytecode();
+        test_quickening();
+        test_memoization();
+        test_parallel_arguments();
+        test_reactive();
+        test_lazy_parameters();
+        test_short_circuit();
+        test_type_inference();
+        test_broadcasting();
+        test_map_reduce();
+        test_deep_recursion();
+        test_memory();
+        test_tracing();
+        test_batch();
+        test_profiler();
+        test_native();
+        test_async_evaluation();
+
     }
     catch (ManyTypeAccessError& e) {
         std::cout << std::endl << "Irrecoverable Memory Error" << std::endl;